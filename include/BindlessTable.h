@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Buffer.h"
+#include "Texture.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+
+// One global, update-after-bind descriptor set with every texture of the scene in a large array and the materials in a
+// storage buffer. Shaders index both with the material of the draw, so drawing any object binds nothing of its own.
+// Unused slots of the texture array are left unbound.
+class BindlessTable
+{
+public:
+	static constexpr uint32_t MAX_TEXTURE_COUNT = 1024;
+	static constexpr uint32_t MAX_MATERIAL_COUNT = 1024;
+
+	enum Binding
+	{
+		TEXTURES = 0,
+		MATERIALS,
+		COUNT
+	};
+
+	// Match Material in shaders/scene_common.glsl
+	struct Material
+	{
+		uint32_t albedoTextureIdx;
+	};
+
+	// Every pipeline that binds the table creates the layout with this, so that the layouts are compatible
+	static VkDescriptorSetLayout createSetLayout(VkDevice device);
+
+	BindlessTable(VkDevice device, MemoryAllocator* allocator, VkDescriptorSetLayout setLayout);
+	~BindlessTable();
+
+	// Slots are written after bind, so they can be added while earlier frames are in flight. Return the index of the slot.
+	uint32_t addTexture(Texture const& texture);
+	uint32_t addMaterial(Material const& material);
+
+	void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set) const;
+private:
+	VkDevice m_device{ VK_NULL_HANDLE };
+	VkDescriptorPool m_descriptorPool{ VK_NULL_HANDLE };
+	VkDescriptorSet m_descriptorSet{ VK_NULL_HANDLE };
+
+	std::unique_ptr<Buffer> m_materialBuffer;
+
+	uint32_t m_textureCount{ 0 };
+	uint32_t m_materialCount{ 0 };
+};
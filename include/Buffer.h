@@ -2,30 +2,40 @@
 
 #include <vulkan/vulkan.h>
 
+#include "MemoryAllocator.h"
+
 class SceneObject;
 class Camera;
 class LightingPass;
+class GeometryArena;
+class Scene;
+class UniformArena;
+class BindlessTable;
 
 class Buffer
 {
 public:
-	Buffer(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuffer copyCommandBuffer, VkBufferUsageFlags usage, VkDeviceSize size, void* initData);
-	Buffer(VkPhysicalDevice physicalDevice, VkDevice device, VkBufferUsageFlags usage, VkDeviceSize size);
+	// The category of the memory is reported with it
+	Buffer(VkDevice device, MemoryAllocator* allocator, VkBufferUsageFlags usage, VkDeviceSize size, MemoryAllocator::Category category);
+	Buffer(VkDevice device, MemoryAllocator* allocator, VkBufferUsageFlags usage, VkDeviceSize size, VkMemoryPropertyFlags properties,
+		MemoryAllocator::Category category);
 	~Buffer();
 
-	void update(void* data, size_t size);
+	void update(void const* data, size_t size, size_t offset = 0);
 private:
 	friend SceneObject;
 	friend Camera;
 	friend LightingPass;
+	friend GeometryArena;
+	friend Scene;
+	friend UniformArena;
+	friend BindlessTable;
 
 	VkDevice m_device{ VK_NULL_HANDLE };
-
-	VkBuffer m_stagingBuffer{ VK_NULL_HANDLE };
-	VkDeviceMemory m_stagingMemory{ VK_NULL_HANDLE };
+	MemoryAllocator* m_allocator{ nullptr };
 
 	VkBuffer m_vkBuffer{ VK_NULL_HANDLE };
-	VkDeviceMemory m_deviceMemory{ VK_NULL_HANDLE };
+	MemoryAllocator::Allocation m_allocation;
 
 	void* m_hostData{ nullptr };
 };
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <future>
+#include <limits>
+
+// Bounding volume hierarchy over the world boxes of the scene objects. Moving objects only refit the nodes above them.
+// Once refitting has grown the nodes well past those of a fresh tree, a new one is built with the surface area
+// heuristic on a background thread and swapped in when it is done.
+class Bvh
+{
+public:
+	static constexpr uint32_t INVALID_IDX = std::numeric_limits<uint32_t>::max();
+	static constexpr uint32_t MAX_LEAF_SIZE = 4;
+	// Object centroids are binned along an axis to find the split of a node
+	static constexpr uint32_t BIN_COUNT = 12;
+	// Summed surface area of the nodes, relative to the last build, that triggers a rebuild
+	static constexpr float REBUILD_AREA_RATIO = 1.5f;
+
+	void resize(uint32_t objectCount);
+	void setBounds(uint32_t objectIdx, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax);
+	// Builds the first tree, refits the nodes of the objects whose bounds changed, and starts or picks up a rebuild
+	void update();
+
+	// Objects whose box is in front of every plane are appended to insideObjects, the ones whose box may cross a plane to
+	// intersectingObjects. Whole subtrees inside of the planes are taken without testing their objects.
+	void query(std::vector<glm::vec4> const& planes, std::vector<uint32_t>& insideObjects, std::vector<uint32_t>& intersectingObjects) const;
+private:
+	struct Node
+	{
+		glm::vec3 boundsMin;
+		uint32_t firstObject;
+		glm::vec3 boundsMax;
+		uint32_t objectCount;
+		// The second child follows the first one, leaves have no children. Children come after their parent.
+		uint32_t firstChild;
+		uint32_t parent;
+	};
+	struct Tree
+	{
+		std::vector<Node> nodes;
+		// Every node covers a contiguous range of the objects in this order
+		std::vector<uint32_t> objects;
+		std::vector<uint32_t> objectLeaves;
+	};
+
+	// Takes copies of the bounds so that it can run while they change
+	static Tree build(std::vector<glm::vec3> boundsMin, std::vector<glm::vec3> boundsMax);
+	static float getArea(glm::vec3 const& boundsMin, glm::vec3 const& boundsMax);
+	// Recomputes the bounds of the node from its objects or children, and returns whether they changed
+	bool refitNode(uint32_t nodeIdx);
+	void refitAll();
+
+	std::vector<glm::vec3> m_boundsMin;
+	std::vector<glm::vec3> m_boundsMax;
+	// Objects whose bounds changed since the last update, with a flag per object against duplicates
+	std::vector<uint32_t> m_changedObjects;
+	std::vector<bool> m_isChanged;
+
+	Tree m_tree;
+	float m_area{ 0.0f };
+	float m_builtArea{ 0.0f };
+	std::future<Tree> m_rebuild;
+};
@@ -1,6 +1,8 @@
 #pragma once
 
-#include "Buffer.h"
+#include "UniformArena.h"
+#include "DescriptorAllocator.h"
+#include "Renderer.h"
 
 #include <vulkan/vulkan.h>
 #define GLM_FORCE_RADIANS
@@ -10,8 +12,11 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <array>
 
 class LightingPass;
+class SceneObject;
+class Scene;
 
 class Camera
 {
@@ -23,20 +28,36 @@ public:
 		COUNT
 	};
 
-	Camera(Type type, VkPhysicalDevice physicalDevice, VkDevice device, VkDescriptorSetAllocateInfo descSetAllocInfo);
+	Camera(Type type, UniformArena* uniformArena, DescriptorAllocator* descriptorAllocator, VkDescriptorSetLayout setLayout);
 
+	// Writes the transforms of the frame into the uniform arena, after the arena region of the frame is reset
 	void update(uint32_t bufferIdx);
-	void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bufferIdx);
+	void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bufferIdx, VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
 
 	void move(glm::vec3 direction, uint32_t bufferIdx);
 	void turn(glm::vec2 direction, uint32_t bufferIdx);
+
+	// Pulls the near plane of the light camera back to the given distance along its direction when that is further
+	// toward the light, so that casters in front of the light volume still cast into it. Takes effect with update().
+	void extendTowardLight(float nearDistance);
+	// Distance from the near to the far plane of the light camera
+	float getLightDepthRange() const;
 private:
 	friend LightingPass;
+	friend SceneObject;
+	friend Scene;
 
-	std::vector<std::unique_ptr<Buffer>> m_uniformBuffers;
-	std::vector<VkDescriptorSet> m_descriptorSets;
+	UniformArena* m_uniformArena{ nullptr };
+	VkDescriptorSet m_descriptorSet{ VK_NULL_HANDLE };
+	// Offsets of the transforms of every frame in flight in the uniform arena
+	std::array<uint32_t, Renderer::BUFFER_COUNT> m_uniformOffsets{};
 	
+	static constexpr float LIGHT_HALF_WIDTH = 2.2f;
+	static constexpr float LIGHT_NEAR = -9.0f;
+	static constexpr float LIGHT_FAR = 20.0f;
+
 	Type m_type{ NORMAL };
+	float m_lightNear{ LIGHT_NEAR };
 
 	glm::vec3 m_position;
 	glm::vec3 m_direction;
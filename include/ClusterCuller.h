@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+class Scene;
+class Camera;
+
+// Compute pass that tests the meshlets of every draw against the view frustum and their normal cones, and writes the
+// triangles of the visible ones into the index range of the draw, drawn with one multi-draw-indirect
+class ClusterCuller
+{
+public:
+	static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+	ClusterCuller(VkDevice device, VkDescriptorSetLayout cameraSetLayout);
+	~ClusterCuller();
+
+	// One workgroup per meshlet of every draw from firstDraw on, dispatched with the VkDispatchIndirectCommand at dispatchOffset
+	// of the draw buffer. The draw commands must have been written with zero index counts.
+	// Makes the culled indices and draw commands visible to the indexed indirect draws.
+	void cull(VkCommandBuffer commandBuffer, Camera& camera, VkDescriptorSet cullSet, uint32_t bufferIdx, VkBuffer drawBuffer, VkDeviceSize dispatchOffset, uint32_t firstDraw);
+private:
+	friend Scene;
+
+	VkDevice m_vkDevice{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout m_setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout m_pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline m_pipeline{ VK_NULL_HANDLE };
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <array>
+
+#include "MemoryAllocator.h"
+#include "Renderer.h"
+
+class Texture;
+class Scene;
+class DrawCuller;
+
+// Hierarchical depth buffer for occlusion culling. Every texel holds the farthest depth of the texels it covers one
+// level below. The first level is the previous power of two of the depth buffer size, so that every level halves the
+// one below exactly and a texel of any level covers the same uv range as the texels reduced into it. Kept in the
+// general layout. Every frame in flight has a pyramid of its own, a frame tests against the one it built BUFFER_COUNT
+// frames ago, which the fence waited on in Renderer::beginFrame has finished writing, and rebuilds it in its late
+// phase. No frame reads a pyramid while another one writes it.
+class DepthPyramid
+{
+public:
+	static constexpr uint32_t WORKGROUP_SIZE = 8;
+
+	DepthPyramid(VkDevice device, MemoryAllocator* allocator, Texture* depthBuffer);
+	~DepthPyramid();
+
+	// Reduces the depth buffer into every level and makes them visible to compute shaders. The depth buffer must be in
+	// the depth read only layout, the view projection is the one it was rendered with
+	void build(VkCommandBuffer commandBuffer, glm::mat4 const& viewProjection, uint32_t bufferIdx);
+private:
+	friend Scene;
+	friend DrawCuller;
+
+	uint32_t m_width{ 0 };
+	uint32_t m_height{ 0 };
+	uint32_t m_levelCount{ 0 };
+
+	struct Frame
+	{
+		VkImage image{ VK_NULL_HANDLE };
+		MemoryAllocator::Allocation allocation;
+		VkImageView imageView{ VK_NULL_HANDLE };
+		std::vector<VkImageView> levelViews;
+		std::vector<VkDescriptorSet> descriptorSets;
+		// Occlusion tests project into the pyramid with the camera it was built from, an older frame's until it is rebuilt
+		glm::mat4 viewProjection{ 1.0f };
+		bool built{ false };
+	};
+
+	VkDevice m_vkDevice{ VK_NULL_HANDLE };
+	MemoryAllocator* m_allocator{ nullptr };
+	std::array<Frame, Renderer::BUFFER_COUNT> m_frames;
+	VkSampler m_sampler{ VK_NULL_HANDLE };
+
+	VkDescriptorPool m_descriptorPool{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout m_setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout m_pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline m_pipeline{ VK_NULL_HANDLE };
+};
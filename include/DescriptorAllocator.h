@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+// Allocates descriptor sets from chains of pools, a chain per set layout. A chain adds a pool, twice the size of the last
+// one, whenever its pools run out, so a scene can keep adding sets without reserving for the largest one up front.
+// Sets are cached by their layout and contents, asking for the same descriptors again returns the same set.
+class DescriptorAllocator
+{
+public:
+	static constexpr uint32_t FIRST_POOL_SET_COUNT = 8;
+	static constexpr uint32_t MAX_POOL_SET_COUNT = 512;
+
+	// Descriptor of binding i of a set, the bindings are numbered from zero in the order they are given
+	struct Binding
+	{
+		VkDescriptorType type;
+		VkDescriptorBufferInfo bufferInfo;
+		VkDescriptorImageInfo imageInfo;
+
+		static Binding buffer(VkDescriptorType type, VkDescriptorBufferInfo const& bufferInfo);
+		static Binding image(VkDescriptorType type, VkDescriptorImageInfo const& imageInfo);
+	};
+
+	DescriptorAllocator(VkDevice device);
+	~DescriptorAllocator();
+
+	// Set with the descriptors that lives as long as the allocator
+	VkDescriptorSet getSet(VkDescriptorSetLayout layout, std::vector<Binding> const& bindings);
+private:
+	struct PoolChain
+	{
+		// Descriptors of every type in a set of the layout
+		std::vector<VkDescriptorPoolSize> setSizes;
+		std::vector<VkDescriptorPool> pools;
+		// Pools before this one are full
+		uint32_t currentPool{ 0 };
+		uint32_t nextPoolSetCount{ FIRST_POOL_SET_COUNT };
+	};
+	struct KeyHash
+	{
+		size_t operator()(std::vector<uint64_t> const& key) const;
+	};
+
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout, std::vector<Binding> const& bindings);
+	void write(VkDescriptorSet descriptorSet, std::vector<Binding> const& bindings) const;
+
+	VkDevice m_device{ VK_NULL_HANDLE };
+
+	std::unordered_map<VkDescriptorSetLayout, PoolChain> m_chains;
+	// The layout and the contents of the bindings of the sets
+	std::unordered_map<std::vector<uint64_t>, VkDescriptorSet, KeyHash> m_cache;
+
+	// Passes create their sets on the render threads
+	std::mutex m_mutex;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// Optional device capabilities, queried and enabled when the logical device is created
+struct DeviceFeatures
+{
+	bool meshShader{ false };
+	// Several draws per indirect call, and the draw count read from a buffer
+	bool multiDrawIndirect{ false };
+	bool drawIndirectCount{ false };
+	// Per-heap budgets and usage of the whole process, for the memory report
+	bool memoryBudget{ false };
+	// Textures are copied from host memory into their images by the CPU, without staging buffers or command buffers
+	bool hostImageCopy{ false };
+	// BC1 to BC7 images can be sampled, textures are loaded from their cooked KTX2 files
+	bool textureCompressionBC{ false };
+
+	PFN_vkCmdDrawMeshTasksIndirectEXT vkCmdDrawMeshTasksIndirectEXT{ nullptr };
+	PFN_vkCmdDrawMeshTasksIndirectCountEXT vkCmdDrawMeshTasksIndirectCountEXT{ nullptr };
+	PFN_vkTransitionImageLayoutEXT vkTransitionImageLayoutEXT{ nullptr };
+	PFN_vkCopyMemoryToImageEXT vkCopyMemoryToImageEXT{ nullptr };
+};
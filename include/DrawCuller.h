@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+class Scene;
+class Camera;
+class DepthPyramid;
+
+// Compute pass that tests the candidate draws of a camera against its frustum and the depth pyramid, and appends the
+// visible ones to the draw commands of the culling phase along with the meshlet dispatch of the cluster culling
+class DrawCuller
+{
+public:
+	static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+	DrawCuller(VkDevice device, VkDescriptorSetLayout cameraSetLayout);
+	~DrawCuller();
+
+	// One invocation per candidate. Without a built depth pyramid the draws are only frustum culled. The late phase skips
+	// the candidates drawn in the early one. Makes the draws visible to the cluster culling and the indirect draws.
+	void cull(VkCommandBuffer commandBuffer, Camera& camera, VkDescriptorSet cullSet, uint32_t bufferIdx, DepthPyramid const* depthPyramid,
+		uint32_t phase, uint32_t candidateCount, uint32_t maxDrawCount, bool meshShading);
+private:
+	friend Scene;
+
+	struct PushConstants {
+		glm::mat4 occlusionViewProjection;
+		glm::vec2 depthPyramidSize;
+		uint32_t depthPyramidLevelCount;
+		uint32_t phase;
+		uint32_t occlusionCulling;
+		uint32_t maxDrawCount;
+	};
+
+	VkDevice m_vkDevice{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout m_setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout m_pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline m_pipeline{ VK_NULL_HANDLE };
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <limits>
+
+class Scene;
+
+// Scene entities as parallel arrays indexed by entity. Systems update one property of every entity in a single pass, so
+// an update walks a few contiguous arrays instead of a pointer and a virtual call per object.
+// Entities form a hierarchy stored breadth first: every level of it is a contiguous range of entities after the level of
+// their parents, so the world transforms are propagated one level at a time and the entities of a level in parallel.
+class EntityStore
+{
+public:
+	static constexpr uint32_t INVALID_IDX = std::numeric_limits<uint32_t>::max();
+
+	struct Desc
+	{
+		// SceneObject with the geometry of the entity, and its slot in the texture array
+		uint32_t mesh;
+		uint32_t material;
+		uint32_t baseVertex;
+		// Entity whose node the node of this one is attached to, INVALID_IDX for the roots
+		uint32_t parent;
+		// The node of the entity is placed at the position and spun in the space of its parent node. Children inherit it.
+		glm::vec3 position;
+		// Affine, places the mesh in the node of the entity and is not inherited. Maps the packed positions of the mesh.
+		glm::mat4 localTransform;
+		// Radians per second about the up axis of the parent node
+		float spinSpeed;
+		// Bounds of the mesh in the space of its packed positions
+		glm::vec4 boundingSphere;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	// Entities are added level by level, the parent of an entity is on the level of the last entity or the one above it
+	uint32_t add(Desc const& desc);
+	uint32_t getCount() const;
+	uint32_t getLevelCount() const;
+	// Entities of the level are [first, last)
+	void getLevel(uint32_t level, uint32_t& first, uint32_t& last) const;
+
+	// Both update the entities [first, last) only, so that disjoint ranges can be updated concurrently
+	// Advances the spin angles of the spinning entities
+	void animate(float dt, uint32_t first, uint32_t last);
+	// Rebuilds the transforms of the entities that moved, or whose parent did, since the last call and bumps their
+	// versions. SIMD width entities at a time, all of them on one level, after the levels above it.
+	void updateTransforms(uint32_t first, uint32_t last);
+private:
+	friend Scene;
+
+	// Element [column * 3 + row] of an affine transform without its last row
+	static constexpr uint32_t AFFINE_ELEMENT_COUNT = 12;
+	static constexpr uint32_t NORMAL_ELEMENT_COUNT = 9;
+
+	// Mesh and material handles
+	std::vector<uint32_t> m_meshes;
+	std::vector<uint32_t> m_materials;
+	std::vector<uint32_t> m_baseVertices;
+
+	std::vector<uint32_t> m_parents;
+	// Versions of the parents the transforms were built from, a child is rebuilt when its parent's version moves on
+	std::vector<uint32_t> m_parentVersions;
+	// End of every level, the last one is the entity count
+	std::vector<uint32_t> m_levelEnds;
+
+	// Inputs of the transform kernel in structure-of-arrays form, padded by a SIMD width so that a vector can start at any entity
+	std::vector<float> m_positionX;
+	std::vector<float> m_positionY;
+	std::vector<float> m_positionZ;
+	std::array<std::vector<float>, AFFINE_ELEMENT_COUNT> m_localTransforms;
+	// Inverse transposes of the local transforms. The world nodes are rigid, the normal matrix of the model is the node rotation of it.
+	std::array<std::vector<float>, NORMAL_ELEMENT_COUNT> m_localNormalMatrices;
+	std::vector<float> m_spinCos;
+	std::vector<float> m_spinSin;
+
+	std::vector<float> m_spinAngles;
+	std::vector<float> m_spinSpeeds;
+	// Set when the inputs of the transform change, static entities are only transformed once
+	std::vector<uint8_t> m_isMoved;
+	// Bumped whenever the transform changes, copies of the transform remember the version they were taken from
+	std::vector<uint32_t> m_versions;
+
+	// Outputs of the transform kernel. The world nodes are rigid, normal matrices have the columns of a std430 mat3.
+	std::vector<glm::mat4x3> m_worldNodes;
+	std::vector<glm::mat4> m_modelMatrices;
+	std::vector<glm::mat3x4> m_normalMatrices;
+
+	// Bounds in the space of the packed positions, the model matrices take them to world space
+	std::vector<glm::vec4> m_boundingSpheres;
+	std::vector<glm::vec3> m_boundsMin;
+	std::vector<glm::vec3> m_boundsMax;
+};
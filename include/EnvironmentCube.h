@@ -4,10 +4,9 @@
 class EnvironmentCube : public SceneObject
 {
 public:
-	EnvironmentCube(uint32_t id, VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuffer copyCommandBuffer,
-		VkDescriptorSetAllocateInfo descSetAllocInfo);
-
-	virtual void update(uint32_t bufferIdx, float dt) override;
+	EnvironmentCube(uint32_t id, VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, VkCommandBuffer copyCommandBuffer,
+		GeometryArena& geometryArena, DescriptorAllocator* descriptorAllocator, VkDescriptorSetLayout setLayout,
+		DeviceFeatures const& deviceFeatures);
 private:
 	inline static const std::vector<std::string> ALBEDO_FILENAMES =
 	{
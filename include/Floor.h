@@ -4,10 +4,8 @@
 class Floor : public SceneObject
 {
 public:
-	Floor(uint32_t id, VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuffer copyCommandBuffer,
-		VkDescriptorSetAllocateInfo descSetAllocInfo);
-
-	virtual void update(uint32_t bufferIdx, float dt) override;
+	Floor(uint32_t id, VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, VkCommandBuffer copyCommandBuffer,
+		GeometryArena& geometryArena, DeviceFeatures const& deviceFeatures);
 private:
 	inline static const std::string ALBEDO_FILENAME = "assets/crate.jpg";
 };
@@ -0,0 +1,53 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "Simd.h"
+
+#include <cstdint>
+#include <vector>
+#include <array>
+
+// World space bounding spheres and boxes of the scene objects in structure-of-arrays form, tested against clip space
+// planes SIMD_WIDTH objects at a time. An object is visible when both its sphere and its box are in front of every plane.
+class FrustumCuller
+{
+public:
+	static constexpr uint32_t SIMD_WIDTH = FLOAT_VEC_WIDTH;
+
+	void resize(uint32_t objectCount);
+
+	// Bounds are given in the space the model matrix transforms from
+	void setBounds(uint32_t objectIdx, glm::mat4 const& model, glm::vec4 const& boundingSphere, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax);
+
+	// Normalized clip space planes of the view projection, pointing inwards
+	static std::vector<glm::vec4> getFrustumPlanes(glm::mat4 const& viewProjection);
+	// Planes of shadow casters, which must intersect the light volume and whose bounds swept along the light direction for
+	// shadowLength must intersect the receiver volume, so that their shadow can fall on something visible
+	static std::vector<glm::vec4> getShadowCasterPlanes(glm::mat4 const& lightViewProjection, glm::mat4 const& receiverViewProjection,
+		glm::vec3 const& lightDirection, float shadowLength);
+
+	// Appends the given objects that are in front of every plane, in order. Lists of different calls may be culled concurrently.
+	void cull(std::vector<glm::vec4> const& planes, uint32_t const* objects, uint32_t objectCount, std::vector<uint32_t>& visibleObjects) const;
+
+	// World box of the object
+	void getBox(uint32_t objectIdx, glm::vec3& boxMin, glm::vec3& boxMax) const;
+	// Smallest distance of the bounding spheres of the objects [first, last) along the direction from the origin
+	float getMinDistance(glm::vec3 const& origin, glm::vec3 const& direction, uint32_t first, uint32_t last) const;
+private:
+
+	uint32_t m_objectCount{ 0 };
+
+	std::vector<float> m_sphereX;
+	std::vector<float> m_sphereY;
+	std::vector<float> m_sphereZ;
+	std::vector<float> m_sphereRadius;
+	std::vector<float> m_boxX;
+	std::vector<float> m_boxY;
+	std::vector<float> m_boxZ;
+	std::vector<float> m_boxExtentX;
+	std::vector<float> m_boxExtentY;
+	std::vector<float> m_boxExtentZ;
+};
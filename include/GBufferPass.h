@@ -1,11 +1,17 @@
 #pragma once
 
 #include "RenderPass.h"
+#include "VertexLayout.h"
+#include "DeviceFeatures.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include <type_traits>
+
+class DepthPyramid;
+
 class GBufferPass : public RenderPass
 {
 public:
@@ -14,18 +20,62 @@ public:
 		glm::vec3 normal;
 		glm::vec2 uvCoord;
 	};
+	// Meshes are split into a position stream and an attribute stream so that depth-only passes fetch positions only.
+	// Positions are stored relative to the mesh bounds when quantized, see SceneObject::m_dequantizeTransform
+	static constexpr bool QUANTIZED_POSITIONS = true;
+	struct PackedPosition {
+		std::conditional_t<QUANTIZED_POSITIONS, Snorm4x16, glm::vec3> position;
+	};
+	struct PackedAttributes {
+		Snorm2x16 normal;
+		Half2 uvCoord;
+	};
+	using PositionStream = VertexStream<0, decltype(PackedPosition::position)>;
+	using AttributeStream = VertexStream<1, decltype(PackedAttributes::normal), decltype(PackedAttributes::uvCoord)>;
+	using PackedVertexInput = VertexInput<PositionStream, AttributeStream>;
+	using PositionVertexInput = VertexInput<PositionStream>;
+	// Meshlets tested by one task shader workgroup, see shaders/meshlet.task
+	static constexpr uint32_t TASK_WORKGROUP_SIZE = 32;
 	struct ModelTransforms {
 		glm::mat4 model;
 	};
+	// Per object data of the scene, indexed with the first instance of its indirect draw
+	struct ObjectData {
+		glm::mat4 model;
+		// Inverse transpose of the model matrix, in the columns of a std430 mat3
+		glm::mat3x4 normalMatrix;
+		// Bounds of the draw culling, in the space of the packed positions
+		glm::vec4 boundingSphere;
+		// Slot of the material in the bindless table
+		uint32_t materialIdx;
+		uint32_t baseVertex;
+		uint32_t padding[2];
+	};
+	// Indexed indirect draw of an object, the meshlets it is culled from and the matching mesh task draw
+	struct DrawCommand {
+		VkDrawIndexedIndirectCommand indexed;
+		uint32_t meshletOffset;
+		uint32_t meshletCount;
+		VkDrawMeshTasksIndirectCommandEXT meshTasks;
+	};
 	struct CameraTransforms {
 		glm::mat4 view;
 		glm::mat4 projection;
 	};
 
-	GBufferPass(VkDevice device, RenderThreadPool* threadPool, std::vector<Texture*>& colorTargets, Texture* depthTarget);
+	GBufferPass(VkDevice device, RenderThreadPool* threadPool, std::vector<Texture*>& colorTargets, Texture* depthTarget, DepthPyramid* depthPyramid,
+		DeviceFeatures const& deviceFeatures);
 	virtual ~GBufferPass();
 
 	virtual void renderImpl(Scene* scene, VkCommandBuffer commandBuffer, uint32_t bufferIdx, float dt) override;
 private:
+	// Occlusion culls the draws, rebuilt between the early and the late draws. Without it the draws are only frustum
+	// culled on the GPU, in a single phase.
+	DepthPyramid* m_depthPyramid{ nullptr };
+	// Continues the G-buffer of the early draws with the late ones
+	VkRenderPass m_loadRenderPass{ VK_NULL_HANDLE };
 };
 
+static_assert(sizeof(GBufferPass::PackedPosition) == GBufferPass::PositionStream::STRIDE, "PackedPosition must match its vertex stream");
+static_assert(sizeof(GBufferPass::PackedAttributes) == GBufferPass::AttributeStream::STRIDE, "PackedAttributes must match its vertex stream");
+
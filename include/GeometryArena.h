@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Buffer.h"
+#include "GBufferPass.h"
+#include "MeshletBuilder.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <vector>
+#include <memory>
+
+// Device local buffers shared by all static meshes, so that any number of them can be drawn with the same bindings.
+// Allocations are never freed. Where the device local memory is host visible they are written in place, otherwise each
+// one is uploaded through its own staging buffer, released with releaseStagingBuffers() once the copy command buffer has completed.
+class GeometryArena
+{
+public:
+	enum Stream
+	{
+		POSITIONS = 0,
+		ATTRIBUTES,
+		INDICES,
+		MESHLETS,
+		MESHLET_VERTICES,
+		MESHLET_TRIANGLES,
+		COUNT
+	};
+
+	GeometryArena(VkDevice device, MemoryAllocator* allocator, uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t meshletCapacity);
+
+	// Return the base vertex, the first index and the first meshlet of the added data. Indices and meshlet vertices
+	// stay relative to the base vertex of the mesh, meshlet offsets are rebased to the arena.
+	uint32_t addVertices(VkCommandBuffer copyCommandBuffer, std::vector<GBufferPass::PackedPosition> const& positions, std::vector<GBufferPass::PackedAttributes> const& attributes);
+	uint32_t addIndices(VkCommandBuffer copyCommandBuffer, std::vector<uint16_t> const& indices);
+	uint32_t addMeshlets(VkCommandBuffer copyCommandBuffer, std::vector<Meshlet> meshlets, std::vector<uint32_t> const& vertices, std::vector<uint32_t> const& triangles);
+
+	void releaseStagingBuffers();
+
+	void bindVertexBuffers(VkCommandBuffer commandBuffer, bool positionsOnly) const;
+	void bindIndexBuffer(VkCommandBuffer commandBuffer) const;
+	VkDescriptorBufferInfo getDescriptorInfo(Stream stream) const;
+private:
+	uint32_t allocate(VkCommandBuffer copyCommandBuffer, Stream stream, void const* data, uint32_t count);
+
+	VkDevice m_device{ VK_NULL_HANDLE };
+	MemoryAllocator* m_allocator{ nullptr };
+
+	static constexpr std::array<VkDeviceSize, Stream::COUNT> ELEMENT_SIZES{
+		sizeof(GBufferPass::PackedPosition), sizeof(GBufferPass::PackedAttributes), sizeof(uint16_t),
+		sizeof(Meshlet), sizeof(uint32_t), sizeof(uint32_t)
+	};
+
+	std::array<std::unique_ptr<Buffer>, Stream::COUNT> m_buffers;
+	// Allocated and available element counts of every stream
+	std::array<uint32_t, Stream::COUNT> m_sizes{};
+	std::array<uint32_t, Stream::COUNT> m_capacities{};
+
+	std::vector<std::unique_ptr<Buffer>> m_stagingBuffers;
+};
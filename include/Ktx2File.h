@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// A 2D image in a KTX 2.0 container, as written by the texture cooker. Only single layer, single face images without
+// supercompression are read and written, in the formats listed by getBlockSize.
+struct Ktx2File
+{
+	VkFormat format{ VK_FORMAT_UNDEFINED };
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	// Level 0 is the full size image, every level is tightly packed rows of texel blocks
+	std::vector<std::vector<uint8_t>> levels;
+
+	// False when the file can't be opened, terminates when it is not a file this can read
+	static bool load(std::string const& filename, Ktx2File& file);
+	static void save(std::string const& filename, Ktx2File const& file);
+
+	// Bytes of a 4x4 block of the block compressed formats and of a texel of the others, 0 for unsupported formats
+	static uint32_t getBlockSize(VkFormat format);
+	static bool isBlockCompressed(VkFormat format);
+	static size_t getLevelSize(VkFormat format, uint32_t width, uint32_t height, uint32_t level);
+};
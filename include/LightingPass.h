@@ -1,7 +1,8 @@
 #pragma once
 
 #include "RenderPass.h"
-#include "Buffer.h"
+#include "UniformArena.h"
+#include "DescriptorAllocator.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -13,8 +14,8 @@
 class LightingPass : public RenderPass
 {
 public:
-	LightingPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadPool* threadPool, std::vector<Texture*>& colorTargets, std::vector<Texture*>& srcTextures);
-	virtual ~LightingPass();
+	LightingPass(VkDevice device, RenderThreadPool* threadPool, UniformArena* uniformArena, DescriptorAllocator* descriptorAllocator,
+		std::vector<Texture*>& colorTargets, std::vector<Texture*>& srcTextures);
 
 	virtual void renderImpl(Scene* scene, VkCommandBuffer commandBuffer, uint32_t bufferIdx, float dt) override;
 private:
@@ -24,8 +25,7 @@ private:
 		glm::vec3 lightDir;
 	};
 
-	VkDescriptorPool m_descriptorPool{ VK_NULL_HANDLE };
-	std::vector<VkDescriptorSet> m_descriptorSets;
-	std::vector<std::unique_ptr<Buffer>> m_uniformBuffers;
+	UniformArena* m_uniformArena{ nullptr };
+	VkDescriptorSet m_descriptorSet{ VK_NULL_HANDLE };
 };
 
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <ostream>
+
+// Sub-allocates the memory of buffers and images from large blocks, so that a resource costs no vkAllocateMemory of its
+// own. Every memory type has a pool of blocks for linear resources and one for optimal tiling images, which keeps
+// bufferImageGranularity out of the way. A block is split into power of two ranges with the buddy scheme.
+class MemoryAllocator
+{
+	struct Block;
+public:
+	static constexpr VkDeviceSize BLOCK_SIZE = 64ull << 20;
+	static constexpr VkDeviceSize MIN_ALLOCATION_SIZE = 256;
+	// Device local memory the CPU writes in place
+	static constexpr VkMemoryPropertyFlags DIRECT_WRITE_PROPERTIES =
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	enum Pool
+	{
+		LINEAR = 0,
+		OPTIMAL,
+		COUNT
+	};
+
+	// What the memory is used for, the report breaks the used bytes down by it
+	enum Category
+	{
+		RENDER_TARGET = 0,
+		MESH,
+		TEXTURE,
+		STAGING,
+		// Shader constants and per-frame data written by the CPU
+		UNIFORM,
+		// Indirect draw and culling buffers
+		DRAW,
+		CATEGORY_COUNT
+	};
+
+	struct Allocation
+	{
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		VkDeviceSize offset{ 0 };
+		// Persistently mapped when the memory is host visible
+		void* mappedData{ nullptr };
+	private:
+		friend MemoryAllocator;
+
+		// Null for dedicated allocations
+		Block* block{ nullptr };
+		uint32_t poolIdx{ 0 };
+		uint32_t order{ 0 };
+		VkDeviceSize size{ 0 };
+		Category category{ CATEGORY_COUNT };
+	};
+
+	struct Stats
+	{
+		// Device memory allocations made, blocks and dedicated ones
+		uint32_t deviceAllocationCount;
+		uint32_t blockCount;
+		uint32_t allocationCount;
+		VkDeviceSize allocatedBytes;
+		// Bytes handed out, rounded up to the buddy sizes
+		VkDeviceSize usedBytes;
+	};
+
+	struct HeapReport
+	{
+		VkMemoryHeapFlags flags;
+		VkDeviceSize size;
+		// Of the whole process as seen by the driver with VK_EXT_memory_budget. Without it the budget is the heap size
+		// and the usage is what this allocator has allocated from the heap.
+		VkDeviceSize budget;
+		VkDeviceSize usage;
+		VkDeviceSize allocatedBytes;
+	};
+	struct CategoryReport
+	{
+		uint32_t allocationCount;
+		VkDeviceSize usedBytes;
+	};
+	struct Report
+	{
+		Stats stats;
+		std::vector<HeapReport> heaps;
+		std::array<CategoryReport, Category::CATEGORY_COUNT> categories;
+	};
+
+	// Owned by the renderer and handed to everything that creates buffers or images. Destroyed after every resource of
+	// the device and before the device, which frees the blocks.
+	MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+	~MemoryAllocator();
+
+	// Memory of the first type with the properties, aligned as required
+	Allocation allocate(VkMemoryRequirements const& requirements, VkMemoryPropertyFlags properties, Pool pool, Category category);
+	void free(Allocation const& allocation);
+
+	// Whether one of the memory types has the direct write properties and is on the main device local heap, as with
+	// resizable BAR and on unified memory devices. The small BAR heap of other discrete devices does not count.
+	bool isDirectWriteAvailable(uint32_t memoryTypeBits = ~0u) const;
+
+	// Reads the heap budgets from VK_EXT_memory_budget, once the device has it enabled
+	void useMemoryBudget();
+
+	Stats getStats() const;
+	Report getReport() const;
+	// The report as JSON, for tools that track the usage of a build over time
+	void writeReport(std::ostream& out) const;
+	static char const* getCategoryName(Category category);
+private:
+	struct Block
+	{
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		void* mappedData{ nullptr };
+		// Free offsets per order, ranges of order n are MIN_ALLOCATION_SIZE << n bytes
+		std::vector<std::unordered_set<VkDeviceSize>> freeOffsets;
+		VkDeviceSize usedBytes{ 0 };
+	};
+	struct BlockPool
+	{
+		std::vector<std::unique_ptr<Block>> blocks;
+		VkDeviceSize blockSize{ 0 };
+		uint32_t maxOrder{ 0 };
+	};
+
+	uint32_t findMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties) const;
+	VkDeviceMemory allocateDeviceMemory(uint32_t memoryTypeIdx, VkDeviceSize size, void** mappedData);
+	void freeDeviceMemory(uint32_t memoryTypeIdx, VkDeviceMemory memory, VkDeviceSize size);
+	// Offset of a free range of the order in the block, splitting a larger one if needed
+	bool allocateRange(Block& block, uint32_t order, VkDeviceSize& offset) const;
+
+	VkPhysicalDevice m_physicalDevice{ VK_NULL_HANDLE };
+	VkDevice m_device{ VK_NULL_HANDLE };
+	// Queried once, memory types are picked from it for every resource
+	VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+	bool m_memoryBudget{ false };
+	// The largest heap with device local memory
+	uint32_t m_deviceLocalHeapIdx{ 0 };
+
+	// Pool of memory type i is at i * Pool::COUNT + pool
+	std::array<BlockPool, VK_MAX_MEMORY_TYPES * Pool::COUNT> m_pools;
+
+	uint32_t m_deviceAllocationCount{ 0 };
+	uint32_t m_allocationCount{ 0 };
+	VkDeviceSize m_allocatedBytes{ 0 };
+	VkDeviceSize m_usedBytes{ 0 };
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> m_heapAllocatedBytes{};
+	std::array<CategoryReport, Category::CATEGORY_COUNT> m_categories{};
+
+	// Guards the pools, so that resources can be created and destroyed off the main thread
+	mutable std::mutex m_mutex;
+};
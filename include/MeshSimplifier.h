@@ -0,0 +1,47 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// Quadric error metric simplifier. Vertices are only ever collapsed onto other existing vertices, so every
+// level of detail indexes into the same vertex buffer. Vertices on open or attribute seam edges are locked.
+class MeshSimplifier
+{
+public:
+	MeshSimplifier(std::vector<glm::vec3> const& positions, std::vector<uint16_t> const& indices);
+
+	// Continues collapsing edges from the previous result until at most targetIndexCount indices remain or no
+	// edge can be collapsed. Returns the simplified indices, error receives the largest geometric error so far.
+	std::vector<uint16_t> simplify(size_t targetIndexCount, float& error);
+private:
+	struct Quadric
+	{
+		double a2, ab, ac, ad;
+		double b2, bc, bd;
+		double c2, cd;
+		double d2;
+		double weight;
+	};
+	struct Collapse
+	{
+		uint16_t from;
+		uint16_t to;
+		double cost;
+	};
+
+	static void addQuadric(Quadric& q, Quadric const& other);
+	static double evaluate(Quadric const& q, glm::vec3 const& p);
+
+	bool flipsTriangle(uint16_t from, uint16_t to) const;
+
+	std::vector<glm::vec3> m_positions;
+	std::vector<uint16_t> m_indices;
+	std::vector<Quadric> m_quadrics;
+	std::vector<bool> m_locked;
+	std::vector<std::vector<uint32_t>> m_vertexTriangles;
+	double m_maxError{ 0.0 };
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// Matches the std430 layout of the Meshlet struct in shaders/meshlet_common.glsl
+struct Meshlet
+{
+	// Center and radius in the space of the packed positions
+	glm::vec4 boundingSphere;
+	// Normal cone axis and the sine of its half angle, a cutoff above 1 disables backface culling of the cluster
+	glm::vec4 cone;
+	uint32_t vertexOffset;
+	uint32_t vertexCount;
+	uint32_t triangleOffset;
+	uint32_t triangleCount;
+};
+
+// Splits index ranges into clusters of neighbouring triangles. Triangles are stored as three 8 bit indices into the
+// vertex list of their meshlet, which in turn holds indices into the vertex buffer of the mesh.
+class MeshletBuilder
+{
+public:
+	static constexpr uint32_t MAX_VERTICES = 64;
+	static constexpr uint32_t MAX_TRIANGLES = 124;
+
+	MeshletBuilder(std::vector<glm::vec3> const& positions);
+
+	// Appends the meshlets of the given triangle list and returns the index of the first one
+	uint32_t build(uint16_t const* indices, size_t indexCount);
+
+	std::vector<Meshlet> const& getMeshlets() const { return m_meshlets; }
+	std::vector<uint32_t> const& getVertices() const { return m_vertices; }
+	std::vector<uint32_t> const& getTriangles() const { return m_triangles; }
+private:
+	std::vector<glm::vec3> const& m_positions;
+
+	std::vector<Meshlet> m_meshlets;
+	std::vector<uint32_t> m_vertices;
+	std::vector<uint32_t> m_triangles;
+};
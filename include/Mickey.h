@@ -4,10 +4,8 @@
 class Mickey : public SceneObject
 {
 public:
-	Mickey(uint32_t id, VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuffer copyCommandBuffer,
-		VkDescriptorSetAllocateInfo descSetAllocInfo);
-
-	virtual void update(uint32_t bufferIdx, float dt) override;
+	Mickey(uint32_t id, VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, VkCommandBuffer copyCommandBuffer,
+		GeometryArena& geometryArena, DeviceFeatures const& deviceFeatures);
 private:
 	inline static const std::string MESH_FILENAME = "assets/mickey.obj";
 	inline static const std::string ALBEDO_FILENAME = "assets/mickey.png";
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// Mip levels of RGBA8 images built on the CPU, each level a 2x2 box filter of the one above it. Used by textures whose
+// mips can't be blitted on the GPU, and by the texture cooker.
+class MipChain
+{
+public:
+	enum Content
+	{
+		// sRGB encoded color with linear alpha, filtered in linear space
+		COLOR = 0,
+		// Tangent space normals in the unsigned range, renormalized after filtering
+		NORMAL
+	};
+
+	// Levels down to 1x1
+	static uint32_t getLevelCount(uint32_t width, uint32_t height);
+	// Levels 1 to levelCount - 1 of the image
+	static std::vector<std::vector<uint8_t>> generate(uint8_t const* pixels, uint32_t width, uint32_t height, uint32_t levelCount, Content content);
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <array>
+
+class WorkerPool;
+
+// Low resolution depth buffer of a few large occluders, rasterized on the CPU SIMD width pixels at a time in bands of
+// rows spread over the workers. A pixel only takes the depth of an occluder that covers all of it, and the farthest depth
+// the occluder has in it, so an object tested as hidden is hidden at full resolution too.
+class OcclusionRasterizer
+{
+public:
+	static constexpr uint32_t WIDTH = 320;
+	static constexpr uint32_t HEIGHT = 180;
+	// Rows rasterized by one worker range
+	static constexpr uint32_t BAND_HEIGHT = 12;
+
+	OcclusionRasterizer();
+
+	// Clears the depth and the occluders. The occluders and the tests are projected with the view projection.
+	void begin(glm::mat4 const& viewProjection);
+	// Clips the triangles against the near plane and sets them up, positions are in the space the model matrix transforms from
+	void addOccluder(glm::mat4 const& model, std::vector<glm::vec3> const& positions, std::vector<uint16_t> const& indices);
+	void rasterize(WorkerPool& workerPool);
+
+	// False when the box is behind the occluders everywhere it covers
+	bool isVisible(glm::mat4 const& model, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax) const;
+private:
+	struct Triangle
+	{
+		// Edge functions A * x + B * y + C of the pixel centers, non-negative for pixels inside the triangle
+		glm::vec3 edges[3];
+		// Depth plane A * x + B * y + C
+		glm::vec3 depth;
+		// Pixels that can be inside, inclusive
+		int32_t minX;
+		int32_t minY;
+		int32_t maxX;
+		int32_t maxY;
+	};
+
+	// Takes clip space vertices in front of the near plane. Edge i runs from vertex i to the next one, outer edges are
+	// on the outline of the occluder.
+	void setupTriangle(std::array<glm::vec4, 3> const& clip, std::array<bool, 3> const& outerEdges);
+	void rasterizeRows(uint32_t firstRow, uint32_t lastRow);
+
+	glm::mat4 m_viewProjection{ 1.0f };
+	std::vector<Triangle> m_triangles;
+	// Row major, cleared to the far plane
+	std::vector<float> m_depth;
+};
@@ -22,7 +22,8 @@ public:
 
 	void render(Scene* scene, uint32_t frameBufferIdx, uint32_t bufferIdx, float dt);
 
-	void begin(VkCommandBuffer commandBuffer, uint32_t frameBufferIdx = 0);
+	// A render pass compatible with the one of the pass can be given to begin with other load operations
+	void begin(VkCommandBuffer commandBuffer, uint32_t frameBufferIdx = 0, VkRenderPass renderPass = VK_NULL_HANDLE);
 	virtual void renderImpl(Scene* scene, VkCommandBuffer commandBuffer, uint32_t bufferIdx, float dt) = 0;
 	void end(VkCommandBuffer commandBuffer);
 
@@ -43,6 +44,8 @@ protected:
 	VkPipelineLayout m_pipelineLayout{ VK_NULL_HANDLE };
 	VkDescriptorSetLayout m_modelSetLayout{ VK_NULL_HANDLE };
 	VkDescriptorSetLayout m_cameraSetLayout{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout m_meshletSetLayout{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout m_bindlessSetLayout{ VK_NULL_HANDLE };
 	VkPipeline m_pipeline{ VK_NULL_HANDLE };
 	VkRenderPass m_vkRenderPass{ VK_NULL_HANDLE };
 	std::vector<VkFramebuffer> m_framebuffers;
@@ -54,6 +57,8 @@ protected:
 	uint32_t m_targetHeight{ 0 };
 	uint32_t m_colorTargetCount{ 1 };
 	bool m_hasDepthAttachment{ false };
+	// Geometry is drawn with task and mesh shaders instead of the culled index buffers
+	bool m_meshShading{ false };
 
 	uint32_t m_frameBufferIdx{ 0 };
 };
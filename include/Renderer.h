@@ -2,6 +2,7 @@
 
 #include "RenderThreadPool.h"
 #include "Texture.h"
+#include "DeviceFeatures.h"
 
 #include <cstdint>
 #include <vector>
@@ -14,6 +15,9 @@ struct GLFWwindow;
 class Scene;
 class RenderPass;
 class InputHandler;
+class DepthPyramid;
+class UniformArena;
+class DescriptorAllocator;
 
 class Renderer
 {
@@ -31,6 +35,9 @@ public:
 private:
 	void initVulkan();
 	void beginFrame();
+	// ImGui window with the heap budgets and the memory of every allocation category
+	void showMemoryReport();
+	void showUpdateStats();
 	void endFrame();
 	void update();
 	void render();
@@ -45,12 +52,17 @@ private:
 	VkSurfaceKHR m_vkSurface{ VK_NULL_HANDLE };
 	VkSwapchainKHR m_vkSwapChain{ VK_NULL_HANDLE };
 
+	DeviceFeatures m_deviceFeatures;
+	// Every buffer and image of the device takes its memory from it
+	std::unique_ptr<MemoryAllocator> m_memoryAllocator;
+
 	std::array<VkSemaphore, BUFFER_COUNT> m_frameBufferAvailable{ VK_NULL_HANDLE };
 	std::array<VkFence, BUFFER_COUNT> m_vkFences{ VK_NULL_HANDLE };
 
 	std::unique_ptr<Texture> m_gBufferAlbedo;
 	std::unique_ptr<Texture> m_gBufferNormal;
 	std::unique_ptr<Texture> m_depthBuffer;
+	std::unique_ptr<DepthPyramid> m_depthPyramid;
 	std::unique_ptr<Texture> m_shadowMap;
 
 	std::vector<std::unique_ptr<Texture>> m_frameBuffers;
@@ -65,6 +77,10 @@ private:
 		COUNT
 	};
 	std::vector<std::unique_ptr<RenderPass>> m_renderPasses;
+	// Per-frame uniforms of the cameras and passes
+	std::unique_ptr<UniformArena> m_uniformArena;
+	// Descriptor sets of the scene and the passes
+	std::unique_ptr<DescriptorAllocator> m_descriptorAllocator;
 
 	uint32_t m_bufferIdx{ 0 };
 	uint32_t m_frameBufferIdx{ 0 };
@@ -7,36 +7,170 @@
 #include <glm/vec3.hpp>
 
 #include <vector>
+#include <array>
 #include <memory>
 
 #include "SceneObject.h"
 #include "Camera.h"
+#include "ClusterCuller.h"
+#include "DrawCuller.h"
+#include "GeometryArena.h"
+#include "BindlessTable.h"
+#include "DescriptorAllocator.h"
+#include "FrustumCuller.h"
+#include "Bvh.h"
+#include "EntityStore.h"
+#include "OcclusionRasterizer.h"
+#include "WorkerPool.h"
+#include "DeviceFeatures.h"
 
 struct GLFWwindow;
 
 class SkyPass;
 class LightingPass;
 class InputHandler;
+class DepthPyramid;
 
 class Scene
 {
 public:
-	Scene(RenderPass* renderPass, VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, uint32_t queueFamilyIdx);
+	struct DrawInfo
+	{
+		Camera::Type cameraType;
+		bool positionsOnly;
+		uint32_t lodBias;
+		// Task shaders cull the meshlets, otherwise they are culled into index buffers by cull()
+		bool meshShading;
+		// Draws are occlusion culled against it when given, otherwise only frustum culled
+		DepthPyramid* depthPyramid;
+	};
+	// Occlusion culled draws are drawn in two phases. The early one tests against the depth pyramid the frame slot built
+	// BUFFER_COUNT frames ago, the late one rebuilds the pyramid from the early draws and tests the draws the early one culled.
+	enum CullPhase
+	{
+		EARLY = 0,
+		LATE,
+		COUNT
+	};
+	// Milliseconds spent in the steps of the last update(). The entity ranges are timed one by one, a slowest range far
+	// above the mean shows the workers waiting on each other.
+	struct UpdateStats
+	{
+		float animateTime;
+		float transformTime;
+		float uploadTime;
+		float cullTime;
+		uint32_t rangeCount;
+		uint32_t workerCount;
+		float meanRangeTime;
+		float maxRangeTime;
+		// Entities written into the object buffer of the frame
+		uint32_t uploadedCount;
+	};
+
+	Scene(RenderPass* renderPass, DepthPyramid* depthPyramid, UniformArena* uniformArena, DescriptorAllocator* descriptorAllocator, VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, VkQueue queue,
+		uint32_t queueFamilyIdx,
+		DeviceFeatures const& deviceFeatures);
 
 	void clean();
 
-	void update(InputHandler* inputHandler, uint32_t bufferIdx);
+	void update(InputHandler* inputHandler, uint32_t bufferIdx, float dt);
+	UpdateStats const& getUpdateStats() const;
+	// Tests the objects of the main camera against occluders rasterized on the CPU, instead of the depth pyramid on the
+	// GPU. Off by default, weak and software devices may be faster with it on. Takes effect from the next update().
+	void setSoftwareOcclusionCulling(bool enabled);
+	bool isSoftwareOcclusionCulling() const;
 
-	void render(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, Camera::Type cameraType, uint32_t bufferIdx, float dt);
+	// Culls the draws of the camera on the GPU into the draw commands of the phase, then culls their meshlets. Recorded
+	// outside of the render pass, before render() with the same draw info and phase. The early phase comes first.
+	void cull(VkCommandBuffer commandBuffer, DrawInfo const& drawInfo, CullPhase phase, uint32_t bufferIdx);
+	// Draws the visible objects of the phase with a single indirect call, independent of the object count
+	void render(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, DrawInfo const& drawInfo, CullPhase phase, uint32_t bufferIdx, float dt);
 private:
 	friend SkyPass;
 	friend LightingPass;
 
-	VkDescriptorPool m_descriptorPool{ VK_NULL_HANDLE };
+	// Candidate buffers hold the candidate count followed by a GBufferPass::DrawCommand per object
+	static constexpr VkDeviceSize CANDIDATE_OFFSET = sizeof(uint32_t);
+	// Draw buffers hold the draw count and the cluster culling VkDispatchIndirectCommand of each phase, followed by
+	// GBufferPass::DrawCommands for as many draws as there are objects per phase
+	static constexpr VkDeviceSize DRAW_COUNT_OFFSET = 0;
+	static constexpr VkDeviceSize DISPATCH_OFFSET = DRAW_COUNT_OFFSET + sizeof(uint32_t) * CullPhase::COUNT;
+	static constexpr VkDeviceSize DRAW_COMMAND_OFFSET = DISPATCH_OFFSET + sizeof(VkDispatchIndirectCommand) * CullPhase::COUNT;
+
+	// Entities animated, transformed and bounded by one worker range. A multiple of the SIMD width, and of the floats in a
+	// cache line, so that the ranges only meet at the cache lines of their first and last entities.
+	static constexpr uint32_t UPDATE_GRAIN_SIZE = 1024;
+	// Objects on the planes of a camera tested by one worker range, a multiple of the SIMD width
+	static constexpr uint32_t CULL_GRAIN_SIZE = 4096;
+	// Visible objects tested against the occluders by one worker range
+	static constexpr uint32_t OCCLUSION_GRAIN_SIZE = 256;
+	static_assert(UPDATE_GRAIN_SIZE % FLOAT_VEC_WIDTH == 0 && UPDATE_GRAIN_SIZE % (WorkerPool::CACHE_LINE_SIZE / sizeof(float)) == 0,
+		"Update ranges must start on whole SIMD vectors and cache lines");
+
+	// What one worker range found, on cache lines of its own so that the ranges can write it side by side
+	struct alignas(WorkerPool::CACHE_LINE_SIZE) RangeOutput
+	{
+		std::vector<uint32_t> visibleObjects;
+		std::vector<uint32_t> movedObjects;
+		float minLightDistance;
+		// Animation and upload of the range
+		float updateTime;
+		uint32_t uploadedCount;
+	};
+
+	template<typename T>
+	using PerCamera = std::array<std::array<T, Camera::Type::COUNT>, Renderer::BUFFER_COUNT>;
+
+	void drawIndirect(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkBuffer drawBuffer, CullPhase phase, VkDeviceSize commandOffset, bool meshTasks) const;
+
 	VkDevice m_vkDevice{ VK_NULL_HANDLE };
+	DeviceFeatures m_deviceFeatures;
+
+	std::unique_ptr<GeometryArena> m_geometryArena;
+	std::unique_ptr<BindlessTable> m_bindlessTable;
+	std::unique_ptr<WorkerPool> m_workerPool;
+
+	// World bounds of the objects, updated with their transforms. The objects that pass the frustum test of a camera, or
+	// the shadow caster test of the light, are the only candidates of its draw culling. The tree finds them, and the
+	// ones its boxes cannot decide on are tested with their spheres and boxes by the frustum culler.
+	FrustumCuller m_frustumCuller;
+	Bvh m_bvh;
+	PerCamera<std::vector<uint32_t>> m_visibleObjects;
+	std::array<std::vector<uint32_t>, Camera::Type::COUNT> m_intersectingObjects;
+	std::vector<RangeOutput> m_rangeOutputs;
+	UpdateStats m_updateStats{};
+	// Drops the objects of the main camera that are hidden behind the occluders, when culling on the CPU
+	std::unique_ptr<OcclusionRasterizer> m_occlusionRasterizer;
+	bool m_softwareOcclusionCulling{ false };
+	std::unique_ptr<DrawCuller> m_drawCuller;
+	std::unique_ptr<ClusterCuller> m_clusterCuller;
+
+	// GBufferPass::ObjectData of every entity, and the albedo maps indexed by their materials
+	std::array<std::unique_ptr<Buffer>, Renderer::BUFFER_COUNT> m_objectBuffers;
+	// Entity versions in the object buffer of each frame in flight and in the culling bounds. Only the entities whose
+	// version has moved on are written again, so static entities are written once per buffer.
+	std::array<std::vector<uint32_t>, Renderer::BUFFER_COUNT> m_uploadedVersions;
+	std::vector<uint32_t> m_boundsVersions;
+	std::array<VkDescriptorSet, Renderer::BUFFER_COUNT> m_objectDescriptorSets{};
+
+	// The CPU only picks the levels of detail of the candidates, the draw and cluster culling write the rest
+	PerCamera<std::unique_ptr<Buffer>> m_candidateBuffers;
+	PerCamera<std::unique_ptr<Buffer>> m_drawBuffers;
+	PerCamera<std::unique_ptr<Buffer>> m_drawnEarlyBuffers;
+	PerCamera<std::unique_ptr<Buffer>> m_culledIndexBuffers;
+	PerCamera<VkDescriptorSet> m_drawCullDescriptorSets{};
+	PerCamera<VkDescriptorSet> m_cullDescriptorSets{};
+	PerCamera<VkDescriptorSet> m_meshletDescriptorSets{};
+
+	// Start of the culled index range of every entity, sized for the most detailed level of its mesh
+	std::vector<uint32_t> m_culledFirstIndices;
+	uint32_t m_maxMeshletCount{ 0 };
 
 	std::vector<std::unique_ptr<Camera>> m_cameras;
+	// Meshes and materials, placed in the scene by the entities
 	std::vector<std::unique_ptr<SceneObject>> m_objects;
+	EntityStore m_entities;
 
 	glm::vec3 m_lightDirection;
 };
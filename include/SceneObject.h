@@ -3,26 +3,54 @@
 #include "GBufferPass.h"
 #include "Buffer.h"
 #include "Texture.h"
+#include "Camera.h"
+#include "GeometryArena.h"
+#include "DescriptorAllocator.h"
 
 #include <vulkan/vulkan.h>
 
 #include <memory>
+#include <array>
 #define _USE_MATH_DEFINES
 #include <math.h>
 
-class Camera;
+class Scene;
 
 class SceneObject
 {
 public:
+	// Without a material set layout the object has no material set of its own, the scene draws it from its object buffer.
+	// Otherwise render() binds the set and pushes the model transform as push constants.
 	SceneObject(uint32_t id, VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuffer copyCommandBuffer,
-		VkDescriptorSetAllocateInfo descSetAllocInfo);
+		GeometryArena& geometryArena, DescriptorAllocator* descriptorAllocator, VkDescriptorSetLayout setLayout);
 	~SceneObject();
 
 	void init();
-	virtual void update(uint32_t bufferIdx, float dt) = 0;
-	void render(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bufferIdx, float dt);
+	// Frees the staging memory of the textures once the copy command buffer has completed
+	void releaseStagingBuffers();
+	// Transforms and animation live in the entity store of the scene, objects only hold the meshes and materials
+	uint32_t selectLod(Camera const& camera, glm::mat4 const& model, uint32_t lodBias) const;
+	void render(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bufferIdx, float dt, bool positionsOnly = false, uint32_t lod = 0);
 protected:
+	friend Scene;
+
+	static constexpr uint32_t MAX_LOD_COUNT = 4;
+	// Largest geometric error allowed on screen, as a fraction of the viewport height (about a pixel at 1080p)
+	static constexpr float LOD_SCREEN_ERROR = 1.0f / 1080.0f;
+
+	// Offsets into the index and meshlet streams of the geometry arena
+	struct Lod
+	{
+		uint32_t firstIndex{ 0 };
+		uint32_t indexCount{ 0 };
+		float error{ 0.0f };
+		uint32_t meshletOffset{ 0 };
+		uint32_t meshletCount{ 0 };
+	};
+
+	void generateLods(std::vector<glm::vec3> const& positions);
+	void generateMeshlets(std::vector<glm::vec3> const& positions);
+
 	uint16_t addVertex(uint32_t hash, GBufferPass::Vertex* pVertex);
 	void loadIndexedMesh(std::string const& filename);
 	struct VertexCacheEntry
@@ -33,15 +61,16 @@ protected:
 	VkPhysicalDevice m_physicalDevice;
 	VkDevice m_device;
 	VkCommandBuffer m_copyCommandBuffer;
-	VkDescriptorSetAllocateInfo m_descSetAllocInfo;
+	GeometryArena* m_geometryArena;
+	DescriptorAllocator* m_descriptorAllocator;
+	VkDescriptorSetLayout m_setLayout;
 
 	std::vector<VertexCacheEntry*> m_vertexCache;
 
-	std::vector<VkDescriptorSet> m_descriptorSets;
+	VkDescriptorSet m_descriptorSet{ VK_NULL_HANDLE };
+	GBufferPass::ModelTransforms m_modelTransforms{};
 
-	std::unique_ptr<Buffer> m_vertexBuffer;
-	std::unique_ptr<Buffer> m_indexBuffer;
-	std::vector<std::unique_ptr<Buffer>> m_uniformBuffers;
+	uint32_t m_baseVertex{ 0 };
 
 	std::unique_ptr<Texture> m_albedoMap;
 	std::unique_ptr<Texture> m_normalMap;
@@ -50,9 +79,19 @@ protected:
 
 	std::vector<GBufferPass::Vertex> m_vertices;
 	std::vector<uint16_t> m_indices;
+	std::vector<Lod> m_lods;
+
+	// Maps quantized vertex positions back to mesh space, applied on the right of the model matrix
+	glm::mat4 m_dequantizeTransform{ 1.0f };
+	// Bounding sphere (center, radius) and box in the space of the packed positions
+	glm::vec4 m_boundingSphere{ 0.0f };
+	glm::vec3 m_boundsMin{ 0.0f };
+	glm::vec3 m_boundsMax{ 0.0f };
 
-	float m_rotationSpeed{ 1.0f };
-	float m_orientation = 0;
+	// Occluders keep the vertices their coarsest level of detail uses on the CPU, for software occlusion culling
+	bool m_occluder{ false };
+	std::vector<glm::vec3> m_occluderPositions;
+	std::vector<uint16_t> m_occluderIndices;
 
 	uint32_t m_id{ 0 };
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "RenderPass.h"
+#include "DeviceFeatures.h"
 
 #include <memory>
 
@@ -11,8 +12,10 @@ class ShadowPass : public RenderPass
 public:
 	static constexpr uint32_t MAP_WIDTH = 2048;
 	static constexpr uint32_t MAP_HEIGHT = 2048;
+	// Shadow casters are drawn this many levels coarser than their screen-size LOD
+	static constexpr uint32_t LOD_BIAS = 1;
 
-	ShadowPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadPool* threadPool, std::vector<Texture*>& depthTargets);
+	ShadowPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadPool* threadPool, std::vector<Texture*>& depthTargets, DeviceFeatures const& deviceFeatures);
 
 	virtual void renderImpl(Scene* scene, VkCommandBuffer commandBuffer, uint32_t bufferIdx, float dt) override;
 private:
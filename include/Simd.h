@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+
+// Thin wrappers over the widest float vectors the build targets, so that CPU side culling is written once. Targets
+// without SSE, such as ARM, get plain C++ lanes of the same width.
+#if defined(__AVX__)
+#include <immintrin.h>
+
+using FloatVec = __m256;
+static constexpr uint32_t FLOAT_VEC_WIDTH = 8;
+
+static inline FloatVec loadVec(float const* values) { return _mm256_loadu_ps(values); }
+static inline void storeVec(float* values, FloatVec a) { _mm256_storeu_ps(values, a); }
+static inline FloatVec splatVec(float value) { return _mm256_set1_ps(value); }
+static inline FloatVec laneIndexVec() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+static inline FloatVec addVec(FloatVec a, FloatVec b) { return _mm256_add_ps(a, b); }
+static inline FloatVec mulVec(FloatVec a, FloatVec b) { return _mm256_mul_ps(a, b); }
+static inline FloatVec mulAddVec(FloatVec a, FloatVec b, FloatVec c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+static inline FloatVec negateVec(FloatVec a) { return _mm256_sub_ps(_mm256_setzero_ps(), a); }
+static inline FloatVec minVec(FloatVec a, FloatVec b) { return _mm256_min_ps(a, b); }
+static inline FloatVec greaterVec(FloatVec a, FloatVec b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+static inline FloatVec greaterEqualVec(FloatVec a, FloatVec b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+static inline FloatVec andVec(FloatVec a, FloatVec b) { return _mm256_and_ps(a, b); }
+// Lanes of a where the mask is set, b elsewhere
+static inline FloatVec selectVec(FloatVec mask, FloatVec a, FloatVec b) { return _mm256_blendv_ps(b, a, mask); }
+static inline uint32_t maskVec(FloatVec a) { return static_cast<uint32_t>(_mm256_movemask_ps(a)); }
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+
+using FloatVec = __m128;
+static constexpr uint32_t FLOAT_VEC_WIDTH = 4;
+
+static inline FloatVec loadVec(float const* values) { return _mm_loadu_ps(values); }
+static inline void storeVec(float* values, FloatVec a) { _mm_storeu_ps(values, a); }
+static inline FloatVec splatVec(float value) { return _mm_set1_ps(value); }
+static inline FloatVec laneIndexVec() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+static inline FloatVec addVec(FloatVec a, FloatVec b) { return _mm_add_ps(a, b); }
+static inline FloatVec mulVec(FloatVec a, FloatVec b) { return _mm_mul_ps(a, b); }
+static inline FloatVec mulAddVec(FloatVec a, FloatVec b, FloatVec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+static inline FloatVec negateVec(FloatVec a) { return _mm_sub_ps(_mm_setzero_ps(), a); }
+static inline FloatVec minVec(FloatVec a, FloatVec b) { return _mm_min_ps(a, b); }
+static inline FloatVec greaterVec(FloatVec a, FloatVec b) { return _mm_cmpgt_ps(a, b); }
+static inline FloatVec greaterEqualVec(FloatVec a, FloatVec b) { return _mm_cmpge_ps(a, b); }
+static inline FloatVec andVec(FloatVec a, FloatVec b) { return _mm_and_ps(a, b); }
+// Lanes of a where the mask is set, b elsewhere
+static inline FloatVec selectVec(FloatVec mask, FloatVec a, FloatVec b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+static inline uint32_t maskVec(FloatVec a) { return static_cast<uint32_t>(_mm_movemask_ps(a)); }
+#else
+#include <cstring>
+
+struct FloatVec
+{
+	float lanes[4];
+};
+static constexpr uint32_t FLOAT_VEC_WIDTH = 4;
+
+// Comparisons set every bit of the lanes that pass, as the intrinsics do, so that masks combine bitwise
+static inline uint32_t getLaneBits(float lane) { uint32_t bits; std::memcpy(&bits, &lane, sizeof(bits)); return bits; }
+static inline float getMaskLane(bool isSet) { uint32_t bits = isSet ? ~0u : 0u; float lane; std::memcpy(&lane, &bits, sizeof(lane)); return lane; }
+
+static inline FloatVec loadVec(float const* values) { return { { values[0], values[1], values[2], values[3] } }; }
+static inline void storeVec(float* values, FloatVec a) { std::memcpy(values, a.lanes, sizeof(a.lanes)); }
+static inline FloatVec splatVec(float value) { return { { value, value, value, value } }; }
+static inline FloatVec laneIndexVec() { return { { 0.0f, 1.0f, 2.0f, 3.0f } }; }
+static inline FloatVec addVec(FloatVec a, FloatVec b)
+{
+	return { { a.lanes[0] + b.lanes[0], a.lanes[1] + b.lanes[1], a.lanes[2] + b.lanes[2], a.lanes[3] + b.lanes[3] } };
+}
+static inline FloatVec mulVec(FloatVec a, FloatVec b)
+{
+	return { { a.lanes[0] * b.lanes[0], a.lanes[1] * b.lanes[1], a.lanes[2] * b.lanes[2], a.lanes[3] * b.lanes[3] } };
+}
+static inline FloatVec mulAddVec(FloatVec a, FloatVec b, FloatVec c) { return addVec(mulVec(a, b), c); }
+static inline FloatVec negateVec(FloatVec a) { return { { -a.lanes[0], -a.lanes[1], -a.lanes[2], -a.lanes[3] } }; }
+static inline FloatVec minVec(FloatVec a, FloatVec b)
+{
+	FloatVec result;
+	for (uint32_t lane = 0; lane < FLOAT_VEC_WIDTH; ++lane)
+	{
+		result.lanes[lane] = b.lanes[lane] < a.lanes[lane] ? b.lanes[lane] : a.lanes[lane];
+	}
+	return result;
+}
+static inline FloatVec greaterVec(FloatVec a, FloatVec b)
+{
+	FloatVec result;
+	for (uint32_t lane = 0; lane < FLOAT_VEC_WIDTH; ++lane)
+	{
+		result.lanes[lane] = getMaskLane(a.lanes[lane] > b.lanes[lane]);
+	}
+	return result;
+}
+static inline FloatVec greaterEqualVec(FloatVec a, FloatVec b)
+{
+	FloatVec result;
+	for (uint32_t lane = 0; lane < FLOAT_VEC_WIDTH; ++lane)
+	{
+		result.lanes[lane] = getMaskLane(a.lanes[lane] >= b.lanes[lane]);
+	}
+	return result;
+}
+static inline FloatVec andVec(FloatVec a, FloatVec b)
+{
+	FloatVec result;
+	for (uint32_t lane = 0; lane < FLOAT_VEC_WIDTH; ++lane)
+	{
+		uint32_t bits = getLaneBits(a.lanes[lane]) & getLaneBits(b.lanes[lane]);
+		std::memcpy(&result.lanes[lane], &bits, sizeof(bits));
+	}
+	return result;
+}
+// Lanes of a where the mask is set, b elsewhere
+static inline FloatVec selectVec(FloatVec mask, FloatVec a, FloatVec b)
+{
+	FloatVec result;
+	for (uint32_t lane = 0; lane < FLOAT_VEC_WIDTH; ++lane)
+	{
+		result.lanes[lane] = (getLaneBits(mask.lanes[lane]) >> 31) ? a.lanes[lane] : b.lanes[lane];
+	}
+	return result;
+}
+static inline uint32_t maskVec(FloatVec a)
+{
+	uint32_t mask{ 0 };
+	for (uint32_t lane = 0; lane < FLOAT_VEC_WIDTH; ++lane)
+	{
+		mask |= (getLaneBits(a.lanes[lane]) >> 31) << lane;
+	}
+	return mask;
+}
+#endif
@@ -2,6 +2,8 @@
 
 #include "RenderPass.h"
 #include "EnvironmentCube.h"
+#include "GeometryArena.h"
+#include "DescriptorAllocator.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -12,13 +14,13 @@
 class SkyPass : public RenderPass
 {
 public:
-	SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadPool* threadPool, std::vector<Texture*>& colorTargets, VkQueue queue, uint32_t queueFamilyIdx);
+	SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, RenderThreadPool* threadPool, DescriptorAllocator* descriptorAllocator, std::vector<Texture*>& colorTargets,
+		VkQueue queue, uint32_t queueFamilyIdx, DeviceFeatures const& deviceFeatures);
 	virtual ~SkyPass() override;
 
 	virtual void renderImpl(Scene* scene, VkCommandBuffer commandBuffer, uint32_t bufferIdx, float dt) override;
 private:
-	VkDescriptorPool m_descriptorPool{ VK_NULL_HANDLE };
-
+	std::unique_ptr<GeometryArena> m_geometryArena{ nullptr };
 	std::unique_ptr<EnvironmentCube> m_environmentCube{ nullptr };
 };
 
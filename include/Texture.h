@@ -2,6 +2,9 @@
 
 #include <vulkan/vulkan.h>
 
+#include "MemoryAllocator.h"
+#include "DeviceFeatures.h"
+
 #include <string>
 #include <vector>
 
@@ -11,16 +14,27 @@ class ShadowPass;
 class LightingPass;
 class ImguiPass;
 class SceneObject;
+class Scene;
 class Renderer;
+class DepthPyramid;
+class BindlessTable;
 
 class Texture
 {
 public:
-	Texture(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuffer copyCommandBuffer, std::vector<std::string> const& filenames);
-	Texture(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage);
+	// Copied straight from host memory when the device has host image copies, otherwise through a staging buffer with
+	// copyCommandBuffer. Loads the block compressed KTX2 files cooked from the images when the device samples BCn
+	// formats and every image has one. Decoded images get a full mip chain, blitted on the GPU when the format can be
+	// and built on the CPU otherwise.
+	Texture(VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, VkCommandBuffer copyCommandBuffer, std::vector<std::string> const& filenames,
+		DeviceFeatures const& deviceFeatures);
+	Texture(VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage);
 	Texture(VkDevice device, uint32_t width, uint32_t height, VkFormat format, VkImage image);
 	~Texture();
 
+	// Frees the staging buffer once the copy command buffer has completed
+	void releaseStagingBuffer();
+
 private:
 	friend SkyPass;
 	friend GBufferPass;
@@ -28,24 +42,34 @@ private:
 	friend LightingPass;
 	friend ImguiPass;
 	friend SceneObject;
+	friend Scene;
 	friend Renderer;
+	friend DepthPyramid;
+	friend BindlessTable;
 
 	static constexpr uint32_t CUBE_LAYER_COUNT = 6;
 
-	void addBarrier(VkCommandBuffer commandBuffer, VkImageLayout prevLayout, VkImageLayout nextLayout);
+	// Whether the image can be host copied without losing sampling performance
+	static bool isHostImageCopyOptimal(VkPhysicalDevice physicalDevice, VkImageCreateInfo const& imageCreateInfo);
+	// Whether the mips of the format can be made with linear filtered blits
+	static bool isLinearBlitSupported(VkPhysicalDevice physicalDevice, VkFormat format);
+	void addBarrier(VkCommandBuffer commandBuffer, VkImageLayout prevLayout, VkImageLayout nextLayout, uint32_t baseMipLevel = 0, uint32_t levelCount = 1);
 
 	uint32_t m_width{ 0 };
 	uint32_t m_height{ 0 };
 	uint32_t m_layerCount{ 0 };
+	uint32_t m_mipLevelCount{ 1 };
 
 	VkDevice m_vkDevice{ VK_NULL_HANDLE };
+	// Null for the swap chain images, which own no memory
+	MemoryAllocator* m_allocator{ nullptr };
 	VkImage m_image{ VK_NULL_HANDLE };
-	VkDeviceMemory m_deviceMemory{ VK_NULL_HANDLE };
+	MemoryAllocator::Allocation m_allocation;
 	VkImageView m_imageView{ VK_NULL_HANDLE };
 	VkFormat m_format{ VK_FORMAT_UNDEFINED };
 	VkSampler m_sampler{ VK_NULL_HANDLE };
 
 	VkBuffer m_stagingBuffer{ VK_NULL_HANDLE };
-	VkDeviceMemory m_stagingMemory{ VK_NULL_HANDLE };
+	MemoryAllocator::Allocation m_stagingAllocation;
 };
 
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Buffer.h"
+#include "Renderer.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+// One persistently mapped uniform buffer with a region per frame in flight. Per-frame uniforms are bump-allocated from
+// the region of the frame and bound through VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptors that all point at the
+// buffer, so a layout needs a single descriptor set and a draw only passes its offset.
+class UniformArena
+{
+public:
+	static constexpr VkDeviceSize FRAME_CAPACITY = 64 << 10;
+
+	UniformArena(VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator);
+
+	// Frees the region of the frame, its previous use must have completed on the GPU
+	void reset(uint32_t bufferIdx);
+	// Copies the data into the region of the frame and returns its dynamic offset. Safe to call from any thread.
+	uint32_t push(uint32_t bufferIdx, void const* data, VkDeviceSize size);
+	template <typename T>
+	uint32_t push(uint32_t bufferIdx, T const& data)
+	{
+		return push(bufferIdx, &data, sizeof(T));
+	}
+
+	// The dynamic offsets are relative to the start of the buffer
+	VkDescriptorBufferInfo getDescriptorInfo(VkDeviceSize range) const;
+private:
+	std::unique_ptr<Buffer> m_buffer;
+	VkDeviceSize m_alignment{ 0 };
+
+	// Bytes allocated from the region of every frame
+	std::array<std::atomic<VkDeviceSize>, Renderer::BUFFER_COUNT> m_sizes{};
+};
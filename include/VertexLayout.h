@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <array>
+#include <cstdint>
+
+// Packed vertex attribute types. Each one maps to a single Vulkan vertex format through VertexFormat<T>.
+struct Half2
+{
+	uint32_t bits;
+};
+struct Snorm2x16
+{
+	uint32_t bits;
+};
+struct Snorm4x16
+{
+	uint16_t bits[4];
+};
+
+template<typename T> struct VertexFormat;
+template<> struct VertexFormat<glm::vec2> { static constexpr VkFormat value = VK_FORMAT_R32G32_SFLOAT; };
+template<> struct VertexFormat<glm::vec3> { static constexpr VkFormat value = VK_FORMAT_R32G32B32_SFLOAT; };
+template<> struct VertexFormat<glm::vec4> { static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT; };
+template<> struct VertexFormat<Half2> { static constexpr VkFormat value = VK_FORMAT_R16G16_SFLOAT; };
+template<> struct VertexFormat<Snorm2x16> { static constexpr VkFormat value = VK_FORMAT_R16G16_SNORM; };
+template<> struct VertexFormat<Snorm4x16> { static constexpr VkFormat value = VK_FORMAT_R16G16B16A16_SNORM; };
+
+// One vertex buffer binding whose attributes are tightly packed in the given order.
+template<uint32_t Binding, typename... Attributes>
+struct VertexStream
+{
+	static constexpr uint32_t BINDING = Binding;
+	static constexpr uint32_t ATTRIBUTE_COUNT = sizeof...(Attributes);
+	static constexpr uint32_t STRIDE = (0 + ... + static_cast<uint32_t>(sizeof(Attributes)));
+
+	static constexpr VkVertexInputBindingDescription binding()
+	{
+		return { Binding, STRIDE, VK_VERTEX_INPUT_RATE_VERTEX };
+	}
+
+	static constexpr std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> attributes(uint32_t firstLocation)
+	{
+		constexpr VkFormat formats[] = { VertexFormat<Attributes>::value... };
+		constexpr uint32_t sizes[] = { static_cast<uint32_t>(sizeof(Attributes))... };
+		std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> result{};
+		uint32_t offset = 0;
+		for (uint32_t i = 0; i < ATTRIBUTE_COUNT; ++i)
+		{
+			result[i] = { firstLocation + i, Binding, formats[i], offset };
+			offset += sizes[i];
+		}
+		return result;
+	}
+};
+
+template<typename... Streams>
+constexpr std::array<VkVertexInputAttributeDescription, (0 + ... + Streams::ATTRIBUTE_COUNT)> makeVertexAttributes()
+{
+	std::array<VkVertexInputAttributeDescription, (0 + ... + Streams::ATTRIBUTE_COUNT)> result{};
+	uint32_t location = 0;
+	auto append = [&](auto const& streamAttributes)
+	{
+		for (auto const& attribute : streamAttributes)
+		{
+			result[location++] = attribute;
+		}
+	};
+	(append(Streams::attributes(location)), ...);
+	return result;
+}
+
+// Vertex input state of a pipeline. Shader locations are assigned contiguously over all streams.
+template<typename... Streams>
+struct VertexInput
+{
+	static constexpr std::array<VkVertexInputBindingDescription, sizeof...(Streams)> bindings{ Streams::binding()... };
+	static constexpr auto attributes = makeVertexAttributes<Streams...>();
+
+	static VkPipelineVertexInputStateCreateInfo createInfo()
+	{
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
+		vertexInputInfo.pVertexBindingDescriptions = bindings.data();
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+		vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
+		return vertexInputInfo;
+	}
+};
+
+inline Half2 packHalf2(glm::vec2 const& v)
+{
+	return { glm::packHalf2x16(v) };
+}
+
+// Octahedral normal encoding, decoded by octDecode() in the vertex shaders
+inline Snorm2x16 packOctNormal(glm::vec3 n)
+{
+	n /= glm::max(glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z), 1e-8f);
+	glm::vec2 oct(n.x, n.y);
+	if (n.z < 0.0f)
+	{
+		glm::vec2 signs(oct.x >= 0.0f ? 1.0f : -1.0f, oct.y >= 0.0f ? 1.0f : -1.0f);
+		oct = (1.0f - glm::abs(glm::vec2(oct.y, oct.x))) * signs;
+	}
+	return { glm::packSnorm2x16(oct) };
+}
+
+// Full precision or quantized position, the latter expected to be in [-1, 1]
+inline void packPosition(glm::vec3& packed, glm::vec3 const& position)
+{
+	packed = position;
+}
+
+inline void packPosition(Snorm4x16& packed, glm::vec3 const& position)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		packed.bits[i] = glm::packSnorm1x16(position[i]);
+	}
+	packed.bits[3] = glm::packSnorm1x16(1.0f);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// CPU side scene work split into index ranges. The calling thread works along with the pool threads, so a pool
+// without threads runs everything inline. Only one parallelFor may run at a time.
+class WorkerPool
+{
+public:
+	// Runs the indices [first, last) on the worker with the given index
+	using RangeJob = std::function<void(uint32_t first, uint32_t last, uint32_t workerIdx)>;
+
+	// Outputs written by different ranges are kept this far apart, so that workers do not invalidate each other's caches
+	static constexpr uint32_t CACHE_LINE_SIZE = 64;
+
+	WorkerPool(uint32_t threadCount);
+	~WorkerPool();
+
+	// Workers including the calling thread, per worker outputs are indexed with workerIdx
+	uint32_t getWorkerCount() const;
+
+	// Splits [0, count) into ranges of grainSize indices and returns once all of them are done
+	void parallelFor(uint32_t count, uint32_t grainSize, RangeJob const& job);
+private:
+	void runRanges(uint32_t workerIdx);
+
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_jobDone;
+
+	RangeJob const* m_job{ nullptr };
+	uint32_t m_count{ 0 };
+	uint32_t m_grainSize{ 1 };
+	std::atomic<uint32_t> m_nextRange{ 0 };
+	uint32_t m_generation{ 0 };
+	uint32_t m_busyThreads{ 0 };
+
+	bool m_isRunning{ true };
+};
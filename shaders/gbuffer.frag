@@ -1,15 +1,28 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(set = 0, binding = 1) uniform sampler2D texSampler;
+#include "scene_common.glsl"
+
+// The bindless table, BindlessTable::MAX_TEXTURE_COUNT
+layout(set = 2, binding = 0) uniform sampler2D textures[1024];
+
+layout(std430, set = 2, binding = 1) readonly buffer Materials
+{
+    Material materials[];
+};
 
 layout(location = 0) in vec3 fragNormal;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterialIdx;
 
 layout(location = 0) out vec4 outColor;
 layout(location = 1) out vec4 outNormal;
 
 void main()
 {
-    outColor = texture(texSampler, fragTexCoord);
+    // Mesh shader workgroups and merged draws may mix materials, so the index is not dynamically uniform
+    Material material = materials[fragMaterialIdx];
+    outColor = texture(textures[nonuniformEXT(material.albedoTextureIdx)], fragTexCoord);
     outNormal = vec4(normalize(fragNormal), 0);
 }
\ No newline at end of file
@@ -1,9 +1,12 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
-layout(set = 0, binding = 0) uniform ModelTransforms
+#include "scene_common.glsl"
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects
 {
-    mat4 model;
-} modelTransforms;
+    ObjectData objects[];
+};
 
 layout(set = 1, binding = 0) uniform CameraTransforms
 {
@@ -12,19 +15,31 @@ layout(set = 1, binding = 0) uniform CameraTransforms
 } cameraTransform;
 
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
+layout(location = 1) in vec2 octNormal;
 layout(location = 2) in vec2 uvCoord;
 
 layout(location = 0) out vec3 fragNormal;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterialIdx;
+
+vec3 octDecode(vec2 oct)
+{
+    vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main()
 {
-	mat4 mvMatrix = cameraTransform.view * modelTransforms.model;
+	ObjectData object = objects[gl_InstanceIndex];
+	mat4 mvMatrix = cameraTransform.view * object.model;
     gl_Position = cameraTransform.projection * mvMatrix * vec4(position, 1.0);
 	
-	mat3 normMatrix = transpose(inverse(mat3(mvMatrix)));
-	fragNormal = normalize(normMatrix * normal);
+	// The view is rigid, so it transforms normals as it is
+	mat3 normMatrix = mat3(cameraTransform.view) * object.normalMatrix;
+	fragNormal = normalize(normMatrix * octDecode(octNormal));
     
 	fragTexCoord = uvCoord;
+	fragMaterialIdx = object.materialIdx;
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+// Shared by the cluster culling compute shader and the mesh shader path, matches Meshlet in MeshletBuilder.h
+struct Meshlet
+{
+    vec4 boundingSphere;
+    vec4 cone;
+    uint vertexOffset;
+    uint vertexCount;
+    uint triangleOffset;
+    uint triangleCount;
+};
+
+// Tests the sphere against the clip space planes of the model view projection, in the space of the sphere
+bool isSphereInFrustum(vec4 sphere, mat4 modelViewProjection)
+{
+    mat4 rows = transpose(modelViewProjection);
+    vec4 planes[6] = vec4[6](rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2]);
+    for (int i = 0; i < 6; ++i)
+    {
+        if (dot(planes[i].xyz, sphere.xyz) + planes[i].w < -sphere.w * length(planes[i].xyz))
+            return false;
+    }
+    return true;
+}
+
+// Frustum and normal cone test, done in the space of the packed positions where the meshlet bounds are stored
+bool isMeshletVisible(Meshlet meshlet, mat4 model, mat4 view, mat4 projection)
+{
+    if (!isSphereInFrustum(meshlet.boundingSphere, projection * view * model))
+        return false;
+
+    vec3 center = meshlet.boundingSphere.xyz;
+    float radius = meshlet.boundingSphere.w;
+
+    mat4 invModelView = inverse(view * model);
+    if (projection[2][3] != 0.0)
+    {
+        vec3 cameraPosition = (invModelView * vec4(0.0, 0.0, 0.0, 1.0)).xyz;
+        vec3 toCenter = center - cameraPosition;
+        return dot(toCenter, meshlet.cone.xyz) < meshlet.cone.w * length(toCenter) + radius;
+    }
+    vec3 viewDirection = normalize((invModelView * vec4(0.0, 0.0, -1.0, 0.0)).xyz);
+    return dot(viewDirection, meshlet.cone.xyz) < meshlet.cone.w;
+}
+
+vec3 octDecode(vec2 oct)
+{
+    vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// Snorm4x16 position, see packPosition() in VertexLayout.h
+vec3 decodePosition(uvec2 packedPosition)
+{
+    return vec3(unpackSnorm2x16(packedPosition.x), unpackSnorm2x16(packedPosition.y).x);
+}
@@ -0,0 +1,33 @@
+// Per object data and indirect draws of the scene, match ObjectData and DrawCommand in GBufferPass.h
+struct ObjectData
+{
+    mat4 model;
+    // Inverse transpose of the model matrix, computed on the CPU
+    mat3 normalMatrix;
+    // In the space of the packed positions
+    vec4 boundingSphere;
+    // Slot of the material in the bindless table
+    uint materialIdx;
+    uint baseVertex;
+};
+
+// Textures of a material are slots of the bindless texture array, matches BindlessTable::Material
+struct Material
+{
+    uint albedoTextureIdx;
+};
+
+// The first instance of a draw is the index of its object
+struct DrawCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+    uint meshletOffset;
+    uint meshletCount;
+    uint taskCountX;
+    uint taskCountY;
+    uint taskCountZ;
+};
@@ -1,9 +1,12 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
-layout(set = 0, binding = 0) uniform ModelTransforms
+#include "scene_common.glsl"
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects
 {
-    mat4 model;
-} modelTransforms;
+    ObjectData objects[];
+};
 
 layout(set = 1, binding = 0) uniform CameraTransforms
 {
@@ -12,19 +15,8 @@ layout(set = 1, binding = 0) uniform CameraTransforms
 } cameraTransform;
 
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec2 uvCoord;
-
-layout(location = 0) out vec3 fragNormal;
-layout(location = 1) out vec2 fragTexCoord;
 
 void main()
 {
-	mat4 mvMatrix = cameraTransform.view * modelTransforms.model;
-    gl_Position = cameraTransform.projection * mvMatrix * vec4(position, 1.0);
-	
-	mat3 normMatrix = transpose(inverse(mat3(mvMatrix)));
-	fragNormal = normalize(normMatrix * normal);
-    
-	fragTexCoord = uvCoord;
-}
\ No newline at end of file
+    gl_Position = cameraTransform.projection * cameraTransform.view * objects[gl_InstanceIndex].model * vec4(position, 1.0);
+}
@@ -1,6 +1,6 @@
 #version 450
 
-layout(set = 0, binding = 1) uniform samplerCube cubeSampler;
+layout(set = 0, binding = 0) uniform samplerCube cubeSampler;
 
 layout(location = 0) in vec3 fragTexCoord;
 
@@ -1,6 +1,7 @@
 #version 450
 
-layout(set = 0, binding = 0) uniform ModelTransforms
+// Per-draw data comes in push constants, the sets hold the per-frame and per-material data
+layout(push_constant) uniform ModelTransforms
 {
     mat4 model;
 } modelTransforms;
@@ -12,8 +13,6 @@ layout(set = 1, binding = 0) uniform CameraTransforms
 } cameraTransform;
 
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec2 uvCoord;
 
 layout(location = 0) out vec3 fragTexCoord;
 
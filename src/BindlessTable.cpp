@@ -0,0 +1,137 @@
+#include "BindlessTable.h"
+
+#include <iostream>
+#include <array>
+
+VkDescriptorSetLayout BindlessTable::createSetLayout(VkDevice device)
+{
+    std::array<VkDescriptorSetLayoutBinding, Binding::COUNT> bindings{};
+    bindings[TEXTURES].binding = TEXTURES;
+    bindings[TEXTURES].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[TEXTURES].descriptorCount = MAX_TEXTURE_COUNT;
+    bindings[TEXTURES].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[MATERIALS].binding = MATERIALS;
+    bindings[MATERIALS].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[MATERIALS].descriptorCount = 1;
+    bindings[MATERIALS].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    std::array<VkDescriptorBindingFlags, Binding::COUNT> bindingFlags{};
+    bindingFlags.fill(VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.pNext = &bindingFlagsInfo;
+    setLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    setLayoutInfo.pBindings = bindings.data();
+
+    VkDescriptorSetLayout setLayout{ VK_NULL_HANDLE };
+    VkResult result = vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &setLayout);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create bindless descriptor set layout!" << std::endl;
+        std::terminate();
+    }
+    return setLayout;
+}
+
+BindlessTable::BindlessTable(VkDevice device, MemoryAllocator* allocator, VkDescriptorSetLayout setLayout) :
+    m_device(device)
+{
+    std::array<VkDescriptorPoolSize, Binding::COUNT> poolSizes{};
+    poolSizes[TEXTURES].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[TEXTURES].descriptorCount = MAX_TEXTURE_COUNT;
+    poolSizes[MATERIALS].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[MATERIALS].descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
+    descriptorPoolCreateInfo.maxSets = 1;
+
+    VkResult result = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create bindless descriptor pool" << std::endl;
+        std::terminate();
+    }
+
+    VkDescriptorSetAllocateInfo descSetAllocInfo{};
+    descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descSetAllocInfo.descriptorPool = m_descriptorPool;
+    descSetAllocInfo.descriptorSetCount = 1;
+    descSetAllocInfo.pSetLayouts = &setLayout;
+    result = vkAllocateDescriptorSets(device, &descSetAllocInfo, &m_descriptorSet);
+    if (result != VK_SUCCESS) {
+        std::cout << "Failed to allocate bindless descriptor set" << std::endl;
+        std::terminate();
+    }
+
+    m_materialBuffer = std::make_unique<Buffer>(device, allocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(Material) * MAX_MATERIAL_COUNT,
+        MemoryAllocator::Category::UNIFORM);
+    VkDescriptorBufferInfo materialBufferInfo{ m_materialBuffer->m_vkBuffer, 0, VK_WHOLE_SIZE };
+
+    VkWriteDescriptorSet materialDescriptorWrite{};
+    materialDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    materialDescriptorWrite.dstSet = m_descriptorSet;
+    materialDescriptorWrite.dstBinding = MATERIALS;
+    materialDescriptorWrite.dstArrayElement = 0;
+    materialDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    materialDescriptorWrite.descriptorCount = 1;
+    materialDescriptorWrite.pBufferInfo = &materialBufferInfo;
+    vkUpdateDescriptorSets(device, 1, &materialDescriptorWrite, 0, nullptr);
+}
+
+BindlessTable::~BindlessTable()
+{
+    m_materialBuffer.reset();
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+}
+
+uint32_t BindlessTable::addTexture(Texture const& texture)
+{
+    if (m_textureCount == MAX_TEXTURE_COUNT)
+    {
+        std::cout << "Bindless texture array is full" << std::endl;
+        std::terminate();
+    }
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = texture.m_imageView;
+    imageInfo.sampler = texture.m_sampler;
+
+    VkWriteDescriptorSet textureDescriptorWrite{};
+    textureDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    textureDescriptorWrite.dstSet = m_descriptorSet;
+    textureDescriptorWrite.dstBinding = TEXTURES;
+    textureDescriptorWrite.dstArrayElement = m_textureCount;
+    textureDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    textureDescriptorWrite.descriptorCount = 1;
+    textureDescriptorWrite.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(m_device, 1, &textureDescriptorWrite, 0, nullptr);
+    return m_textureCount++;
+}
+
+uint32_t BindlessTable::addMaterial(Material const& material)
+{
+    if (m_materialCount == MAX_MATERIAL_COUNT)
+    {
+        std::cout << "Bindless material buffer is full" << std::endl;
+        std::terminate();
+    }
+    // New slots are not read by the frames in flight, so they can be written in place
+    m_materialBuffer->update(&material, sizeof(Material), sizeof(Material) * m_materialCount);
+    return m_materialCount++;
+}
+
+void BindlessTable::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set) const
+{
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &m_descriptorSet, 0, nullptr);
+}
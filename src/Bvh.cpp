@@ -0,0 +1,310 @@
+#include "Bvh.h"
+
+#include <array>
+#include <numeric>
+#include <algorithm>
+#include <chrono>
+
+enum PlaneSide
+{
+    OUTSIDE = 0,
+    INTERSECTING,
+    INSIDE
+};
+
+static PlaneSide classifyBox(std::vector<glm::vec4> const& planes, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax)
+{
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+    PlaneSide side = PlaneSide::INSIDE;
+    for (auto const& plane : planes)
+    {
+        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+        if (distance < -radius)
+            return PlaneSide::OUTSIDE;
+        if (distance < radius)
+        {
+            side = PlaneSide::INTERSECTING;
+        }
+    }
+    return side;
+}
+
+void Bvh::resize(uint32_t objectCount)
+{
+    if (m_rebuild.valid())
+    {
+        m_rebuild.wait();
+        m_rebuild = {};
+    }
+    m_tree = {};
+    m_boundsMin.resize(objectCount, glm::vec3(0.0f));
+    m_boundsMax.resize(objectCount, glm::vec3(0.0f));
+    m_isChanged.assign(objectCount, false);
+    m_changedObjects.clear();
+}
+
+void Bvh::setBounds(uint32_t objectIdx, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax)
+{
+    if (boundsMin == m_boundsMin[objectIdx] && boundsMax == m_boundsMax[objectIdx])
+        return;
+
+    m_boundsMin[objectIdx] = boundsMin;
+    m_boundsMax[objectIdx] = boundsMax;
+    if (!m_isChanged[objectIdx])
+    {
+        m_isChanged[objectIdx] = true;
+        m_changedObjects.emplace_back(objectIdx);
+    }
+}
+
+void Bvh::update()
+{
+    // A finished rebuild saw older bounds, it is refitted to the current ones as a whole
+    if (m_rebuild.valid() && m_rebuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        m_tree = m_rebuild.get();
+        refitAll();
+    }
+    else if (m_tree.nodes.empty() && !m_boundsMin.empty())
+    {
+        m_tree = build(m_boundsMin, m_boundsMax);
+        refitAll();
+    }
+    else
+    {
+        for (uint32_t objectIdx : m_changedObjects)
+        {
+            for (uint32_t nodeIdx = m_tree.objectLeaves[objectIdx]; nodeIdx != INVALID_IDX && refitNode(nodeIdx); nodeIdx = m_tree.nodes[nodeIdx].parent);
+        }
+    }
+
+    for (uint32_t objectIdx : m_changedObjects)
+    {
+        m_isChanged[objectIdx] = false;
+    }
+    m_changedObjects.clear();
+
+    if (!m_rebuild.valid() && m_area > m_builtArea * REBUILD_AREA_RATIO)
+    {
+        m_rebuild = std::async(std::launch::async, &Bvh::build, m_boundsMin, m_boundsMax);
+    }
+}
+
+float Bvh::getArea(glm::vec3 const& boundsMin, glm::vec3 const& boundsMax)
+{
+    // Half of the surface area, the ratios are all that matter
+    glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+Bvh::Tree Bvh::build(std::vector<glm::vec3> boundsMin, std::vector<glm::vec3> boundsMax)
+{
+    uint32_t objectCount = static_cast<uint32_t>(boundsMin.size());
+    Tree tree;
+    tree.objects.resize(objectCount);
+    std::iota(tree.objects.begin(), tree.objects.end(), 0);
+    tree.objectLeaves.resize(objectCount, INVALID_IDX);
+    if (objectCount == 0)
+        return tree;
+
+    std::vector<glm::vec3> centroids(objectCount);
+    for (uint32_t i = 0; i < objectCount; ++i)
+    {
+        centroids[i] = (boundsMin[i] + boundsMax[i]) * 0.5f;
+    }
+
+    tree.nodes.push_back({ glm::vec3(0.0f), 0, glm::vec3(0.0f), objectCount, 0, INVALID_IDX });
+    std::vector<uint32_t> stack{ 0 };
+    while (!stack.empty())
+    {
+        uint32_t nodeIdx = stack.back();
+        stack.pop_back();
+        Node node = tree.nodes[nodeIdx];
+        auto first = tree.objects.begin() + node.firstObject;
+        auto last = first + node.objectCount;
+
+        glm::vec3 nodeMin(std::numeric_limits<float>::max());
+        glm::vec3 nodeMax(-std::numeric_limits<float>::max());
+        glm::vec3 centroidMin(std::numeric_limits<float>::max());
+        glm::vec3 centroidMax(-std::numeric_limits<float>::max());
+        for (auto object = first; object != last; ++object)
+        {
+            nodeMin = glm::min(nodeMin, boundsMin[*object]);
+            nodeMax = glm::max(nodeMax, boundsMax[*object]);
+            centroidMin = glm::min(centroidMin, centroids[*object]);
+            centroidMax = glm::max(centroidMax, centroids[*object]);
+        }
+        tree.nodes[nodeIdx].boundsMin = nodeMin;
+        tree.nodes[nodeIdx].boundsMax = nodeMax;
+
+        if (node.objectCount <= MAX_LEAF_SIZE)
+        {
+            for (auto object = first; object != last; ++object)
+            {
+                tree.objectLeaves[*object] = nodeIdx;
+            }
+            continue;
+        }
+
+        // The split between two bins with the smallest surface area times object count on both sides wins
+        auto getBin = [&](uint32_t object, uint32_t axis)
+        {
+            float binScale = BIN_COUNT / (centroidMax[axis] - centroidMin[axis]);
+            return std::min(static_cast<uint32_t>((centroids[object][axis] - centroidMin[axis]) * binScale), BIN_COUNT - 1);
+        };
+        float bestCost = std::numeric_limits<float>::max();
+        uint32_t bestAxis = INVALID_IDX;
+        uint32_t bestBin = 0;
+        for (uint32_t axis = 0; axis < 3; ++axis)
+        {
+            if (centroidMax[axis] <= centroidMin[axis])
+                continue;
+
+            struct Bin
+            {
+                glm::vec3 boundsMin{ std::numeric_limits<float>::max() };
+                glm::vec3 boundsMax{ -std::numeric_limits<float>::max() };
+                uint32_t objectCount{ 0 };
+            };
+            std::array<Bin, BIN_COUNT> bins;
+            for (auto object = first; object != last; ++object)
+            {
+                Bin& bin = bins[getBin(*object, axis)];
+                bin.boundsMin = glm::min(bin.boundsMin, boundsMin[*object]);
+                bin.boundsMax = glm::max(bin.boundsMax, boundsMax[*object]);
+                ++bin.objectCount;
+            }
+
+            std::array<float, BIN_COUNT - 1> leftCosts;
+            std::array<uint32_t, BIN_COUNT - 1> leftCounts;
+            Bin left;
+            for (uint32_t i = 0; i + 1 < BIN_COUNT; ++i)
+            {
+                left.boundsMin = glm::min(left.boundsMin, bins[i].boundsMin);
+                left.boundsMax = glm::max(left.boundsMax, bins[i].boundsMax);
+                left.objectCount += bins[i].objectCount;
+                leftCosts[i] = getArea(left.boundsMin, left.boundsMax) * left.objectCount;
+                leftCounts[i] = left.objectCount;
+            }
+            Bin right;
+            for (uint32_t i = BIN_COUNT - 1; i > 0; --i)
+            {
+                right.boundsMin = glm::min(right.boundsMin, bins[i].boundsMin);
+                right.boundsMax = glm::max(right.boundsMax, bins[i].boundsMax);
+                right.objectCount += bins[i].objectCount;
+                float cost = leftCosts[i - 1] + getArea(right.boundsMin, right.boundsMax) * right.objectCount;
+                if (leftCounts[i - 1] > 0 && right.objectCount > 0 && cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = i - 1;
+                }
+            }
+        }
+
+        // Objects whose centroids all coincide are split in half
+        uint32_t leftCount = node.objectCount / 2;
+        if (bestAxis != INVALID_IDX)
+        {
+            auto middle = std::partition(first, last, [&](uint32_t object) { return getBin(object, bestAxis) <= bestBin; });
+            leftCount = static_cast<uint32_t>(middle - first);
+        }
+
+        uint32_t firstChild = static_cast<uint32_t>(tree.nodes.size());
+        tree.nodes[nodeIdx].firstChild = firstChild;
+        tree.nodes.push_back({ glm::vec3(0.0f), node.firstObject, glm::vec3(0.0f), leftCount, 0, nodeIdx });
+        tree.nodes.push_back({ glm::vec3(0.0f), node.firstObject + leftCount, glm::vec3(0.0f), node.objectCount - leftCount, 0, nodeIdx });
+        stack.emplace_back(firstChild);
+        stack.emplace_back(firstChild + 1);
+    }
+    return tree;
+}
+
+bool Bvh::refitNode(uint32_t nodeIdx)
+{
+    Node& node = m_tree.nodes[nodeIdx];
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    if (node.firstChild == 0)
+    {
+        for (uint32_t i = node.firstObject; i < node.firstObject + node.objectCount; ++i)
+        {
+            boundsMin = glm::min(boundsMin, m_boundsMin[m_tree.objects[i]]);
+            boundsMax = glm::max(boundsMax, m_boundsMax[m_tree.objects[i]]);
+        }
+    }
+    else
+    {
+        Node const& firstChild = m_tree.nodes[node.firstChild];
+        Node const& secondChild = m_tree.nodes[node.firstChild + 1];
+        boundsMin = glm::min(firstChild.boundsMin, secondChild.boundsMin);
+        boundsMax = glm::max(firstChild.boundsMax, secondChild.boundsMax);
+    }
+
+    if (boundsMin == node.boundsMin && boundsMax == node.boundsMax)
+        return false;
+    m_area += getArea(boundsMin, boundsMax) - getArea(node.boundsMin, node.boundsMax);
+    node.boundsMin = boundsMin;
+    node.boundsMax = boundsMax;
+    return true;
+}
+
+void Bvh::refitAll()
+{
+    // Children come after their parents, so walking backwards refits them first
+    for (uint32_t nodeIdx = static_cast<uint32_t>(m_tree.nodes.size()); nodeIdx-- > 0;)
+    {
+        refitNode(nodeIdx);
+    }
+    m_area = 0.0f;
+    for (auto const& node : m_tree.nodes)
+    {
+        m_area += getArea(node.boundsMin, node.boundsMax);
+    }
+    m_builtArea = m_area;
+}
+
+void Bvh::query(std::vector<glm::vec4> const& planes, std::vector<uint32_t>& insideObjects, std::vector<uint32_t>& intersectingObjects) const
+{
+    if (m_tree.nodes.empty())
+        return;
+
+    std::vector<uint32_t> stack{ 0 };
+    while (!stack.empty())
+    {
+        Node const& node = m_tree.nodes[stack.back()];
+        stack.pop_back();
+        PlaneSide side = classifyBox(planes, node.boundsMin, node.boundsMax);
+        if (side == PlaneSide::OUTSIDE)
+            continue;
+
+        auto first = m_tree.objects.begin() + node.firstObject;
+        auto last = first + node.objectCount;
+        if (side == PlaneSide::INSIDE)
+        {
+            insideObjects.insert(insideObjects.end(), first, last);
+        }
+        else if (node.firstChild == 0)
+        {
+            for (auto object = first; object != last; ++object)
+            {
+                PlaneSide objectSide = classifyBox(planes, m_boundsMin[*object], m_boundsMax[*object]);
+                if (objectSide == PlaneSide::INSIDE)
+                {
+                    insideObjects.emplace_back(*object);
+                }
+                else if (objectSide == PlaneSide::INTERSECTING)
+                {
+                    intersectingObjects.emplace_back(*object);
+                }
+            }
+        }
+        else
+        {
+            stack.emplace_back(node.firstChild);
+            stack.emplace_back(node.firstChild + 1);
+        }
+    }
+}
@@ -10,58 +10,29 @@
 
 #include <array>
 
-Camera::Camera(Type type, VkPhysicalDevice physicalDevice, VkDevice device, VkDescriptorSetAllocateInfo descSetAllocInfo) :
-    m_type(type)
+Camera::Camera(Type type, UniformArena* uniformArena, DescriptorAllocator* descriptorAllocator, VkDescriptorSetLayout setLayout) :
+    m_uniformArena(uniformArena)
+    , m_type(type)
 {
-    m_descriptorSets.resize(Renderer::BUFFER_COUNT);
-    VkResult result = vkAllocateDescriptorSets(device, &descSetAllocInfo, m_descriptorSets.data());
-    if (result != VK_SUCCESS) {
-        std::cout << "Failed to allocate descriptor sets" << std::endl;
-        std::terminate();
-    }
-    
-    GBufferPass::CameraTransforms cameraTransforms{};
     if (m_type == NORMAL)
     {
         const float aspectRatio = Renderer::WINDOW_WIDTH / static_cast<float>(Renderer::WINDOW_HEIGHT);
-        cameraTransforms.projection = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 100.0f);
+        m_projection = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 100.0f);
         m_position = glm::vec3(-2.2f, 0.7f, 4.2f);
         m_direction = -glm::vec3(-3.0f, 0.7f, 3.0f);
     }
     else if (m_type == LIGHT)
     {
-        constexpr float HALF_WIDTH = 2.2f;
-        cameraTransforms.projection = glm::ortho(-HALF_WIDTH, HALF_WIDTH, -HALF_WIDTH, HALF_WIDTH, -9.0f, 20.0f);
+        m_projection = glm::ortho(-LIGHT_HALF_WIDTH, LIGHT_HALF_WIDTH, -LIGHT_HALF_WIDTH, LIGHT_HALF_WIDTH, LIGHT_NEAR, LIGHT_FAR);
         m_position = glm::vec3(1.0f, 5.0f, 8.0f);
         m_direction = glm::vec3(-0.1f, -0.7f, -1.0f);
     }
-    cameraTransforms.projection[1][1] *= -1;
-    cameraTransforms.view = glm::lookAt(m_position, m_position + m_direction, glm::vec3(0.0f, 1.0f, 0.0f));
-    m_view = cameraTransforms.view;
-    m_projection = cameraTransforms.projection;
-
-    for (uint32_t i = 0; i < Renderer::BUFFER_COUNT; ++i)
-    {
-        m_uniformBuffers.emplace_back(std::make_unique<Buffer>(physicalDevice, device, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(GBufferPass::CameraTransforms)));
-        VkDescriptorBufferInfo uniformBufferInfo{};
-        uniformBufferInfo.buffer = m_uniformBuffers[i]->m_vkBuffer;
-        uniformBufferInfo.offset = 0;
-        uniformBufferInfo.range = sizeof(GBufferPass::CameraTransforms);
-
-        VkWriteDescriptorSet uniformBufferDescriptorWrite{};
-        uniformBufferDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        uniformBufferDescriptorWrite.dstSet = m_descriptorSets[i];
-        uniformBufferDescriptorWrite.dstBinding = 0;
-        uniformBufferDescriptorWrite.dstArrayElement = 0;
-        uniformBufferDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        uniformBufferDescriptorWrite.descriptorCount = 1;
-        uniformBufferDescriptorWrite.pBufferInfo = &uniformBufferInfo;
-
-        std::array<VkWriteDescriptorSet, 1> descriptorWrites{ uniformBufferDescriptorWrite };
-        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    m_projection[1][1] *= -1;
+    m_view = glm::lookAt(m_position, m_position + m_direction, glm::vec3(0.0f, 1.0f, 0.0f));
 
-        m_uniformBuffers[i]->update(&cameraTransforms, sizeof(GBufferPass::CameraTransforms));
-    }
+    // Every camera binds the same arena range, the cached set is shared and the dynamic offset tells them apart
+    m_descriptorSet = descriptorAllocator->getSet(setLayout, {
+        DescriptorAllocator::Binding::buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, m_uniformArena->getDescriptorInfo(sizeof(GBufferPass::CameraTransforms))) });
 }
 
 void Camera::update(uint32_t bufferIdx)
@@ -70,12 +41,12 @@ void Camera::update(uint32_t bufferIdx)
     m_view = glm::lookAt(m_position, m_position + m_direction, glm::vec3(0.0f, 1.0f, 0.0f));
     cameraTransforms.view = m_view;
     cameraTransforms.projection = m_projection;
-    m_uniformBuffers[bufferIdx]->update(&cameraTransforms, sizeof(GBufferPass::CameraTransforms));
+    m_uniformOffsets[bufferIdx] = m_uniformArena->push(bufferIdx, cameraTransforms);
 }
 
-void Camera::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bufferIdx)
+void Camera::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bufferIdx, VkPipelineBindPoint bindPoint)
 {
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &m_descriptorSets[bufferIdx], 0, nullptr);
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, 1, 1, &m_descriptorSet, 1, &m_uniformOffsets[bufferIdx]);
 }
 
 void Camera::move(glm::vec3 direction, uint32_t bufferIdx)
@@ -95,4 +66,16 @@ void Camera::turn(glm::vec2 direction, uint32_t bufferIdx)
     auto rightDir = glm::vec3(-m_direction.z, 0, m_direction.x);
     rotMat = glm::rotate(rotMat, direction.y * SPEED, rightDir);
     m_direction = rotMat * glm::vec4(m_direction, 1.0f);
-}
\ No newline at end of file
+}
+
+void Camera::extendTowardLight(float nearDistance)
+{
+    m_lightNear = glm::min(nearDistance, LIGHT_NEAR);
+    m_projection = glm::ortho(-LIGHT_HALF_WIDTH, LIGHT_HALF_WIDTH, -LIGHT_HALF_WIDTH, LIGHT_HALF_WIDTH, m_lightNear, LIGHT_FAR);
+    m_projection[1][1] *= -1;
+}
+
+float Camera::getLightDepthRange() const
+{
+    return LIGHT_FAR - m_lightNear;
+}
@@ -0,0 +1,111 @@
+#include "ClusterCuller.h"
+
+#include "Renderer.h"
+#include "RenderPass.h"
+#include "Camera.h"
+
+#include <iostream>
+#include <array>
+
+ClusterCuller::ClusterCuller(VkDevice device, VkDescriptorSetLayout cameraSetLayout) :
+    m_vkDevice(device)
+{
+    // Objects, meshlets, meshlet vertices, meshlet triangles, culled indices and the draw commands
+    std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); ++i)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    setLayoutInfo.pBindings = bindings.data();
+
+    VkResult result = vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &m_setLayout);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create cluster culling descriptor set layout!" << std::endl;
+        std::terminate();
+    }
+
+    // First draw of the culling phase
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(uint32_t);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    std::array<VkDescriptorSetLayout, 2> descSetLayouts{ m_setLayout, cameraSetLayout };
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create cluster culling pipeline layout" << std::endl;
+        std::terminate();
+    }
+
+    auto computeShaderSrc = RenderPass::readFile("shaders/cluster_cull_comp.spv");
+
+    VkShaderModuleCreateInfo shaderModuleCreateInfo{};
+    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleCreateInfo.codeSize = computeShaderSrc.size();
+    shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(computeShaderSrc.data());
+    VkShaderModule computeShader;
+    result = vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &computeShader);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create shader module" << std::endl;
+        std::terminate();
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = computeShader;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipelineLayout;
+
+    result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create cluster culling pipeline" << std::endl;
+        std::terminate();
+    }
+
+    vkDestroyShaderModule(device, computeShader, nullptr);
+}
+
+ClusterCuller::~ClusterCuller()
+{
+    vkDestroyPipeline(m_vkDevice, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_vkDevice, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_vkDevice, m_setLayout, nullptr);
+}
+
+void ClusterCuller::cull(VkCommandBuffer commandBuffer, Camera& camera, VkDescriptorSet cullSet, uint32_t bufferIdx, VkBuffer drawBuffer, VkDeviceSize dispatchOffset, uint32_t firstDraw)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &cullSet, 0, nullptr);
+    camera.bind(commandBuffer, m_pipelineLayout, bufferIdx, VK_PIPELINE_BIND_POINT_COMPUTE);
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(firstDraw), &firstDraw);
+
+    // The draw culling counts the visible draws into the dispatch, workgroups past the meshlet count of their draw exit right away
+    vkCmdDispatchIndirect(commandBuffer, drawBuffer, dispatchOffset);
+
+    VkMemoryBarrier cullBarrier{};
+    cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
\ No newline at end of file
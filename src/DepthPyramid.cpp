@@ -0,0 +1,307 @@
+#include "DepthPyramid.h"
+
+#include "Texture.h"
+#include "RenderPass.h"
+
+#include <iostream>
+#include <array>
+#include <algorithm>
+
+static uint32_t getPreviousPowerOfTwo(uint32_t value)
+{
+    uint32_t powerOfTwo = 1;
+    while (powerOfTwo * 2 <= value)
+    {
+        powerOfTwo *= 2;
+    }
+    return powerOfTwo;
+}
+
+DepthPyramid::DepthPyramid(VkDevice device, MemoryAllocator* allocator, Texture* depthBuffer) :
+    m_width(getPreviousPowerOfTwo(depthBuffer->m_width))
+    , m_height(getPreviousPowerOfTwo(depthBuffer->m_height))
+    , m_vkDevice(device)
+    , m_allocator(allocator)
+{
+    m_levelCount = 1;
+    while ((std::max(m_width, m_height) >> m_levelCount) > 0)
+    {
+        ++m_levelCount;
+    }
+
+    VkImageCreateInfo imageCreateInfo{};
+    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.extent.width = m_width;
+    imageCreateInfo.extent.height = m_height;
+    imageCreateInfo.extent.depth = 1;
+    imageCreateInfo.mipLevels = m_levelCount;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult result{ VK_SUCCESS };
+    for (Frame& frame : m_frames)
+    {
+        result = vkCreateImage(m_vkDevice, &imageCreateInfo, nullptr, &frame.image);
+        if (result != VK_SUCCESS)
+        {
+            std::cout << "Failed to create depth pyramid image" << std::endl;
+            std::terminate();
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(m_vkDevice, frame.image, &memRequirements);
+        frame.allocation = m_allocator->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryAllocator::Pool::OPTIMAL,
+            MemoryAllocator::Category::RENDER_TARGET);
+        vkBindImageMemory(m_vkDevice, frame.image, frame.allocation.memory, frame.allocation.offset);
+
+        // A view of every level for the occlusion tests, and one per level for building the pyramid
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = frame.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = m_levelCount;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        result = vkCreateImageView(m_vkDevice, &viewInfo, nullptr, &frame.imageView);
+        if (result != VK_SUCCESS)
+        {
+            std::cout << "Failed to create depth pyramid image view" << std::endl;
+            std::terminate();
+        }
+        frame.levelViews.resize(m_levelCount);
+        for (uint32_t level = 0; level < m_levelCount; ++level)
+        {
+            viewInfo.subresourceRange.baseMipLevel = level;
+            viewInfo.subresourceRange.levelCount = 1;
+            result = vkCreateImageView(m_vkDevice, &viewInfo, nullptr, &frame.levelViews[level]);
+            if (result != VK_SUCCESS)
+            {
+                std::cout << "Failed to create depth pyramid image view" << std::endl;
+                std::terminate();
+            }
+        }
+    }
+
+    // Texels are only ever fetched, never filtered
+    VkSamplerCreateInfo samplerCreateInfo{};
+    samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.anisotropyEnable = VK_FALSE;
+    samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerCreateInfo.compareEnable = VK_FALSE;
+    samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.maxLod = static_cast<float>(m_levelCount);
+    result = vkCreateSampler(m_vkDevice, &samplerCreateInfo, nullptr, &m_sampler);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create depth pyramid sampler" << std::endl;
+        std::terminate();
+    }
+
+    // The level below, or the depth buffer for the first level, and the level being written
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    setLayoutInfo.pBindings = bindings.data();
+    result = vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &m_setLayout);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create depth pyramid descriptor set layout!" << std::endl;
+        std::terminate();
+    }
+
+    uint32_t setCount = m_levelCount * Renderer::BUFFER_COUNT;
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = setCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = setCount;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = setCount;
+    result = vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create descriptor pool" << std::endl;
+        std::terminate();
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts(m_levelCount, m_setLayout);
+    VkDescriptorSetAllocateInfo descSetAllocInfo{};
+    descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descSetAllocInfo.descriptorPool = m_descriptorPool;
+    descSetAllocInfo.descriptorSetCount = m_levelCount;
+    descSetAllocInfo.pSetLayouts = setLayouts.data();
+    for (Frame& frame : m_frames)
+    {
+        frame.descriptorSets.resize(m_levelCount);
+        result = vkAllocateDescriptorSets(device, &descSetAllocInfo, frame.descriptorSets.data());
+        if (result != VK_SUCCESS) {
+            std::cout << "Failed to allocate descriptor sets" << std::endl;
+            std::terminate();
+        }
+
+        for (uint32_t level = 0; level < m_levelCount; ++level)
+        {
+            VkDescriptorImageInfo srcInfo{};
+            srcInfo.sampler = m_sampler;
+            srcInfo.imageView = level == 0 ? depthBuffer->m_imageView : frame.levelViews[level - 1];
+            srcInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+            VkDescriptorImageInfo dstInfo{};
+            dstInfo.imageView = frame.levelViews[level];
+            dstInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+            std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[0].dstSet = frame.descriptorSets[level];
+            descriptorWrites[0].dstBinding = 0;
+            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptorWrites[0].descriptorCount = 1;
+            descriptorWrites[0].pImageInfo = &srcInfo;
+            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[1].dstSet = frame.descriptorSets[level];
+            descriptorWrites[1].dstBinding = 1;
+            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            descriptorWrites[1].descriptorCount = 1;
+            descriptorWrites[1].pImageInfo = &dstInfo;
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(glm::uvec2);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create depth pyramid pipeline layout" << std::endl;
+        std::terminate();
+    }
+
+    auto computeShaderSrc = RenderPass::readFile("shaders/depth_reduce_comp.spv");
+
+    VkShaderModuleCreateInfo shaderModuleCreateInfo{};
+    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleCreateInfo.codeSize = computeShaderSrc.size();
+    shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(computeShaderSrc.data());
+    VkShaderModule computeShader;
+    result = vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &computeShader);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create shader module" << std::endl;
+        std::terminate();
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = computeShader;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipelineLayout;
+
+    result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create depth pyramid pipeline" << std::endl;
+        std::terminate();
+    }
+
+    vkDestroyShaderModule(device, computeShader, nullptr);
+}
+
+DepthPyramid::~DepthPyramid()
+{
+    vkDestroyPipeline(m_vkDevice, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_vkDevice, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_vkDevice, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_vkDevice, m_setLayout, nullptr);
+    vkDestroySampler(m_vkDevice, m_sampler, nullptr);
+    for (Frame& frame : m_frames)
+    {
+        for (VkImageView levelView : frame.levelViews)
+        {
+            vkDestroyImageView(m_vkDevice, levelView, nullptr);
+        }
+        vkDestroyImageView(m_vkDevice, frame.imageView, nullptr);
+        vkDestroyImage(m_vkDevice, frame.image, nullptr);
+        m_allocator->free(frame.allocation);
+    }
+}
+
+void DepthPyramid::build(VkCommandBuffer commandBuffer, glm::mat4 const& viewProjection, uint32_t bufferIdx)
+{
+    Frame& frame = m_frames[bufferIdx];
+
+    // Every level is rewritten, so the previous contents are discarded once the earlier occlusion tests are done
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask = 0;
+    imageBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = frame.image;
+    imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageBarrier.subresourceRange.baseMipLevel = 0;
+    imageBarrier.subresourceRange.levelCount = m_levelCount;
+    imageBarrier.subresourceRange.baseArrayLayer = 0;
+    imageBarrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+
+    // Each level reads the one written before it, the last barrier makes the whole pyramid visible to the culling
+    VkMemoryBarrier levelBarrier{};
+    levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    for (uint32_t level = 0; level < m_levelCount; ++level)
+    {
+        glm::uvec2 levelSize{ std::max(m_width >> level, 1u), std::max(m_height >> level, 1u) };
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &frame.descriptorSets[level], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(levelSize), &levelSize);
+        vkCmdDispatch(commandBuffer, (levelSize.x + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, (levelSize.y + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    frame.viewProjection = viewProjection;
+    frame.built = true;
+}
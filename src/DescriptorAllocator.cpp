@@ -0,0 +1,166 @@
+#include "DescriptorAllocator.h"
+
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+
+// Non-dispatchable handles are pointers on 64-bit platforms and integers elsewhere
+template <typename T>
+static uint64_t toKey(T handle)
+{
+    if constexpr (std::is_pointer_v<T>)
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle));
+    else
+        return static_cast<uint64_t>(handle);
+}
+
+DescriptorAllocator::Binding DescriptorAllocator::Binding::buffer(VkDescriptorType type, VkDescriptorBufferInfo const& bufferInfo)
+{
+    return { type, bufferInfo, {} };
+}
+
+DescriptorAllocator::Binding DescriptorAllocator::Binding::image(VkDescriptorType type, VkDescriptorImageInfo const& imageInfo)
+{
+    return { type, {}, imageInfo };
+}
+
+size_t DescriptorAllocator::KeyHash::operator()(std::vector<uint64_t> const& key) const
+{
+    size_t hash = key.size();
+    for (uint64_t word : key)
+    {
+        hash ^= std::hash<uint64_t>()(word) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+DescriptorAllocator::DescriptorAllocator(VkDevice device) :
+    m_device(device)
+{
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+    for (auto& [layout, chain] : m_chains)
+    {
+        for (VkDescriptorPool pool : chain.pools)
+        {
+            vkDestroyDescriptorPool(m_device, pool, nullptr);
+        }
+    }
+}
+
+VkDescriptorSet DescriptorAllocator::getSet(VkDescriptorSetLayout layout, std::vector<Binding> const& bindings)
+{
+    std::vector<uint64_t> key{ toKey(layout) };
+    for (Binding const& binding : bindings)
+    {
+        key.insert(key.end(), {
+            static_cast<uint64_t>(binding.type),
+            toKey(binding.bufferInfo.buffer), binding.bufferInfo.offset, binding.bufferInfo.range,
+            toKey(binding.imageInfo.sampler), toKey(binding.imageInfo.imageView), static_cast<uint64_t>(binding.imageInfo.imageLayout) });
+    }
+
+    std::unique_lock lock(m_mutex);
+    auto cached = m_cache.find(key);
+    if (cached != m_cache.end())
+        return cached->second;
+
+    VkDescriptorSet descriptorSet = allocate(layout, bindings);
+    m_cache.emplace(std::move(key), descriptorSet);
+    return descriptorSet;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout, std::vector<Binding> const& bindings)
+{
+    PoolChain& chain = m_chains[layout];
+    if (chain.setSizes.empty())
+    {
+        // The first set of the layout tells what its sets hold
+        for (Binding const& binding : bindings)
+        {
+            auto size = std::find_if(chain.setSizes.begin(), chain.setSizes.end(), [&binding](VkDescriptorPoolSize const& setSize)
+            {
+                return setSize.type == binding.type;
+            });
+            if (size == chain.setSizes.end())
+            {
+                chain.setSizes.push_back({ binding.type, 0 });
+                size = chain.setSizes.end() - 1;
+            }
+            ++size->descriptorCount;
+        }
+    }
+
+    VkDescriptorSetAllocateInfo descSetAllocInfo{};
+    descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descSetAllocInfo.descriptorSetCount = 1;
+    descSetAllocInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+    while (true)
+    {
+        if (chain.currentPool == chain.pools.size())
+        {
+            std::vector<VkDescriptorPoolSize> poolSizes = chain.setSizes;
+            for (auto& poolSize : poolSizes)
+            {
+                poolSize.descriptorCount *= chain.nextPoolSetCount;
+            }
+            VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+            descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+            descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
+            descriptorPoolCreateInfo.maxSets = chain.nextPoolSetCount;
+
+            VkDescriptorPool pool{ VK_NULL_HANDLE };
+            VkResult result = vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, nullptr, &pool);
+            if (result != VK_SUCCESS)
+            {
+                std::cout << "Failed to create descriptor pool" << std::endl;
+                std::terminate();
+            }
+            chain.pools.emplace_back(pool);
+            chain.nextPoolSetCount = std::min(chain.nextPoolSetCount * 2, MAX_POOL_SET_COUNT);
+        }
+
+        descSetAllocInfo.descriptorPool = chain.pools[chain.currentPool];
+        VkResult result = vkAllocateDescriptorSets(m_device, &descSetAllocInfo, &descriptorSet);
+        if (result == VK_SUCCESS)
+            break;
+
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+        {
+            std::cout << "Failed to allocate descriptor sets" << std::endl;
+            std::terminate();
+        }
+        ++chain.currentPool;
+    }
+
+    write(descriptorSet, bindings);
+    return descriptorSet;
+}
+
+void DescriptorAllocator::write(VkDescriptorSet descriptorSet, std::vector<Binding> const& bindings) const
+{
+    std::vector<VkWriteDescriptorSet> descriptorWrites(bindings.size());
+    for (uint32_t binding = 0; binding < descriptorWrites.size(); ++binding)
+    {
+        descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[binding].dstSet = descriptorSet;
+        descriptorWrites[binding].dstBinding = binding;
+        descriptorWrites[binding].dstArrayElement = 0;
+        descriptorWrites[binding].descriptorType = bindings[binding].type;
+        descriptorWrites[binding].descriptorCount = 1;
+        if (bindings[binding].type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || bindings[binding].type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+            bindings[binding].type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
+        {
+            descriptorWrites[binding].pImageInfo = &bindings[binding].imageInfo;
+        }
+        else
+        {
+            descriptorWrites[binding].pBufferInfo = &bindings[binding].bufferInfo;
+        }
+    }
+    vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
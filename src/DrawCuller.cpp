@@ -0,0 +1,127 @@
+#include "DrawCuller.h"
+
+#include "RenderPass.h"
+#include "Camera.h"
+#include "DepthPyramid.h"
+
+#include <iostream>
+#include <array>
+
+DrawCuller::DrawCuller(VkDevice device, VkDescriptorSetLayout cameraSetLayout) :
+    m_vkDevice(device)
+{
+    // Objects, candidate draws, draw commands, the candidates drawn in the early phase and the depth pyramid
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); ++i)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    setLayoutInfo.pBindings = bindings.data();
+
+    VkResult result = vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &m_setLayout);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create draw culling descriptor set layout!" << std::endl;
+        std::terminate();
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    std::array<VkDescriptorSetLayout, 2> descSetLayouts{ m_setLayout, cameraSetLayout };
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create draw culling pipeline layout" << std::endl;
+        std::terminate();
+    }
+
+    auto computeShaderSrc = RenderPass::readFile("shaders/draw_cull_comp.spv");
+
+    VkShaderModuleCreateInfo shaderModuleCreateInfo{};
+    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleCreateInfo.codeSize = computeShaderSrc.size();
+    shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(computeShaderSrc.data());
+    VkShaderModule computeShader;
+    result = vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &computeShader);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create shader module" << std::endl;
+        std::terminate();
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = computeShader;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipelineLayout;
+
+    result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create draw culling pipeline" << std::endl;
+        std::terminate();
+    }
+
+    vkDestroyShaderModule(device, computeShader, nullptr);
+}
+
+DrawCuller::~DrawCuller()
+{
+    vkDestroyPipeline(m_vkDevice, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_vkDevice, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_vkDevice, m_setLayout, nullptr);
+}
+
+void DrawCuller::cull(VkCommandBuffer commandBuffer, Camera& camera, VkDescriptorSet cullSet, uint32_t bufferIdx, DepthPyramid const* depthPyramid,
+    uint32_t phase, uint32_t candidateCount, uint32_t maxDrawCount, bool meshShading)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &cullSet, 0, nullptr);
+    camera.bind(commandBuffer, m_pipelineLayout, bufferIdx, VK_PIPELINE_BIND_POINT_COMPUTE);
+
+    PushConstants pushConstants{};
+    pushConstants.phase = phase;
+    pushConstants.maxDrawCount = maxDrawCount;
+    if (depthPyramid && depthPyramid->m_frames[bufferIdx].built)
+    {
+        pushConstants.occlusionViewProjection = depthPyramid->m_frames[bufferIdx].viewProjection;
+        pushConstants.depthPyramidSize = glm::vec2(depthPyramid->m_width, depthPyramid->m_height);
+        pushConstants.depthPyramidLevelCount = depthPyramid->m_levelCount;
+        pushConstants.occlusionCulling = 1;
+    }
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+    vkCmdDispatch(commandBuffer, (candidateCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+    // The cluster culling reads the draws and is dispatched indirectly, the task shaders read the draws themselves
+    VkMemoryBarrier cullBarrier{};
+    cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+    if (meshShading)
+    {
+        dstStages |= VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT;
+    }
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStages, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
@@ -0,0 +1,256 @@
+#include "EntityStore.h"
+
+#include "Simd.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+// A column of the transforms of SIMD width entities
+struct ColumnVec
+{
+    FloatVec x;
+    FloatVec y;
+    FloatVec z;
+};
+
+static ColumnVec loadColumn(std::array<float, FLOAT_VEC_WIDTH> const* rows)
+{
+    return { loadVec(rows[0].data()), loadVec(rows[1].data()), loadVec(rows[2].data()) };
+}
+
+static void storeColumn(std::array<float, FLOAT_VEC_WIDTH>* rows, ColumnVec const& column)
+{
+    storeVec(rows[0].data(), column.x);
+    storeVec(rows[1].data(), column.y);
+    storeVec(rows[2].data(), column.z);
+}
+
+// a * weight + b
+static ColumnVec mulAddColumn(ColumnVec const& a, FloatVec weight, ColumnVec const& b)
+{
+    return { mulAddVec(a.x, weight, b.x), mulAddVec(a.y, weight, b.y), mulAddVec(a.z, weight, b.z) };
+}
+
+static ColumnVec mulColumn(ColumnVec const& a, FloatVec weight)
+{
+    return { mulVec(a.x, weight), mulVec(a.y, weight), mulVec(a.z, weight) };
+}
+
+// The rotation times a column whose rows are structure-of-arrays elements
+static ColumnVec rotateColumn(ColumnVec const* rotation, std::vector<float> const* column, uint32_t base)
+{
+    ColumnVec rotated = mulColumn(rotation[0], loadVec(&column[0][base]));
+    rotated = mulAddColumn(rotation[1], loadVec(&column[1][base]), rotated);
+    return mulAddColumn(rotation[2], loadVec(&column[2][base]), rotated);
+}
+
+uint32_t EntityStore::add(Desc const& desc)
+{
+    uint32_t entityIdx = getCount();
+    if (desc.parent != INVALID_IDX && desc.parent >= entityIdx)
+    {
+        std::cout << "Failed to add entity, its parent must be added before it" << std::endl;
+        std::terminate();
+    }
+    // Roots are on the first level, children on the one after their parent
+    uint32_t level = 0;
+    if (desc.parent != INVALID_IDX)
+    {
+        level = static_cast<uint32_t>(std::upper_bound(m_levelEnds.begin(), m_levelEnds.end(), desc.parent) - m_levelEnds.begin()) + 1;
+    }
+    if (level + 1 == getLevelCount())
+    {
+        m_levelEnds.back() = entityIdx + 1;
+    }
+    else if (level == getLevelCount())
+    {
+        m_levelEnds.emplace_back(entityIdx + 1);
+    }
+    else
+    {
+        std::cout << "Failed to add entity, the entities must be added level by level" << std::endl;
+        std::terminate();
+    }
+
+    m_meshes.emplace_back(desc.mesh);
+    m_materials.emplace_back(desc.material);
+    m_baseVertices.emplace_back(desc.baseVertex);
+    m_parents.emplace_back(desc.parent);
+    m_parentVersions.emplace_back(0);
+    m_spinAngles.emplace_back(0.0f);
+    m_spinSpeeds.emplace_back(desc.spinSpeed);
+    m_isMoved.emplace_back(true);
+    m_versions.emplace_back(0);
+    m_worldNodes.emplace_back(1.0f);
+    m_modelMatrices.emplace_back(1.0f);
+    m_normalMatrices.emplace_back(1.0f);
+    m_boundingSpheres.emplace_back(desc.boundingSphere);
+    m_boundsMin.emplace_back(desc.boundsMin);
+    m_boundsMax.emplace_back(desc.boundsMax);
+
+    // Padding lanes are computed along with the rest and never written out
+    size_t paddedCount = entityIdx + FLOAT_VEC_WIDTH;
+    auto setPadded = [entityIdx, paddedCount](std::vector<float>& values, float value)
+    {
+        values.resize(paddedCount, 0.0f);
+        values[entityIdx] = value;
+    };
+    setPadded(m_positionX, desc.position.x);
+    setPadded(m_positionY, desc.position.y);
+    setPadded(m_positionZ, desc.position.z);
+    glm::mat3 localNormalMatrix = glm::transpose(glm::inverse(glm::mat3(desc.localTransform)));
+    for (uint32_t column = 0; column < 4; ++column)
+    {
+        for (uint32_t row = 0; row < 3; ++row)
+        {
+            setPadded(m_localTransforms[column * 3 + row], desc.localTransform[column][row]);
+            if (column < 3)
+            {
+                setPadded(m_localNormalMatrices[column * 3 + row], localNormalMatrix[column][row]);
+            }
+        }
+    }
+    setPadded(m_spinCos, 1.0f);
+    setPadded(m_spinSin, 0.0f);
+    return entityIdx;
+}
+
+uint32_t EntityStore::getCount() const
+{
+    return static_cast<uint32_t>(m_meshes.size());
+}
+
+uint32_t EntityStore::getLevelCount() const
+{
+    return static_cast<uint32_t>(m_levelEnds.size());
+}
+
+void EntityStore::getLevel(uint32_t level, uint32_t& first, uint32_t& last) const
+{
+    first = level > 0 ? m_levelEnds[level - 1] : 0;
+    last = m_levelEnds[level];
+}
+
+void EntityStore::animate(float dt, uint32_t first, uint32_t last)
+{
+    constexpr float twoPi = glm::two_pi<float>();
+    for (uint32_t i = first; i < last; ++i)
+    {
+        if (m_spinSpeeds[i] == 0.0f || dt == 0.0f)
+            continue;
+
+        m_isMoved[i] = true;
+        // Wrapped so that the angle keeps its precision however long the scene runs
+        m_spinAngles[i] = std::fmod(m_spinAngles[i] + dt * m_spinSpeeds[i], twoPi);
+        m_spinCos[i] = std::cos(m_spinAngles[i]);
+        m_spinSin[i] = std::sin(m_spinAngles[i]);
+    }
+}
+
+void EntityStore::updateTransforms(uint32_t first, uint32_t last)
+{
+    static glm::mat4x3 const rootNode(1.0f);
+    std::array<std::array<float, FLOAT_VEC_WIDTH>, AFFINE_ELEMENT_COUNT> elements;
+    std::array<bool, FLOAT_VEC_WIDTH> isDirty;
+    for (uint32_t base = first; base < last; base += FLOAT_VEC_WIDTH)
+    {
+        // Unchanged branches only cost a flag and a version compare per entity
+        uint32_t laneCount = std::min(FLOAT_VEC_WIDTH, last - base);
+        bool isAnyDirty = false;
+        for (uint32_t lane = 0; lane < FLOAT_VEC_WIDTH; ++lane)
+        {
+            uint32_t entityIdx = base + lane;
+            uint32_t parent = lane < laneCount ? m_parents[entityIdx] : INVALID_IDX;
+            isDirty[lane] = lane < laneCount && (m_isMoved[entityIdx] || (parent != INVALID_IDX && m_versions[parent] != m_parentVersions[entityIdx]));
+            isAnyDirty = isAnyDirty || isDirty[lane];
+
+            // The parent nodes are gathered into lanes, the roots hang from the identity
+            glm::mat4x3 const& parentNode = parent != INVALID_IDX ? m_worldNodes[parent] : rootNode;
+            for (uint32_t column = 0; column < 4; ++column)
+            {
+                for (uint32_t row = 0; row < 3; ++row)
+                {
+                    elements[column * 3 + row][lane] = parentNode[column][row];
+                }
+            }
+        }
+        if (!isAnyDirty)
+            continue;
+
+        std::array<ColumnVec, 4> parent{ loadColumn(&elements[0]), loadColumn(&elements[3]), loadColumn(&elements[6]), loadColumn(&elements[9]) };
+
+        // The node spins about the up axis of its parent, which mixes the x and z columns and keeps y
+        FloatVec spinCos = loadVec(&m_spinCos[base]);
+        FloatVec spinSin = loadVec(&m_spinSin[base]);
+        std::array<ColumnVec, 4> node;
+        node[0] = mulAddColumn(parent[0], spinCos, mulColumn(parent[2], negateVec(spinSin)));
+        node[1] = parent[1];
+        node[2] = mulAddColumn(parent[0], spinSin, mulColumn(parent[2], spinCos));
+        node[3] = mulAddColumn(parent[0], loadVec(&m_positionX[base]), parent[3]);
+        node[3] = mulAddColumn(parent[1], loadVec(&m_positionY[base]), node[3]);
+        node[3] = mulAddColumn(parent[2], loadVec(&m_positionZ[base]), node[3]);
+
+        // The nodes, model and normal matrices go through the same lanes one after another
+        auto scatter = [&](uint32_t columnCount, auto writeColumn)
+        {
+            for (uint32_t lane = 0; lane < laneCount; ++lane)
+            {
+                if (!isDirty[lane])
+                    continue;
+
+                for (uint32_t column = 0; column < columnCount; ++column)
+                {
+                    writeColumn(base + lane, column, glm::vec3(elements[column * 3][lane], elements[column * 3 + 1][lane], elements[column * 3 + 2][lane]));
+                }
+            }
+        };
+        for (uint32_t column = 0; column < 4; ++column)
+        {
+            storeColumn(&elements[column * 3], node[column]);
+        }
+        scatter(4, [this](uint32_t entityIdx, uint32_t column, glm::vec3 const& value)
+        {
+            m_worldNodes[entityIdx][column] = value;
+        });
+
+        for (uint32_t column = 0; column < 4; ++column)
+        {
+            ColumnVec model = rotateColumn(node.data(), &m_localTransforms[column * 3], base);
+            if (column == 3)
+            {
+                model = { addVec(model.x, node[3].x), addVec(model.y, node[3].y), addVec(model.z, node[3].z) };
+            }
+            storeColumn(&elements[column * 3], model);
+        }
+        scatter(4, [this](uint32_t entityIdx, uint32_t column, glm::vec3 const& value)
+        {
+            m_modelMatrices[entityIdx][column] = glm::vec4(value, column == 3 ? 1.0f : 0.0f);
+        });
+
+        for (uint32_t column = 0; column < 3; ++column)
+        {
+            storeColumn(&elements[column * 3], rotateColumn(node.data(), &m_localNormalMatrices[column * 3], base));
+        }
+        scatter(3, [this](uint32_t entityIdx, uint32_t column, glm::vec3 const& value)
+        {
+            m_normalMatrices[entityIdx][column] = glm::vec4(value, 0.0f);
+        });
+
+        for (uint32_t lane = 0; lane < laneCount; ++lane)
+        {
+            uint32_t entityIdx = base + lane;
+            if (!isDirty[lane])
+                continue;
+
+            m_isMoved[entityIdx] = false;
+            if (m_parents[entityIdx] != INVALID_IDX)
+            {
+                m_parentVersions[entityIdx] = m_versions[m_parents[entityIdx]];
+            }
+            ++m_versions[entityIdx];
+        }
+    }
+}
@@ -7,9 +7,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-EnvironmentCube::EnvironmentCube(uint32_t id, VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuffer copyCommandBuffer,
-    VkDescriptorSetAllocateInfo descSetAllocInfo) :
-    SceneObject::SceneObject(id, physicalDevice, device, copyCommandBuffer, descSetAllocInfo)
+EnvironmentCube::EnvironmentCube(uint32_t id, VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, VkCommandBuffer copyCommandBuffer,
+    GeometryArena& geometryArena, DescriptorAllocator* descriptorAllocator, VkDescriptorSetLayout setLayout,
+    DeviceFeatures const& deviceFeatures) :
+    SceneObject::SceneObject(id, physicalDevice, device, copyCommandBuffer, geometryArena, descriptorAllocator, setLayout)
 {
     m_vertices = {
         {{-0.5f, -0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f}},
@@ -51,15 +52,11 @@ EnvironmentCube::EnvironmentCube(uint32_t id, VkPhysicalDevice physicalDevice, V
         20, 21, 22, 22, 23, 20
     };
 
-    m_albedoMap = std::make_unique<Texture>(physicalDevice, device, copyCommandBuffer, ALBEDO_FILENAMES);
+    m_albedoMap = std::make_unique<Texture>(physicalDevice, device, allocator, copyCommandBuffer, ALBEDO_FILENAMES, deviceFeatures);
 
     SceneObject::SceneObject::init();
-}
 
-void EnvironmentCube::update(uint32_t bufferIdx, float dt)
-{
-    GBufferPass::ModelTransforms modelTransforms{};
+    // The sky never moves
     constexpr float scale = 50.0f;
-    modelTransforms.model = glm::scale(glm::mat4(1.0f), glm::vec3(scale, scale, scale));
-    m_uniformBuffers[bufferIdx]->update(&modelTransforms, sizeof(GBufferPass::ModelTransforms));
+    m_modelTransforms.model = glm::scale(glm::mat4(1.0f), glm::vec3(scale, scale, scale)) * m_dequantizeTransform;
 }
\ No newline at end of file
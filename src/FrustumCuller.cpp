@@ -0,0 +1,167 @@
+#include "FrustumCuller.h"
+
+#include <array>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+// A plane splatted across the lanes. Kept as plain floats, vector types lose their alignment as template arguments.
+struct alignas(32) PlaneLanes
+{
+    float x[FLOAT_VEC_WIDTH];
+    float y[FLOAT_VEC_WIDTH];
+    float z[FLOAT_VEC_WIDTH];
+    float w[FLOAT_VEC_WIDTH];
+    // Absolute normals, for the projected radius of the boxes
+    float absX[FLOAT_VEC_WIDTH];
+    float absY[FLOAT_VEC_WIDTH];
+    float absZ[FLOAT_VEC_WIDTH];
+};
+
+void FrustumCuller::resize(uint32_t objectCount)
+{
+    m_objectCount = objectCount;
+    for (auto* values : { &m_sphereX, &m_sphereY, &m_sphereZ, &m_sphereRadius, &m_boxX, &m_boxY, &m_boxZ, &m_boxExtentX, &m_boxExtentY, &m_boxExtentZ })
+    {
+        values->resize(objectCount, 0.0f);
+    }
+}
+
+void FrustumCuller::setBounds(uint32_t objectIdx, glm::mat4 const& model, glm::vec4 const& boundingSphere, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax)
+{
+    glm::vec3 sphereCenter = model * glm::vec4(glm::vec3(boundingSphere), 1.0f);
+    float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    m_sphereX[objectIdx] = sphereCenter.x;
+    m_sphereY[objectIdx] = sphereCenter.y;
+    m_sphereZ[objectIdx] = sphereCenter.z;
+    m_sphereRadius[objectIdx] = boundingSphere.w * scale;
+
+    // Box around the transformed box, its extent along each world axis sums the transformed half sizes
+    glm::vec3 boxCenter = model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f);
+    glm::vec3 halfSize = (boundsMax - boundsMin) * 0.5f;
+    glm::mat3 absModel(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])));
+    glm::vec3 boxExtent = absModel * halfSize;
+    m_boxX[objectIdx] = boxCenter.x;
+    m_boxY[objectIdx] = boxCenter.y;
+    m_boxZ[objectIdx] = boxCenter.z;
+    m_boxExtentX[objectIdx] = boxExtent.x;
+    m_boxExtentY[objectIdx] = boxExtent.y;
+    m_boxExtentZ[objectIdx] = boxExtent.z;
+}
+
+std::vector<glm::vec4> FrustumCuller::getFrustumPlanes(glm::mat4 const& viewProjection)
+{
+    glm::mat4 rows = glm::transpose(viewProjection);
+    std::vector<glm::vec4> planes{ rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2] };
+    for (auto& plane : planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return planes;
+}
+
+std::vector<glm::vec4> FrustumCuller::getShadowCasterPlanes(glm::mat4 const& lightViewProjection, glm::mat4 const& receiverViewProjection,
+    glm::vec3 const& lightDirection, float shadowLength)
+{
+    std::vector<glm::vec4> planes = getFrustumPlanes(lightViewProjection);
+
+    // Bounds swept along the light are behind a receiver plane only when both ends are, so the plane is pushed back by
+    // how far the sweep can move toward it
+    glm::vec3 sweep = glm::normalize(lightDirection) * shadowLength;
+    for (glm::vec4 plane : getFrustumPlanes(receiverViewProjection))
+    {
+        plane.w += glm::max(glm::dot(glm::vec3(plane), sweep), 0.0f);
+        planes.emplace_back(plane);
+    }
+    return planes;
+}
+
+void FrustumCuller::getBox(uint32_t objectIdx, glm::vec3& boxMin, glm::vec3& boxMax) const
+{
+    glm::vec3 center(m_boxX[objectIdx], m_boxY[objectIdx], m_boxZ[objectIdx]);
+    glm::vec3 extent(m_boxExtentX[objectIdx], m_boxExtentY[objectIdx], m_boxExtentZ[objectIdx]);
+    boxMin = center - extent;
+    boxMax = center + extent;
+}
+
+float FrustumCuller::getMinDistance(glm::vec3 const& origin, glm::vec3 const& direction, uint32_t first, uint32_t last) const
+{
+    glm::vec3 unitDirection = glm::normalize(direction);
+    float minDistance = std::numeric_limits<float>::max();
+    for (uint32_t i = first; i < last; ++i)
+    {
+        glm::vec3 center(m_sphereX[i], m_sphereY[i], m_sphereZ[i]);
+        minDistance = glm::min(minDistance, glm::dot(center - origin, unitDirection) - m_sphereRadius[i]);
+    }
+    return minDistance;
+}
+
+void FrustumCuller::cull(std::vector<glm::vec4> const& planes, uint32_t const* objects, uint32_t objectCount, std::vector<uint32_t>& visibleObjects) const
+{
+    std::vector<PlaneLanes> planeLanes(planes.size());
+    for (size_t i = 0; i < planes.size(); ++i)
+    {
+        glm::vec4 const& plane = planes[i];
+        std::fill_n(planeLanes[i].x, FLOAT_VEC_WIDTH, plane.x);
+        std::fill_n(planeLanes[i].y, FLOAT_VEC_WIDTH, plane.y);
+        std::fill_n(planeLanes[i].z, FLOAT_VEC_WIDTH, plane.z);
+        std::fill_n(planeLanes[i].w, FLOAT_VEC_WIDTH, plane.w);
+        std::fill_n(planeLanes[i].absX, FLOAT_VEC_WIDTH, std::abs(plane.x));
+        std::fill_n(planeLanes[i].absY, FLOAT_VEC_WIDTH, std::abs(plane.y));
+        std::fill_n(planeLanes[i].absZ, FLOAT_VEC_WIDTH, std::abs(plane.z));
+    }
+
+    // The objects are gathered into lanes, a partial last vector repeats its first object
+    enum Lane { SPHERE_X = 0, SPHERE_Y, SPHERE_Z, SPHERE_RADIUS, BOX_X, BOX_Y, BOX_Z, BOX_EXTENT_X, BOX_EXTENT_Y, BOX_EXTENT_Z, LANE_COUNT };
+    std::array<std::vector<float> const*, LANE_COUNT> sources{ &m_sphereX, &m_sphereY, &m_sphereZ, &m_sphereRadius, &m_boxX, &m_boxY, &m_boxZ,
+        &m_boxExtentX, &m_boxExtentY, &m_boxExtentZ };
+    std::array<std::array<float, SIMD_WIDTH>, LANE_COUNT> lanes;
+    for (uint32_t base = 0; base < objectCount; base += SIMD_WIDTH)
+    {
+        uint32_t laneCount = std::min(SIMD_WIDTH, objectCount - base);
+        for (uint32_t lane = 0; lane < SIMD_WIDTH; ++lane)
+        {
+            uint32_t objectIdx = objects[base + (lane < laneCount ? lane : 0)];
+            for (uint32_t i = 0; i < LANE_COUNT; ++i)
+            {
+                lanes[i][lane] = (*sources[i])[objectIdx];
+            }
+        }
+
+        FloatVec sphereX = loadVec(lanes[SPHERE_X].data());
+        FloatVec sphereY = loadVec(lanes[SPHERE_Y].data());
+        FloatVec sphereZ = loadVec(lanes[SPHERE_Z].data());
+        FloatVec negSphereRadius = negateVec(loadVec(lanes[SPHERE_RADIUS].data()));
+        FloatVec boxX = loadVec(lanes[BOX_X].data());
+        FloatVec boxY = loadVec(lanes[BOX_Y].data());
+        FloatVec boxZ = loadVec(lanes[BOX_Z].data());
+        FloatVec boxExtentX = loadVec(lanes[BOX_EXTENT_X].data());
+        FloatVec boxExtentY = loadVec(lanes[BOX_EXTENT_Y].data());
+        FloatVec boxExtentZ = loadVec(lanes[BOX_EXTENT_Z].data());
+
+        FloatVec inside = greaterVec(splatVec(1.0f), splatVec(0.0f));
+        for (size_t i = 0; i < planes.size(); ++i)
+        {
+            FloatVec planeX = loadVec(planeLanes[i].x);
+            FloatVec planeY = loadVec(planeLanes[i].y);
+            FloatVec planeZ = loadVec(planeLanes[i].z);
+            FloatVec planeW = loadVec(planeLanes[i].w);
+            FloatVec sphereDistance = mulAddVec(planeX, sphereX, mulAddVec(planeY, sphereY, mulAddVec(planeZ, sphereZ, planeW)));
+            inside = andVec(inside, greaterVec(sphereDistance, negSphereRadius));
+
+            FloatVec boxDistance = mulAddVec(planeX, boxX, mulAddVec(planeY, boxY, mulAddVec(planeZ, boxZ, planeW)));
+            FloatVec boxRadius = mulAddVec(loadVec(planeLanes[i].absX), boxExtentX, mulAddVec(loadVec(planeLanes[i].absY), boxExtentY,
+                mulVec(loadVec(planeLanes[i].absZ), boxExtentZ)));
+            inside = andVec(inside, greaterVec(boxDistance, negateVec(boxRadius)));
+        }
+
+        uint32_t mask = maskVec(inside);
+        for (uint32_t lane = 0; lane < laneCount; ++lane)
+        {
+            if (mask & (1u << lane))
+            {
+                visibleObjects.emplace_back(objects[base + lane]);
+            }
+        }
+    }
+}
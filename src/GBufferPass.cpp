@@ -1,15 +1,20 @@
 #include "GBufferPass.h"
 
 #include "Texture.h"
+#include "BindlessTable.h"
 #include "Scene.h"
 
 #include <iostream>
 #include <array>
 
-GBufferPass::GBufferPass(VkDevice device, RenderThreadPool* threadPool, std::vector<Texture*>& colorTargets, Texture* depthTarget) :
+GBufferPass::GBufferPass(VkDevice device, RenderThreadPool* threadPool, std::vector<Texture*>& colorTargets, Texture* depthTarget, DepthPyramid* depthPyramid,
+    DeviceFeatures const& deviceFeatures) :
 	RenderPass::RenderPass(device, threadPool, 2)
+    , m_depthPyramid(depthPyramid)
 {
     m_hasDepthAttachment = true;
+    // The mesh shaders decode the quantized positions themselves
+    m_meshShading = deviceFeatures.meshShader && QUANTIZED_POSITIONS;
 
     std::array<VkAttachmentDescription, 3> attachmentDescriptions;
     attachmentDescriptions[0].flags = 0;
@@ -64,23 +69,40 @@ GBufferPass::GBufferPass(VkDevice device, RenderThreadPool* threadPool, std::vec
     renderPassCreateInfo.pAttachments = attachmentDescriptions.data();
     renderPassCreateInfo.subpassCount = 1;
     renderPassCreateInfo.pSubpasses = &subpassDesc;
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcAccessMask = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    if (depthTarget)
+    // The late pass loads what the early one wrote, after the depth pyramid has been built from its depth
+    std::array<VkSubpassDependency, 2> dependencies{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    // The depth pyramid is built from the depth of the early pass
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassCreateInfo.pDependencies = dependencies.data();
+
+    VkResult result = vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &m_vkRenderPass);
+    if (result != VK_SUCCESS)
     {
-        dependency.srcStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        std::cout << "Failed to create render pass" << std::endl;
+        std::terminate();
     }
-    renderPassCreateInfo.dependencyCount = 1;
-    renderPassCreateInfo.pDependencies = &dependency;
 
-    VkResult result = vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &m_vkRenderPass);
+    // Same attachments, so the pass is compatible with the framebuffer and the pipeline
+    for (auto& attachmentDescription : attachmentDescriptions)
+    {
+        attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachmentDescription.initialLayout = attachmentDescription.finalLayout;
+    }
+    result = vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &m_loadRenderPass);
     if (result != VK_SUCCESS)
     {
         std::cout << "Failed to create render pass" << std::endl;
@@ -109,17 +131,25 @@ GBufferPass::GBufferPass(VkDevice device, RenderThreadPool* threadPool, std::vec
     m_targetWidth = colorTargets[0]->m_width;
     m_targetHeight = colorTargets[0]->m_height;
 
-    auto vertexShaderSrc = readFile("shaders/gbuffer_vert.spv");
+    // Vertices come either from the vertex shader or from the task and mesh shaders
+    auto geometryShaderSrc = readFile(m_meshShading ? "shaders/gbuffer_mesh.spv" : "shaders/gbuffer_vert.spv");
     auto fragmentShaderSrc = readFile("shaders/gbuffer_frag.spv");
 
-    VkShaderModule vertexShader = createVkShader(vertexShaderSrc);
+    VkShaderModule geometryShader = createVkShader(geometryShaderSrc);
     VkShaderModule fragmentShader = createVkShader(fragmentShaderSrc);
+    VkShaderModule taskShader = m_meshShading ? createVkShader(readFile("shaders/meshlet_task.spv")) : VK_NULL_HANDLE;
 
-    VkPipelineShaderStageCreateInfo vertexShaderStageInfo{};
-    vertexShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertexShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertexShaderStageInfo.module = vertexShader;
-    vertexShaderStageInfo.pName = "main";
+    VkPipelineShaderStageCreateInfo taskShaderStageInfo{};
+    taskShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    taskShaderStageInfo.stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+    taskShaderStageInfo.module = taskShader;
+    taskShaderStageInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo geometryShaderStageInfo{};
+    geometryShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    geometryShaderStageInfo.stage = m_meshShading ? VK_SHADER_STAGE_MESH_BIT_EXT : VK_SHADER_STAGE_VERTEX_BIT;
+    geometryShaderStageInfo.module = geometryShader;
+    geometryShaderStageInfo.pName = "main";
 
     VkPipelineShaderStageCreateInfo fragmentShaderStageInfo{};
     fragmentShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -127,33 +157,13 @@ GBufferPass::GBufferPass(VkDevice device, RenderThreadPool* threadPool, std::vec
     fragmentShaderStageInfo.module = fragmentShader;
     fragmentShaderStageInfo.pName = "main";
 
-    VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderStageInfo, fragmentShaderStageInfo };
-
-    VkVertexInputBindingDescription bindingDescription{};
-    bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(Vertex);
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-    attributeDescriptions[0].binding = 0;
-    attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[0].offset = offsetof(Vertex, position);
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset = offsetof(Vertex, normal);
-    attributeDescriptions[2].binding = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset = offsetof(Vertex, uvCoord);
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    std::vector<VkPipelineShaderStageCreateInfo> shaderStages{ geometryShaderStageInfo, fragmentShaderStageInfo };
+    if (m_meshShading)
+    {
+        shaderStages.insert(shaderStages.begin(), taskShaderStageInfo);
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = PackedVertexInput::createInfo();
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -209,22 +219,17 @@ GBufferPass::GBufferPass(VkDevice device, RenderThreadPool* threadPool, std::vec
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
+    VkShaderStageFlags meshStages = m_meshShading ? VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT : 0;
+
     VkDescriptorSetLayoutBinding modelTransformLayoutBinding{};
     modelTransformLayoutBinding.binding = 0;
-    modelTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    modelTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     modelTransformLayoutBinding.descriptorCount = 1;
-    modelTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-    VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-    samplerLayoutBinding.binding = 1;
-    samplerLayoutBinding.descriptorCount = 1;
-    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerLayoutBinding.pImmutableSamplers = nullptr;
-    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    modelTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | meshStages;
 
     VkDescriptorSetLayoutCreateInfo modelDescSetLayoutInfo{};
     modelDescSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    std::array<VkDescriptorSetLayoutBinding, 2> modelBindings = { modelTransformLayoutBinding, samplerLayoutBinding };
+    std::array<VkDescriptorSetLayoutBinding, 1> modelBindings = { modelTransformLayoutBinding };
     modelDescSetLayoutInfo.bindingCount = static_cast<uint32_t>(modelBindings.size());
     modelDescSetLayoutInfo.pBindings = modelBindings.data();
 
@@ -237,9 +242,10 @@ GBufferPass::GBufferPass(VkDevice device, RenderThreadPool* threadPool, std::vec
 
     VkDescriptorSetLayoutBinding cameraTransformLayoutBinding{};
     cameraTransformLayoutBinding.binding = 0;
-    cameraTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    cameraTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     cameraTransformLayoutBinding.descriptorCount = 1;
-    cameraTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    // The camera sets are bound with the layouts of every pass and the cluster culling, so they must all match
+    cameraTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_ALL;
 
     VkDescriptorSetLayoutCreateInfo cameraDescSetLayoutInfo{};
     cameraDescSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -254,11 +260,47 @@ GBufferPass::GBufferPass(VkDevice device, RenderThreadPool* threadPool, std::vec
         std::terminate();
     }
 
+    // Textures and materials of the whole scene
+    m_bindlessSetLayout = BindlessTable::createSetLayout(device);
+
+    // Meshlets, meshlet vertices, meshlet triangles, positions, attributes and draw commands of the mesh shader path
+    std::array<VkDescriptorSetLayoutBinding, 6> meshletBindings{};
+    for (uint32_t i = 0; i < meshletBindings.size(); ++i)
+    {
+        meshletBindings[i].binding = i;
+        meshletBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        meshletBindings[i].descriptorCount = 1;
+        meshletBindings[i].stageFlags = meshStages;
+    }
+
+    if (m_meshShading)
+    {
+        VkDescriptorSetLayoutCreateInfo meshletDescSetLayoutInfo{};
+        meshletDescSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        meshletDescSetLayoutInfo.bindingCount = static_cast<uint32_t>(meshletBindings.size());
+        meshletDescSetLayoutInfo.pBindings = meshletBindings.data();
+
+        result = vkCreateDescriptorSetLayout(device, &meshletDescSetLayoutInfo, nullptr, &m_meshletSetLayout);
+        if (result != VK_SUCCESS)
+        {
+            std::cout << "Failed to create meshlet descriptor set layout!" << std::endl;
+            std::terminate();
+        }
+    }
+
+    // First draw of the culling phase for the task shader
+    VkPushConstantRange taskPushConstantRange{};
+    taskPushConstantRange.stageFlags = VK_SHADER_STAGE_TASK_BIT_EXT;
+    taskPushConstantRange.offset = 0;
+    taskPushConstantRange.size = sizeof(uint32_t);
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    std::array<VkDescriptorSetLayout, 2> descSetLayouts{ m_modelSetLayout, m_cameraSetLayout };
-    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descSetLayouts.size());
+    std::array<VkDescriptorSetLayout, 4> descSetLayouts{ m_modelSetLayout, m_cameraSetLayout, m_bindlessSetLayout, m_meshletSetLayout };
+    pipelineLayoutInfo.setLayoutCount = m_meshShading ? 4 : 3;
     pipelineLayoutInfo.pSetLayouts = descSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = m_meshShading ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = &taskPushConstantRange;
 
     result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
     if (result != VK_SUCCESS)
@@ -277,10 +319,10 @@ GBufferPass::GBufferPass(VkDevice device, RenderThreadPool* threadPool, std::vec
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = m_meshShading ? nullptr : &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = m_meshShading ? nullptr : &inputAssembly;
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
@@ -301,17 +343,36 @@ GBufferPass::GBufferPass(VkDevice device, RenderThreadPool* threadPool, std::vec
     }
 
     vkDestroyShaderModule(device, fragmentShader, nullptr);
-    vkDestroyShaderModule(device, vertexShader, nullptr);
+    vkDestroyShaderModule(device, geometryShader, nullptr);
+    if (taskShader != VK_NULL_HANDLE)
+    {
+        vkDestroyShaderModule(device, taskShader, nullptr);
+    }
 }
 
 GBufferPass::~GBufferPass()
 {
-
+    vkDestroyRenderPass(m_vkDevice, m_loadRenderPass, nullptr);
 }
 
 void GBufferPass::renderImpl(Scene* scene, VkCommandBuffer commandBuffer, uint32_t bufferIdx, float dt)
 {
+    // Scenes that cull on the CPU skip the depth pyramid and the late draws
+    DepthPyramid* depthPyramid = scene->isSoftwareOcclusionCulling() ? nullptr : m_depthPyramid;
+    Scene::DrawInfo drawInfo{ Camera::Type::NORMAL, false, 0, m_meshShading, depthPyramid };
+    scene->cull(commandBuffer, drawInfo, Scene::CullPhase::EARLY, bufferIdx);
+
     begin(commandBuffer);
-    scene->render(commandBuffer, m_pipelineLayout, Camera::Type::NORMAL, bufferIdx, dt);
+    scene->render(commandBuffer, m_pipelineLayout, drawInfo, Scene::CullPhase::EARLY, bufferIdx, dt);
+    end(commandBuffer);
+
+    if (!depthPyramid)
+        return;
+
+    // Objects hidden behind an earlier frame's depth are tested again against the depth drawn so far and added on top
+    scene->cull(commandBuffer, drawInfo, Scene::CullPhase::LATE, bufferIdx);
+
+    begin(commandBuffer, 0, m_loadRenderPass);
+    scene->render(commandBuffer, m_pipelineLayout, drawInfo, Scene::CullPhase::LATE, bufferIdx, dt);
     end(commandBuffer);
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "GeometryArena.h"
+
+#include <iostream>
+#include <cstring>
+
+GeometryArena::GeometryArena(VkDevice device, MemoryAllocator* allocator, uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t meshletCapacity) :
+    m_device(device)
+    , m_allocator(allocator)
+{
+    // Meshlets have at most MeshletBuilder::MAX_VERTICES vertices and MeshletBuilder::MAX_TRIANGLES triangles
+    m_capacities = {
+        vertexCapacity, vertexCapacity, indexCapacity,
+        meshletCapacity, meshletCapacity * MeshletBuilder::MAX_VERTICES, meshletCapacity * MeshletBuilder::MAX_TRIANGLES
+    };
+    // Vertex streams are also read by the mesh shaders
+    std::array<VkBufferUsageFlags, Stream::COUNT> usages{
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+    };
+    // Written in place when the device local memory is host visible, otherwise through staging buffers
+    for (uint32_t stream = 0; stream < Stream::COUNT; ++stream)
+    {
+        m_buffers[stream] = std::make_unique<Buffer>(device, allocator, usages[stream] | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            ELEMENT_SIZES[stream] * m_capacities[stream], MemoryAllocator::DIRECT_WRITE_PROPERTIES, MemoryAllocator::Category::MESH);
+    }
+}
+
+uint32_t GeometryArena::allocate(VkCommandBuffer copyCommandBuffer, Stream stream, void const* data, uint32_t count)
+{
+    uint32_t first = m_sizes[stream];
+    if (count > m_capacities[stream] - first)
+    {
+        std::cout << "Geometry arena is out of space" << std::endl;
+        std::terminate();
+    }
+    m_sizes[stream] += count;
+    if (count == 0)
+        return first;
+
+    VkDeviceSize size = ELEMENT_SIZES[stream] * count;
+    if (m_buffers[stream]->m_hostData)
+    {
+        m_buffers[stream]->update(data, static_cast<size_t>(size), static_cast<size_t>(ELEMENT_SIZES[stream] * first));
+        return first;
+    }
+
+    auto& stagingBuffer = m_stagingBuffers.emplace_back(std::make_unique<Buffer>(m_device, m_allocator, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size,
+        MemoryAllocator::Category::STAGING));
+    stagingBuffer->update(data, static_cast<size_t>(size));
+
+    VkBufferCopy region{};
+    region.dstOffset = ELEMENT_SIZES[stream] * first;
+    region.size = size;
+    vkCmdCopyBuffer(copyCommandBuffer, stagingBuffer->m_vkBuffer, m_buffers[stream]->m_vkBuffer, 1, &region);
+    return first;
+}
+
+uint32_t GeometryArena::addVertices(VkCommandBuffer copyCommandBuffer, std::vector<GBufferPass::PackedPosition> const& positions, std::vector<GBufferPass::PackedAttributes> const& attributes)
+{
+    uint32_t baseVertex = allocate(copyCommandBuffer, Stream::POSITIONS, positions.data(), static_cast<uint32_t>(positions.size()));
+    allocate(copyCommandBuffer, Stream::ATTRIBUTES, attributes.data(), static_cast<uint32_t>(attributes.size()));
+    return baseVertex;
+}
+
+uint32_t GeometryArena::addIndices(VkCommandBuffer copyCommandBuffer, std::vector<uint16_t> const& indices)
+{
+    return allocate(copyCommandBuffer, Stream::INDICES, indices.data(), static_cast<uint32_t>(indices.size()));
+}
+
+uint32_t GeometryArena::addMeshlets(VkCommandBuffer copyCommandBuffer, std::vector<Meshlet> meshlets, std::vector<uint32_t> const& vertices, std::vector<uint32_t> const& triangles)
+{
+    uint32_t firstVertex = allocate(copyCommandBuffer, Stream::MESHLET_VERTICES, vertices.data(), static_cast<uint32_t>(vertices.size()));
+    uint32_t firstTriangle = allocate(copyCommandBuffer, Stream::MESHLET_TRIANGLES, triangles.data(), static_cast<uint32_t>(triangles.size()));
+    for (auto& meshlet : meshlets)
+    {
+        meshlet.vertexOffset += firstVertex;
+        meshlet.triangleOffset += firstTriangle;
+    }
+    return allocate(copyCommandBuffer, Stream::MESHLETS, meshlets.data(), static_cast<uint32_t>(meshlets.size()));
+}
+
+void GeometryArena::releaseStagingBuffers()
+{
+    m_stagingBuffers.clear();
+}
+
+void GeometryArena::bindVertexBuffers(VkCommandBuffer commandBuffer, bool positionsOnly) const
+{
+    VkBuffer vertexBuffers[] = { m_buffers[Stream::POSITIONS]->m_vkBuffer, m_buffers[Stream::ATTRIBUTES]->m_vkBuffer };
+    VkDeviceSize offsets[] = { 0, 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, positionsOnly ? 1 : 2, vertexBuffers, offsets);
+}
+
+void GeometryArena::bindIndexBuffer(VkCommandBuffer commandBuffer) const
+{
+    vkCmdBindIndexBuffer(commandBuffer, m_buffers[Stream::INDICES]->m_vkBuffer, 0, VK_INDEX_TYPE_UINT16);
+}
+
+VkDescriptorBufferInfo GeometryArena::getDescriptorInfo(Stream stream) const
+{
+    return { m_buffers[stream]->m_vkBuffer, 0, VK_WHOLE_SIZE };
+}
\ No newline at end of file
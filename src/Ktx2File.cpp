@@ -0,0 +1,251 @@
+#include "Ktx2File.h"
+
+#include "MipChain.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <array>
+
+static constexpr std::array<uint8_t, 12> IDENTIFIER{ 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+struct Ktx2Header
+{
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must be packed");
+
+struct Ktx2LevelIndex
+{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// Color models and channels of the Khronos data format descriptor
+static constexpr uint32_t KHR_DF_MODEL_BC1A = 128;
+static constexpr uint32_t KHR_DF_MODEL_BC3 = 130;
+static constexpr uint32_t KHR_DF_MODEL_BC5 = 132;
+static constexpr uint32_t KHR_DF_MODEL_BC7 = 134;
+static constexpr uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+static constexpr uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+static constexpr uint32_t KHR_DF_TRANSFER_SRGB = 2;
+static constexpr uint32_t KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10;
+static constexpr uint32_t KHR_DF_CHANNEL_BC3_ALPHA = 15;
+
+static bool isSrgb(VkFormat format)
+{
+    return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK ||
+        format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+// Basic data format descriptor of the block compressed formats, which KTX2 requires of every file
+static std::vector<uint32_t> getDataFormatDescriptor(VkFormat format)
+{
+    struct Sample
+    {
+        uint32_t bitOffset;
+        uint32_t bitLength;
+        uint32_t channel;
+    };
+    uint32_t model{ 0 };
+    std::vector<Sample> samples;
+    switch (format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        model = KHR_DF_MODEL_BC1A;
+        samples = { { 0, 64, 0 } };
+        break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        model = KHR_DF_MODEL_BC3;
+        samples = { { 0, 64, KHR_DF_CHANNEL_BC3_ALPHA | (isSrgb(format) ? KHR_DF_SAMPLE_DATATYPE_LINEAR : 0) }, { 64, 64, 0 } };
+        break;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        model = KHR_DF_MODEL_BC5;
+        samples = { { 0, 64, 0 }, { 64, 64, 1 } };
+        break;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        model = KHR_DF_MODEL_BC7;
+        samples = { { 0, 128, 0 } };
+        break;
+    default:
+        std::cout << "Failed to describe texture format " << format << std::endl;
+        std::terminate();
+    }
+
+    uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+    std::vector<uint32_t> words;
+    words.emplace_back(4 + blockSize);
+    // Khronos vendor, basic descriptor type, version 1.3
+    words.emplace_back(0);
+    words.emplace_back(2 | (blockSize << 16));
+    words.emplace_back(model | (KHR_DF_PRIMARIES_BT709 << 8) | ((isSrgb(format) ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+    // 4x4 texel blocks, stored one less
+    words.emplace_back(3 | (3 << 8));
+    words.emplace_back(Ktx2File::getBlockSize(format));
+    words.emplace_back(0);
+    for (auto& sample : samples)
+    {
+        words.emplace_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+        words.emplace_back(0);
+        words.emplace_back(0);
+        words.emplace_back(0xFFFFFFFF);
+    }
+    return words;
+}
+
+bool Ktx2File::load(std::string const& filename, Ktx2File& file)
+{
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in)
+        return false;
+    uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+
+    Ktx2Header header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || !std::equal(IDENTIFIER.begin(), IDENTIFIER.end(), header.identifier))
+    {
+        std::cout << "Failed to load texture " << filename << ", it is not a KTX2 file" << std::endl;
+        std::terminate();
+    }
+    file.format = static_cast<VkFormat>(header.vkFormat);
+    if (getBlockSize(file.format) == 0 || header.pixelDepth != 0 || header.layerCount > 1 || header.faceCount != 1 || header.levelCount == 0 ||
+        header.supercompressionScheme != 0)
+    {
+        std::cout << "Failed to load texture " << filename << ", only single 2D images of the cooked formats are supported" << std::endl;
+        std::terminate();
+    }
+    file.width = header.pixelWidth;
+    file.height = header.pixelHeight;
+    // Everything is checked against the file before it is allocated, a broken header must not ask for gigabytes
+    if (file.width == 0 || file.height == 0 || header.levelCount > MipChain::getLevelCount(file.width, file.height) ||
+        sizeof(Ktx2Header) + header.levelCount * sizeof(Ktx2LevelIndex) > fileSize)
+    {
+        std::cout << "Failed to load texture " << filename << ", the size or the level count is out of range" << std::endl;
+        std::terminate();
+    }
+
+    std::vector<Ktx2LevelIndex> levelIndices(header.levelCount);
+    in.read(reinterpret_cast<char*>(levelIndices.data()), levelIndices.size() * sizeof(Ktx2LevelIndex));
+    file.levels.resize(header.levelCount);
+    for (uint32_t level = 0; level < header.levelCount; ++level)
+    {
+        auto& levelIndex = levelIndices[level];
+        if (levelIndex.byteLength != getLevelSize(file.format, file.width, file.height, level) || levelIndex.byteOffset > fileSize ||
+            levelIndex.byteLength > fileSize - levelIndex.byteOffset)
+        {
+            std::cout << "Failed to load texture " << filename << ", level " << level << " has the wrong size or lies past the end of the file" << std::endl;
+            std::terminate();
+        }
+        file.levels[level].resize(levelIndex.byteLength);
+        in.seekg(levelIndex.byteOffset);
+        in.read(reinterpret_cast<char*>(file.levels[level].data()), levelIndex.byteLength);
+    }
+    if (!in)
+    {
+        std::cout << "Failed to load texture " << filename << ", the file is truncated" << std::endl;
+        std::terminate();
+    }
+    return true;
+}
+
+void Ktx2File::save(std::string const& filename, Ktx2File const& file)
+{
+    std::vector<uint32_t> dataFormatDescriptor = getDataFormatDescriptor(file.format);
+    uint32_t levelCount = static_cast<uint32_t>(file.levels.size());
+
+    Ktx2Header header{};
+    std::copy(IDENTIFIER.begin(), IDENTIFIER.end(), header.identifier);
+    header.vkFormat = file.format;
+    header.typeSize = 1;
+    header.pixelWidth = file.width;
+    header.pixelHeight = file.height;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+    header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex));
+    header.dfdByteLength = static_cast<uint32_t>(dataFormatDescriptor.size() * sizeof(uint32_t));
+
+    // The smallest level comes first in the file, every level aligned to the block size
+    uint64_t alignment = std::max(getBlockSize(file.format), 4u);
+    uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+    std::vector<Ktx2LevelIndex> levelIndices(levelCount);
+    for (uint32_t level = levelCount; level-- > 0;)
+    {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        levelIndices[level] = { offset, file.levels[level].size(), file.levels[level].size() };
+        offset += file.levels[level].size();
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    out.write(reinterpret_cast<char const*>(levelIndices.data()), levelIndices.size() * sizeof(Ktx2LevelIndex));
+    out.write(reinterpret_cast<char const*>(dataFormatDescriptor.data()), header.dfdByteLength);
+    for (uint32_t level = levelCount; level-- > 0;)
+    {
+        static char const padding[16]{};
+        out.write(padding, levelIndices[level].byteOffset - static_cast<uint64_t>(out.tellp()));
+        out.write(reinterpret_cast<char const*>(file.levels[level].data()), file.levels[level].size());
+    }
+    if (!out)
+    {
+        std::cout << "Failed to write texture " << filename << std::endl;
+        std::terminate();
+    }
+}
+
+uint32_t Ktx2File::getBlockSize(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return 16;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+bool Ktx2File::isBlockCompressed(VkFormat format)
+{
+    return format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+size_t Ktx2File::getLevelSize(VkFormat format, uint32_t width, uint32_t height, uint32_t level)
+{
+    size_t levelWidth = std::max(width >> level, 1u);
+    size_t levelHeight = std::max(height >> level, 1u);
+    if (isBlockCompressed(format))
+    {
+        levelWidth = (levelWidth + 3) / 4;
+        levelHeight = (levelHeight + 3) / 4;
+    }
+    return levelWidth * levelHeight * getBlockSize(format);
+}
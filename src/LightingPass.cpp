@@ -7,8 +7,10 @@
 #include <array>
 #include <iostream>
 
-LightingPass::LightingPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadPool* threadPool, std::vector<Texture*>& colorTargets, std::vector<Texture*>& srcTextures) :
+LightingPass::LightingPass(VkDevice device, RenderThreadPool* threadPool, UniformArena* uniformArena, DescriptorAllocator* descriptorAllocator,
+    std::vector<Texture*>& colorTargets, std::vector<Texture*>& srcTextures) :
 	RenderPass::RenderPass(device, threadPool, 1)
+	, m_uniformArena(uniformArena)
 {
     m_hasDepthAttachment = false;
 
@@ -157,7 +159,7 @@ LightingPass::LightingPass(VkPhysicalDevice physicalDevice, VkDevice device, Ren
 
     VkDescriptorSetLayoutBinding uniformBufferLayoutBinding{};
     uniformBufferLayoutBinding.binding = 0;
-    uniformBufferLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uniformBufferLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uniformBufferLayoutBinding.descriptorCount = 1;
     uniformBufferLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
@@ -204,9 +206,9 @@ LightingPass::LightingPass(VkPhysicalDevice physicalDevice, VkDevice device, Ren
 
     VkDescriptorSetLayoutBinding cameraTransformLayoutBinding{};
     cameraTransformLayoutBinding.binding = 0;
-    cameraTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    cameraTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     cameraTransformLayoutBinding.descriptorCount = 1;
-    cameraTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    cameraTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_ALL;
 
     VkDescriptorSetLayoutCreateInfo cameraDescSetLayoutInfo{};
     cameraDescSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -261,129 +263,35 @@ LightingPass::LightingPass(VkPhysicalDevice physicalDevice, VkDevice device, Ren
     vkDestroyShaderModule(device, fragmentShader, nullptr);
     vkDestroyShaderModule(device, vertexShader, nullptr);
 
-    VkDescriptorPoolSize uniformBufferPoolSize{};
-    uniformBufferPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uniformBufferPoolSize.descriptorCount = static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-
-    VkDescriptorPoolSize texturePoolSize{};
-    texturePoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    texturePoolSize.descriptorCount = 4 * static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-
-    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
-    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    std::array<VkDescriptorPoolSize, 2> poolSizes{ uniformBufferPoolSize, texturePoolSize };
-    descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-    descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
-    descriptorPoolCreateInfo.maxSets = static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-
-    result = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool);
-    if (result != VK_SUCCESS)
-    {
-        std::cout << "Failed to create descriptor pool" << std::endl;
-        std::terminate();
-    }
-
-    std::vector<VkDescriptorSetLayout> layouts(Renderer::BUFFER_COUNT, m_modelSetLayout);
-    VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-    descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptorSetAllocInfo.descriptorPool = m_descriptorPool;
-    descriptorSetAllocInfo.descriptorSetCount = static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-    descriptorSetAllocInfo.pSetLayouts = layouts.data();
-
-    m_descriptorSets.resize(Renderer::BUFFER_COUNT);
-    result = vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, m_descriptorSets.data());
-    if (result != VK_SUCCESS) {
-        std::cout << "Failed to allocate descriptor sets" << std::endl;
-        std::terminate();
-    }
-    for (uint32_t i = 0; i < Renderer::BUFFER_COUNT; ++i)
-    {
-        m_uniformBuffers.emplace_back(std::make_unique<Buffer>(physicalDevice, device, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(LightingPass::Transforms)));
-
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = m_uniformBuffers[i]->m_vkBuffer;
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(LightingPass::Transforms);
-
-        VkDescriptorImageInfo albedoInfo{};
-        albedoInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        albedoInfo.imageView = srcTextures[0]->m_imageView;
-        albedoInfo.sampler = srcTextures[0]->m_sampler;
-
-        VkDescriptorImageInfo normalInfo{};
-        normalInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        normalInfo.imageView = srcTextures[1]->m_imageView;
-        normalInfo.sampler = srcTextures[1]->m_sampler;
-
-        VkDescriptorImageInfo depthInfo{};
-        depthInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-        depthInfo.imageView = srcTextures[2]->m_imageView;
-        depthInfo.sampler = srcTextures[2]->m_sampler;
-
-        VkDescriptorImageInfo shadowInfo{};
-        shadowInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-        shadowInfo.imageView = srcTextures[3]->m_imageView;
-        shadowInfo.sampler = srcTextures[3]->m_sampler;
-
-        VkWriteDescriptorSet uniformBufferDescriptorWrite{};
-        uniformBufferDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        uniformBufferDescriptorWrite.dstSet = m_descriptorSets[i];
-        uniformBufferDescriptorWrite.dstBinding = 0;
-        uniformBufferDescriptorWrite.dstArrayElement = 0;
-        uniformBufferDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        uniformBufferDescriptorWrite.descriptorCount = 1;
-        uniformBufferDescriptorWrite.pBufferInfo = &bufferInfo;
-
-        VkWriteDescriptorSet albedoDescriptorWrite{};
-        albedoDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        albedoDescriptorWrite.dstSet = m_descriptorSets[i];
-        albedoDescriptorWrite.dstBinding = 1;
-        albedoDescriptorWrite.dstArrayElement = 0;
-        albedoDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        albedoDescriptorWrite.descriptorCount = 1;
-        albedoDescriptorWrite.pImageInfo = &albedoInfo;
-
-        VkWriteDescriptorSet normalDescriptorWrite{};
-        normalDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        normalDescriptorWrite.dstSet = m_descriptorSets[i];
-        normalDescriptorWrite.dstBinding = 2;
-        normalDescriptorWrite.dstArrayElement = 0;
-        normalDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        normalDescriptorWrite.descriptorCount = 1;
-        normalDescriptorWrite.pImageInfo = &normalInfo;
-
-        VkWriteDescriptorSet depthDescriptorWrite{};
-        depthDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        depthDescriptorWrite.dstSet = m_descriptorSets[i];
-        depthDescriptorWrite.dstBinding = 3;
-        depthDescriptorWrite.dstArrayElement = 0;
-        depthDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        depthDescriptorWrite.descriptorCount = 1;
-        depthDescriptorWrite.pImageInfo = &depthInfo;
-
-        VkWriteDescriptorSet shadowDescriptorWrite{};
-        shadowDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        shadowDescriptorWrite.dstSet = m_descriptorSets[i];
-        shadowDescriptorWrite.dstBinding = 4;
-        shadowDescriptorWrite.dstArrayElement = 0;
-        shadowDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        shadowDescriptorWrite.descriptorCount = 1;
-        shadowDescriptorWrite.pImageInfo = &shadowInfo;
-
-        std::array<VkWriteDescriptorSet, 5> descriptorWrites{ 
-            uniformBufferDescriptorWrite,
-            albedoDescriptorWrite,
-            normalDescriptorWrite,
-            depthDescriptorWrite,
-            shadowDescriptorWrite
-        };
-        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-    }
-}
-
-LightingPass::~LightingPass()
-{
-    vkDestroyDescriptorPool(m_vkDevice, m_descriptorPool, nullptr);
+    VkDescriptorBufferInfo bufferInfo = m_uniformArena->getDescriptorInfo(sizeof(LightingPass::Transforms));
+
+    VkDescriptorImageInfo albedoInfo{};
+    albedoInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    albedoInfo.imageView = srcTextures[0]->m_imageView;
+    albedoInfo.sampler = srcTextures[0]->m_sampler;
+
+    VkDescriptorImageInfo normalInfo{};
+    normalInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    normalInfo.imageView = srcTextures[1]->m_imageView;
+    normalInfo.sampler = srcTextures[1]->m_sampler;
+
+    VkDescriptorImageInfo depthInfo{};
+    depthInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    depthInfo.imageView = srcTextures[2]->m_imageView;
+    depthInfo.sampler = srcTextures[2]->m_sampler;
+
+    VkDescriptorImageInfo shadowInfo{};
+    shadowInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    shadowInfo.imageView = srcTextures[3]->m_imageView;
+    shadowInfo.sampler = srcTextures[3]->m_sampler;
+
+    // The transforms of every frame are in the uniform arena, one set serves all frames in flight
+    m_descriptorSet = descriptorAllocator->getSet(m_modelSetLayout, {
+        DescriptorAllocator::Binding::buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, bufferInfo),
+        DescriptorAllocator::Binding::image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, albedoInfo),
+        DescriptorAllocator::Binding::image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, normalInfo),
+        DescriptorAllocator::Binding::image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depthInfo),
+        DescriptorAllocator::Binding::image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, shadowInfo) });
 }
 
 void LightingPass::renderImpl(Scene* scene, VkCommandBuffer commandBuffer, uint32_t bufferIdx, float dt)
@@ -397,9 +305,9 @@ void LightingPass::renderImpl(Scene* scene, VkCommandBuffer commandBuffer, uint3
     transforms.viewInverse = glm::inverse(scene->m_cameras[Camera::Type::NORMAL]->m_view);
     transforms.lightDir = scene->m_cameras[Camera::Type::LIGHT]->m_direction;
     
-    m_uniformBuffers[bufferIdx]->update(&transforms, sizeof(LightingPass::Transforms));
+    uint32_t uniformOffset = m_uniformArena->push(bufferIdx, transforms);
 
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[bufferIdx], 0, nullptr);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSet, 1, &uniformOffset);
     vkCmdDraw(commandBuffer, 4, 1, 0, 0);
 
     end(commandBuffer);
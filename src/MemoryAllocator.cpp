@@ -0,0 +1,356 @@
+#include "MemoryAllocator.h"
+
+#include <iostream>
+#include <algorithm>
+
+MemoryAllocator::MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device) :
+    m_physicalDevice(physicalDevice)
+    , m_device(device)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+    VkDeviceSize deviceLocalHeapSize = 0;
+    for (uint32_t heapIdx = 0; heapIdx < m_memoryProperties.memoryHeapCount; ++heapIdx)
+    {
+        VkMemoryHeap const& heap = m_memoryProperties.memoryHeaps[heapIdx];
+        if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.size > deviceLocalHeapSize)
+        {
+            m_deviceLocalHeapIdx = heapIdx;
+            deviceLocalHeapSize = heap.size;
+        }
+    }
+    for (uint32_t memoryTypeIdx = 0; memoryTypeIdx < m_memoryProperties.memoryTypeCount; ++memoryTypeIdx)
+    {
+        // Small heaps, such as the host visible part of device local memory, are not taken by a few blocks
+        VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[memoryTypeIdx].heapIndex].size;
+        VkDeviceSize blockSize = BLOCK_SIZE;
+        while (blockSize > MIN_ALLOCATION_SIZE && blockSize > heapSize / 8)
+        {
+            blockSize /= 2;
+        }
+        uint32_t maxOrder = 0;
+        while ((MIN_ALLOCATION_SIZE << maxOrder) < blockSize)
+        {
+            ++maxOrder;
+        }
+        for (uint32_t pool = 0; pool < Pool::COUNT; ++pool)
+        {
+            m_pools[memoryTypeIdx * Pool::COUNT + pool].blockSize = blockSize;
+            m_pools[memoryTypeIdx * Pool::COUNT + pool].maxOrder = maxOrder;
+        }
+    }
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+    if (m_allocationCount > 0)
+    {
+        std::cout << "Memory leaked, " << m_allocationCount << " allocations are still alive:" << std::endl;
+        for (uint32_t category = 0; category < Category::CATEGORY_COUNT; ++category)
+        {
+            if (m_categories[category].allocationCount > 0)
+            {
+                std::cout << "    " << getCategoryName(static_cast<Category>(category)) << ": " << m_categories[category].allocationCount
+                    << " allocations, " << m_categories[category].usedBytes << " bytes" << std::endl;
+            }
+        }
+    }
+    for (auto& pool : m_pools)
+    {
+        for (auto& block : pool.blocks)
+        {
+            vkFreeMemory(m_device, block->memory, nullptr);
+        }
+    }
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties) const
+{
+    // Device local memory comes from the main heap when it can, rather than from the small BAR heap
+    if (properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+    {
+        for (uint32_t memoryTypeIdx = 0; memoryTypeIdx < m_memoryProperties.memoryTypeCount; ++memoryTypeIdx)
+        {
+            VkMemoryType const& memoryType = m_memoryProperties.memoryTypes[memoryTypeIdx];
+            if ((memoryTypeBits & (1 << memoryTypeIdx)) && (memoryType.propertyFlags & properties) == properties && memoryType.heapIndex == m_deviceLocalHeapIdx)
+            {
+                return memoryTypeIdx;
+            }
+        }
+    }
+    for (uint32_t memoryTypeIdx = 0; memoryTypeIdx < m_memoryProperties.memoryTypeCount; ++memoryTypeIdx)
+    {
+        if ((memoryTypeBits & (1 << memoryTypeIdx)) && (m_memoryProperties.memoryTypes[memoryTypeIdx].propertyFlags & properties) == properties)
+        {
+            return memoryTypeIdx;
+        }
+    }
+    std::cout << "Failed to find a memory type" << std::endl;
+    std::terminate();
+}
+
+bool MemoryAllocator::isDirectWriteAvailable(uint32_t memoryTypeBits) const
+{
+    for (uint32_t memoryTypeIdx = 0; memoryTypeIdx < m_memoryProperties.memoryTypeCount; ++memoryTypeIdx)
+    {
+        VkMemoryType const& memoryType = m_memoryProperties.memoryTypes[memoryTypeIdx];
+        if ((memoryTypeBits & (1 << memoryTypeIdx)) && (memoryType.propertyFlags & DIRECT_WRITE_PROPERTIES) == DIRECT_WRITE_PROPERTIES &&
+            memoryType.heapIndex == m_deviceLocalHeapIdx)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(uint32_t memoryTypeIdx, VkDeviceSize size, void** mappedData)
+{
+    VkMemoryAllocateInfo memAllocInfo{};
+    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memAllocInfo.allocationSize = size;
+    memAllocInfo.memoryTypeIndex = memoryTypeIdx;
+    VkDeviceMemory memory{ VK_NULL_HANDLE };
+    VkResult result = vkAllocateMemory(m_device, &memAllocInfo, nullptr, &memory);
+    if (result != VK_SUCCESS)
+    {
+        std::cout << "Failed to allocate device memory" << std::endl;
+        std::terminate();
+    }
+    *mappedData = nullptr;
+    if (m_memoryProperties.memoryTypes[memoryTypeIdx].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        vkMapMemory(m_device, memory, 0, size, 0, mappedData);
+    }
+    ++m_deviceAllocationCount;
+    m_allocatedBytes += size;
+    m_heapAllocatedBytes[m_memoryProperties.memoryTypes[memoryTypeIdx].heapIndex] += size;
+    return memory;
+}
+
+void MemoryAllocator::freeDeviceMemory(uint32_t memoryTypeIdx, VkDeviceMemory memory, VkDeviceSize size)
+{
+    vkFreeMemory(m_device, memory, nullptr);
+    --m_deviceAllocationCount;
+    m_allocatedBytes -= size;
+    m_heapAllocatedBytes[m_memoryProperties.memoryTypes[memoryTypeIdx].heapIndex] -= size;
+}
+
+bool MemoryAllocator::allocateRange(Block& block, uint32_t order, VkDeviceSize& offset) const
+{
+    uint32_t freeOrder = order;
+    while (freeOrder < block.freeOffsets.size() && block.freeOffsets[freeOrder].empty())
+    {
+        ++freeOrder;
+    }
+    if (freeOrder == block.freeOffsets.size())
+        return false;
+
+    auto& freeOffsets = block.freeOffsets[freeOrder];
+    offset = *freeOffsets.begin();
+    freeOffsets.erase(freeOffsets.begin());
+    // The upper halves of the split ranges stay free
+    while (freeOrder > order)
+    {
+        --freeOrder;
+        block.freeOffsets[freeOrder].insert(offset + (MIN_ALLOCATION_SIZE << freeOrder));
+    }
+    return true;
+}
+
+MemoryAllocator::Allocation MemoryAllocator::allocate(VkMemoryRequirements const& requirements, VkMemoryPropertyFlags properties, Pool pool, Category category)
+{
+    std::unique_lock lock(m_mutex);
+    uint32_t memoryTypeIdx = findMemoryType(requirements.memoryTypeBits, properties);
+    uint32_t poolIdx = memoryTypeIdx * Pool::COUNT + pool;
+    BlockPool& blockPool = m_pools[poolIdx];
+
+    // Ranges are aligned to their size, the alignment is a power of two
+    VkDeviceSize size = std::max(requirements.size, requirements.alignment);
+    uint32_t order = 0;
+    while ((MIN_ALLOCATION_SIZE << order) < size)
+    {
+        ++order;
+    }
+
+    Allocation allocation;
+    allocation.poolIdx = poolIdx;
+    allocation.category = category;
+    ++m_allocationCount;
+    ++m_categories[category].allocationCount;
+    // Resources that would take a whole block get memory of their own
+    if (order >= blockPool.maxOrder)
+    {
+        allocation.size = requirements.size;
+        allocation.memory = allocateDeviceMemory(memoryTypeIdx, requirements.size, &allocation.mappedData);
+        m_usedBytes += allocation.size;
+        m_categories[category].usedBytes += allocation.size;
+        return allocation;
+    }
+
+    allocation.order = order;
+    allocation.size = MIN_ALLOCATION_SIZE << order;
+    m_categories[category].usedBytes += allocation.size;
+    auto blockIt = std::find_if(blockPool.blocks.begin(), blockPool.blocks.end(), [this, order, &allocation](std::unique_ptr<Block> const& block)
+    {
+        return allocateRange(*block, order, allocation.offset);
+    });
+    if (blockIt == blockPool.blocks.end())
+    {
+        auto block = std::make_unique<Block>();
+        block->memory = allocateDeviceMemory(memoryTypeIdx, blockPool.blockSize, &block->mappedData);
+        block->freeOffsets.resize(blockPool.maxOrder + 1);
+        block->freeOffsets[blockPool.maxOrder].insert(0);
+        allocateRange(*block, order, allocation.offset);
+        blockIt = blockPool.blocks.insert(blockPool.blocks.end(), std::move(block));
+    }
+
+    Block& block = **blockIt;
+    block.usedBytes += allocation.size;
+    m_usedBytes += allocation.size;
+    allocation.block = &block;
+    allocation.memory = block.memory;
+    allocation.mappedData = block.mappedData ? static_cast<char*>(block.mappedData) + allocation.offset : nullptr;
+    return allocation;
+}
+
+void MemoryAllocator::free(Allocation const& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+        return;
+
+    std::unique_lock lock(m_mutex);
+    --m_allocationCount;
+    m_usedBytes -= allocation.size;
+    --m_categories[allocation.category].allocationCount;
+    m_categories[allocation.category].usedBytes -= allocation.size;
+    uint32_t memoryTypeIdx = allocation.poolIdx / Pool::COUNT;
+    if (!allocation.block)
+    {
+        freeDeviceMemory(memoryTypeIdx, allocation.memory, allocation.size);
+        return;
+    }
+
+    // Merges the range with its buddy for as long as the buddy is free too
+    Block& block = *allocation.block;
+    block.usedBytes -= allocation.size;
+    VkDeviceSize offset = allocation.offset;
+    uint32_t order = allocation.order;
+    while (order + 1 < block.freeOffsets.size())
+    {
+        VkDeviceSize buddyOffset = offset ^ (MIN_ALLOCATION_SIZE << order);
+        if (block.freeOffsets[order].erase(buddyOffset) == 0)
+            break;
+
+        offset = std::min(offset, buddyOffset);
+        ++order;
+    }
+    block.freeOffsets[order].insert(offset);
+
+    // One empty block is kept per pool, so that a resource freed and created again every frame does not allocate
+    BlockPool& blockPool = m_pools[allocation.poolIdx];
+    if (block.usedBytes == 0 && blockPool.blocks.size() > 1)
+    {
+        freeDeviceMemory(memoryTypeIdx, block.memory, blockPool.blockSize);
+        blockPool.blocks.erase(std::find_if(blockPool.blocks.begin(), blockPool.blocks.end(), [&block](std::unique_ptr<Block> const& poolBlock)
+        {
+            return poolBlock.get() == &block;
+        }));
+    }
+}
+
+MemoryAllocator::Stats MemoryAllocator::getStats() const
+{
+    std::unique_lock lock(m_mutex);
+    Stats stats{ m_deviceAllocationCount, 0, m_allocationCount, m_allocatedBytes, m_usedBytes };
+    for (auto const& pool : m_pools)
+    {
+        stats.blockCount += static_cast<uint32_t>(pool.blocks.size());
+    }
+    return stats;
+}
+
+void MemoryAllocator::useMemoryBudget()
+{
+    m_memoryBudget = true;
+}
+
+MemoryAllocator::Report MemoryAllocator::getReport() const
+{
+    Report report{};
+    report.stats = getStats();
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    if (m_memoryBudget)
+    {
+        // The budgets change with the other processes on the device, so they are queried every time
+        VkPhysicalDeviceMemoryProperties2 memoryProperties{};
+        memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memoryProperties.pNext = &budgetProperties;
+        vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memoryProperties);
+    }
+
+    std::unique_lock lock(m_mutex);
+    for (uint32_t heapIdx = 0; heapIdx < m_memoryProperties.memoryHeapCount; ++heapIdx)
+    {
+        VkMemoryHeap const& heap = m_memoryProperties.memoryHeaps[heapIdx];
+        HeapReport heapReport{ heap.flags, heap.size, heap.size, m_heapAllocatedBytes[heapIdx], m_heapAllocatedBytes[heapIdx] };
+        if (m_memoryBudget)
+        {
+            heapReport.budget = budgetProperties.heapBudget[heapIdx];
+            heapReport.usage = budgetProperties.heapUsage[heapIdx];
+        }
+        report.heaps.emplace_back(heapReport);
+    }
+    report.categories = m_categories;
+    return report;
+}
+
+void MemoryAllocator::writeReport(std::ostream& out) const
+{
+    Report report = getReport();
+    out << "{" << std::endl;
+    out << "  \"memoryBudget\": " << (m_memoryBudget ? "true" : "false") << "," << std::endl;
+    out << "  \"deviceAllocationCount\": " << report.stats.deviceAllocationCount << "," << std::endl;
+    out << "  \"blockCount\": " << report.stats.blockCount << "," << std::endl;
+    out << "  \"allocationCount\": " << report.stats.allocationCount << "," << std::endl;
+    out << "  \"allocatedBytes\": " << report.stats.allocatedBytes << "," << std::endl;
+    out << "  \"usedBytes\": " << report.stats.usedBytes << "," << std::endl;
+    out << "  \"heaps\": [" << std::endl;
+    for (size_t heapIdx = 0; heapIdx < report.heaps.size(); ++heapIdx)
+    {
+        HeapReport const& heap = report.heaps[heapIdx];
+        out << "    { \"deviceLocal\": " << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false")
+            << ", \"size\": " << heap.size << ", \"budget\": " << heap.budget << ", \"usage\": " << heap.usage
+            << ", \"allocatedBytes\": " << heap.allocatedBytes << " }" << (heapIdx + 1 < report.heaps.size() ? "," : "") << std::endl;
+    }
+    out << "  ]," << std::endl;
+    out << "  \"categories\": {" << std::endl;
+    for (uint32_t category = 0; category < Category::CATEGORY_COUNT; ++category)
+    {
+        out << "    \"" << getCategoryName(static_cast<Category>(category)) << "\": { \"allocationCount\": " << report.categories[category].allocationCount
+            << ", \"usedBytes\": " << report.categories[category].usedBytes << " }" << (category + 1 < Category::CATEGORY_COUNT ? "," : "") << std::endl;
+    }
+    out << "  }" << std::endl;
+    out << "}" << std::endl;
+}
+
+char const* MemoryAllocator::getCategoryName(Category category)
+{
+    switch (category)
+    {
+    case Category::RENDER_TARGET:
+        return "renderTarget";
+    case Category::MESH:
+        return "mesh";
+    case Category::TEXTURE:
+        return "texture";
+    case Category::STAGING:
+        return "staging";
+    case Category::UNIFORM:
+        return "uniform";
+    case Category::DRAW:
+        return "draw";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,192 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+
+MeshSimplifier::MeshSimplifier(std::vector<glm::vec3> const& positions, std::vector<uint16_t> const& indices) :
+    m_positions(positions)
+    , m_indices(indices)
+    , m_quadrics(positions.size(), Quadric{})
+    , m_locked(positions.size(), false)
+{
+    // Area weighted plane quadrics of the adjacent triangles
+    for (size_t i = 0; i + 2 < m_indices.size(); i += 3)
+    {
+        glm::dvec3 p0 = m_positions[m_indices[i]];
+        glm::dvec3 p1 = m_positions[m_indices[i + 1]];
+        glm::dvec3 p2 = m_positions[m_indices[i + 2]];
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double area = glm::length(normal);
+        if (area == 0.0)
+            continue;
+        normal /= area;
+        double d = -glm::dot(normal, p0);
+
+        Quadric q{
+            normal.x * normal.x * area, normal.x * normal.y * area, normal.x * normal.z * area, normal.x * d * area,
+            normal.y * normal.y * area, normal.y * normal.z * area, normal.y * d * area,
+            normal.z * normal.z * area, normal.z * d * area,
+            d * d * area,
+            area
+        };
+        for (int k = 0; k < 3; ++k)
+        {
+            addQuadric(m_quadrics[m_indices[i + k]], q);
+        }
+    }
+
+    // Edges used by a single triangle are open borders or attribute seams, their vertices must stay put
+    std::unordered_map<uint32_t, uint32_t> edgeUseCount;
+    for (size_t i = 0; i + 2 < m_indices.size(); i += 3)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            uint16_t a = m_indices[i + k];
+            uint16_t b = m_indices[i + (k + 1) % 3];
+            ++edgeUseCount[(static_cast<uint32_t>(std::min(a, b)) << 16) | std::max(a, b)];
+        }
+    }
+    for (auto const& [edge, count] : edgeUseCount)
+    {
+        if (count == 1)
+        {
+            m_locked[edge >> 16] = true;
+            m_locked[edge & 0xffff] = true;
+        }
+    }
+}
+
+void MeshSimplifier::addQuadric(Quadric& q, Quadric const& other)
+{
+    q.a2 += other.a2; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+    q.b2 += other.b2; q.bc += other.bc; q.bd += other.bd;
+    q.c2 += other.c2; q.cd += other.cd;
+    q.d2 += other.d2;
+    q.weight += other.weight;
+}
+
+double MeshSimplifier::evaluate(Quadric const& q, glm::vec3 const& p)
+{
+    double x = p.x, y = p.y, z = p.z;
+    double error = q.a2 * x * x + 2 * q.ab * x * y + 2 * q.ac * x * z + 2 * q.ad * x
+        + q.b2 * y * y + 2 * q.bc * y * z + 2 * q.bd * y
+        + q.c2 * z * z + 2 * q.cd * z
+        + q.d2;
+    // Normalized by the accumulated area, so the result is a mean squared distance
+    return q.weight > 0.0 ? std::max(error, 0.0) / q.weight : 0.0;
+}
+
+bool MeshSimplifier::flipsTriangle(uint16_t from, uint16_t to) const
+{
+    for (uint32_t triangle : m_vertexTriangles[from])
+    {
+        uint16_t const* tri = &m_indices[triangle * 3];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+            continue;
+
+        glm::vec3 before[3];
+        glm::vec3 after[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            before[k] = m_positions[tri[k]];
+            after[k] = tri[k] == from ? m_positions[to] : before[k];
+        }
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+            return true;
+    }
+    return false;
+}
+
+std::vector<uint16_t> MeshSimplifier::simplify(size_t targetIndexCount, float& error)
+{
+    while (m_indices.size() > targetIndexCount)
+    {
+        m_vertexTriangles.assign(m_positions.size(), {});
+        for (uint32_t i = 0; i < m_indices.size() / 3; ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                m_vertexTriangles[m_indices[i * 3 + k]].emplace_back(i);
+            }
+        }
+
+        std::vector<Collapse> collapses;
+        for (size_t i = 0; i < m_indices.size(); i += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                uint16_t a = m_indices[i + k];
+                uint16_t b = m_indices[i + (k + 1) % 3];
+                Quadric q = m_quadrics[a];
+                addQuadric(q, m_quadrics[b]);
+                if (!m_locked[a])
+                    collapses.push_back({ a, b, evaluate(q, m_positions[b]) });
+                if (!m_locked[b])
+                    collapses.push_back({ b, a, evaluate(q, m_positions[a]) });
+            }
+        }
+        if (collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(), [](Collapse const& l, Collapse const& r) { return l.cost < r.cost; });
+
+        // Greedy pass of independent collapses, the one-ring of a collapsed vertex is left alone until the next pass
+        size_t trianglesToRemove = (m_indices.size() - targetIndexCount) / 3;
+        size_t removedTriangles = 0;
+        std::vector<bool> touched(m_positions.size(), false);
+        std::vector<uint16_t> remap(m_positions.size());
+        for (size_t i = 0; i < remap.size(); ++i)
+        {
+            remap[i] = static_cast<uint16_t>(i);
+        }
+        for (Collapse const& collapse : collapses)
+        {
+            if (removedTriangles >= trianglesToRemove)
+                break;
+            bool ringTouched = false;
+            for (uint32_t triangle : m_vertexTriangles[collapse.from])
+            {
+                ringTouched |= touched[m_indices[triangle * 3]] || touched[m_indices[triangle * 3 + 1]] || touched[m_indices[triangle * 3 + 2]];
+            }
+            if (ringTouched || flipsTriangle(collapse.from, collapse.to))
+                continue;
+
+            for (uint32_t triangle : m_vertexTriangles[collapse.from])
+            {
+                touched[m_indices[triangle * 3]] = true;
+                touched[m_indices[triangle * 3 + 1]] = true;
+                touched[m_indices[triangle * 3 + 2]] = true;
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (m_indices[triangle * 3 + k] == collapse.to)
+                        ++removedTriangles;
+                }
+            }
+            remap[collapse.from] = collapse.to;
+            addQuadric(m_quadrics[collapse.to], m_quadrics[collapse.from]);
+            m_maxError = std::max(m_maxError, collapse.cost);
+        }
+
+        std::vector<uint16_t> indices;
+        indices.reserve(m_indices.size());
+        for (size_t i = 0; i < m_indices.size(); i += 3)
+        {
+            uint16_t a = remap[m_indices[i]];
+            uint16_t b = remap[m_indices[i + 1]];
+            uint16_t c = remap[m_indices[i + 2]];
+            if (a != b && b != c && c != a)
+            {
+                indices.insert(indices.end(), { a, b, c });
+            }
+        }
+        if (indices.size() == m_indices.size())
+            break;
+        m_indices = std::move(indices);
+    }
+
+    error = static_cast<float>(std::sqrt(m_maxError));
+    return m_indices;
+}
@@ -0,0 +1,149 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+MeshletBuilder::MeshletBuilder(std::vector<glm::vec3> const& positions) :
+    m_positions(positions)
+{
+}
+
+uint32_t MeshletBuilder::build(uint16_t const* indices, size_t indexCount)
+{
+    uint32_t firstMeshlet = static_cast<uint32_t>(m_meshlets.size());
+    size_t triangleCount = indexCount / 3;
+
+    std::vector<std::vector<uint32_t>> vertexTriangles(m_positions.size());
+    for (uint32_t i = 0; i < triangleCount; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            vertexTriangles[indices[i * 3 + k]].emplace_back(i);
+        }
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<int32_t> localIndices(m_positions.size(), -1);
+
+    Meshlet meshlet{};
+    meshlet.vertexOffset = static_cast<uint32_t>(m_vertices.size());
+    meshlet.triangleOffset = static_cast<uint32_t>(m_triangles.size());
+
+    auto finishMeshlet = [&]()
+    {
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            uint32_t vertex = m_vertices[meshlet.vertexOffset + i];
+            boundsMin = glm::min(boundsMin, m_positions[vertex]);
+            boundsMax = glm::max(boundsMax, m_positions[vertex]);
+            localIndices[vertex] = -1;
+        }
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            radius = std::max(radius, glm::length(m_positions[m_vertices[meshlet.vertexOffset + i]] - center));
+        }
+        meshlet.boundingSphere = glm::vec4(center, radius);
+
+        // The cone axis is the average face normal, its spread is bounded by the face deviating the most
+        std::vector<glm::vec3> normals;
+        glm::vec3 axis(0.0f);
+        for (uint32_t i = 0; i < meshlet.triangleCount; ++i)
+        {
+            uint32_t triangle = m_triangles[meshlet.triangleOffset + i];
+            glm::vec3 p0 = m_positions[m_vertices[meshlet.vertexOffset + (triangle & 0xff)]];
+            glm::vec3 p1 = m_positions[m_vertices[meshlet.vertexOffset + ((triangle >> 8) & 0xff)]];
+            glm::vec3 p2 = m_positions[m_vertices[meshlet.vertexOffset + ((triangle >> 16) & 0xff)]];
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+            if (area == 0.0f)
+                continue;
+            normals.emplace_back(normal / area);
+            axis += normals.back();
+        }
+        meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 2.0f);
+        float axisLength = glm::length(axis);
+        if (axisLength > 0.0f)
+        {
+            axis /= axisLength;
+            float minDot = 1.0f;
+            for (auto const& normal : normals)
+            {
+                minDot = std::min(minDot, glm::dot(axis, normal));
+            }
+            if (minDot > 0.0f)
+            {
+                meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+            }
+        }
+
+        m_meshlets.emplace_back(meshlet);
+        meshlet = Meshlet{};
+        meshlet.vertexOffset = static_cast<uint32_t>(m_vertices.size());
+        meshlet.triangleOffset = static_cast<uint32_t>(m_triangles.size());
+    };
+
+    size_t nextSeed = 0;
+    size_t remaining = triangleCount;
+    while (remaining > 0)
+    {
+        // Grow the meshlet with the triangle sharing the most vertices with it, or start over from the next free one
+        uint32_t best = std::numeric_limits<uint32_t>::max();
+        uint32_t bestShared = 0;
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            for (uint32_t triangle : vertexTriangles[m_vertices[meshlet.vertexOffset + i]])
+            {
+                if (emitted[triangle])
+                    continue;
+                uint32_t shared = (localIndices[indices[triangle * 3]] >= 0) + (localIndices[indices[triangle * 3 + 1]] >= 0) + (localIndices[indices[triangle * 3 + 2]] >= 0);
+                if (best == std::numeric_limits<uint32_t>::max() || shared > bestShared)
+                {
+                    best = triangle;
+                    bestShared = shared;
+                }
+            }
+        }
+        if (best == std::numeric_limits<uint32_t>::max())
+        {
+            while (emitted[nextSeed])
+            {
+                ++nextSeed;
+            }
+            best = static_cast<uint32_t>(nextSeed);
+            bestShared = 0;
+        }
+
+        if (meshlet.vertexCount + 3 - bestShared > MAX_VERTICES || meshlet.triangleCount == MAX_TRIANGLES)
+        {
+            finishMeshlet();
+            continue;
+        }
+
+        uint32_t packedTriangle = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            uint16_t vertex = indices[best * 3 + k];
+            if (localIndices[vertex] < 0)
+            {
+                localIndices[vertex] = static_cast<int32_t>(meshlet.vertexCount++);
+                m_vertices.emplace_back(vertex);
+            }
+            packedTriangle |= static_cast<uint32_t>(localIndices[vertex]) << (k * 8);
+        }
+        m_triangles.emplace_back(packedTriangle);
+        ++meshlet.triangleCount;
+        emitted[best] = true;
+        --remaining;
+    }
+    if (meshlet.triangleCount > 0)
+    {
+        finishMeshlet();
+    }
+
+    return firstMeshlet;
+}
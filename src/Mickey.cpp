@@ -1,27 +1,11 @@
 #include "Mickey.h"
 
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-
-Mickey::Mickey(uint32_t id, VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuffer copyCommandBuffer,
-	VkDescriptorSetAllocateInfo descSetAllocInfo) :
-	SceneObject::SceneObject(id, physicalDevice, device, copyCommandBuffer, descSetAllocInfo)
+Mickey::Mickey(uint32_t id, VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, VkCommandBuffer copyCommandBuffer,
+	GeometryArena& geometryArena, DeviceFeatures const& deviceFeatures) :
+	SceneObject::SceneObject(id, physicalDevice, device, copyCommandBuffer, geometryArena, nullptr, VK_NULL_HANDLE)
 {
 	loadIndexedMesh(MESH_FILENAME);
-    m_albedoMap = std::make_unique<Texture>(physicalDevice, device, copyCommandBuffer, std::vector{ ALBEDO_FILENAME });
+    m_albedoMap = std::make_unique<Texture>(physicalDevice, device, allocator, copyCommandBuffer, std::vector{ ALBEDO_FILENAME }, deviceFeatures);
+    m_occluder = true;
     SceneObject::SceneObject::init();
 }
-
-void Mickey::update(uint32_t bufferIdx, float dt)
-{
-    GBufferPass::ModelTransforms modelTransforms{};
-    m_orientation += dt * m_rotationSpeed;
-    constexpr float scale = 0.1f;
-    auto translation = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f + m_id * 0.0f, 0.0f, -1.0f + m_id * 1.0f));
-    auto rotationY = glm::rotate(translation, m_orientation, glm::vec3(0.0f, 1.0f, 0.0f));
-    auto rotationZ = glm::rotate(rotationY, static_cast<float>(-M_PI) * 0.5f, glm::vec3(0.0f, 0.0f, 1.0f));
-    modelTransforms.model = glm::scale(rotationZ, glm::vec3(scale, scale, scale));
-    m_uniformBuffers[bufferIdx]->update(&modelTransforms, sizeof(GBufferPass::ModelTransforms));
-}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "MipChain.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+uint32_t MipChain::getLevelCount(uint32_t width, uint32_t height)
+{
+    return static_cast<uint32_t>(std::floor(std::log2(std::max(std::max(width, height), 1u)))) + 1;
+}
+
+std::vector<std::vector<uint8_t>> MipChain::generate(uint8_t const* pixels, uint32_t width, uint32_t height, uint32_t levelCount, Content content)
+{
+    static std::array<float, 256> const srgbToLinear = []()
+    {
+        std::array<float, 256> table;
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            float c = i / 255.0f;
+            table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+    auto toByte = [](float c)
+    {
+        return static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+    };
+    auto linearToSrgb = [&toByte](float c)
+    {
+        return toByte(c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f);
+    };
+
+    std::vector<std::vector<uint8_t>> mips;
+    mips.reserve(levelCount > 0 ? levelCount - 1 : 0);
+    uint8_t const* src = pixels;
+    uint32_t srcWidth = width;
+    uint32_t srcHeight = height;
+    for (uint32_t level = 1; level < levelCount; ++level)
+    {
+        uint32_t dstWidth = std::max(srcWidth / 2, 1u);
+        uint32_t dstHeight = std::max(srcHeight / 2, 1u);
+        std::vector<uint8_t> dst(static_cast<size_t>(dstWidth) * dstHeight * 4);
+        for (uint32_t y = 0; y < dstHeight; ++y)
+        {
+            // A side of one texel is not halved, its texel is taken twice
+            uint32_t y0 = std::min(y * 2, srcHeight - 1);
+            uint32_t y1 = std::min(y * 2 + 1, srcHeight - 1);
+            for (uint32_t x = 0; x < dstWidth; ++x)
+            {
+                uint32_t x0 = std::min(x * 2, srcWidth - 1);
+                uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+                std::array<uint8_t const*, 4> texels{ &src[(static_cast<size_t>(y0) * srcWidth + x0) * 4], &src[(static_cast<size_t>(y0) * srcWidth + x1) * 4],
+                    &src[(static_cast<size_t>(y1) * srcWidth + x0) * 4], &src[(static_cast<size_t>(y1) * srcWidth + x1) * 4] };
+                uint8_t* texel = &dst[(static_cast<size_t>(y) * dstWidth + x) * 4];
+                if (content == Content::COLOR)
+                {
+                    for (uint32_t channel = 0; channel < 3; ++channel)
+                    {
+                        float sum = 0.0f;
+                        for (auto srcTexel : texels)
+                        {
+                            sum += srgbToLinear[srcTexel[channel]];
+                        }
+                        texel[channel] = linearToSrgb(sum * 0.25f);
+                    }
+                }
+                else
+                {
+                    // The average of unit normals is shorter than one where they diverge
+                    std::array<float, 3> normal{};
+                    for (auto srcTexel : texels)
+                    {
+                        for (uint32_t channel = 0; channel < 3; ++channel)
+                        {
+                            normal[channel] += srcTexel[channel] / 127.5f - 1.0f;
+                        }
+                    }
+                    float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                    for (uint32_t channel = 0; channel < 3; ++channel)
+                    {
+                        float n = length > 0.0f ? normal[channel] / length : (channel == 2 ? 1.0f : 0.0f);
+                        texel[channel] = toByte(n * 0.5f + 0.5f);
+                    }
+                }
+                // Alpha is linear already
+                texel[3] = static_cast<uint8_t>((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+            }
+        }
+        mips.emplace_back(std::move(dst));
+        src = mips.back().data();
+        srcWidth = dstWidth;
+        srcHeight = dstHeight;
+    }
+    return mips;
+}
@@ -0,0 +1,230 @@
+#include "OcclusionRasterizer.h"
+
+#include "WorkerPool.h"
+#include "Simd.h"
+
+#include <array>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+static_assert(OcclusionRasterizer::WIDTH % FLOAT_VEC_WIDTH == 0, "Rows are rasterized in whole vectors");
+
+OcclusionRasterizer::OcclusionRasterizer() :
+    m_depth(WIDTH * HEIGHT, 1.0f)
+{
+}
+
+void OcclusionRasterizer::begin(glm::mat4 const& viewProjection)
+{
+    m_viewProjection = viewProjection;
+    m_triangles.clear();
+    std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+}
+
+void OcclusionRasterizer::addOccluder(glm::mat4 const& model, std::vector<glm::vec3> const& positions, std::vector<uint16_t> const& indices)
+{
+    glm::mat4 modelViewProjection = m_viewProjection * model;
+    std::vector<glm::vec4> clipPositions(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        clipPositions[i] = modelViewProjection * glm::vec4(positions[i], 1.0f);
+    }
+
+    // Edges shared by two triangles are inside the occluder, the pixels along them are covered by one side or the other
+    auto getEdgeKey = [](uint16_t a, uint16_t b) { return (static_cast<uint32_t>(std::min(a, b)) << 16) | std::max(a, b); };
+    std::unordered_map<uint32_t, uint32_t> edgeUseCounts;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            ++edgeUseCounts[getEdgeKey(indices[i + j], indices[i + (j + 1) % 3])];
+        }
+    }
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        std::array<glm::vec4, 3> triangle{ clipPositions[indices[i]], clipPositions[indices[i + 1]], clipPositions[indices[i + 2]] };
+        std::array<bool, 3> outerEdges;
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            outerEdges[j] = edgeUseCounts[getEdgeKey(indices[i + j], indices[i + (j + 1) % 3])] == 1;
+        }
+        if (triangle[0].z >= 0.0f && triangle[1].z >= 0.0f && triangle[2].z >= 0.0f)
+        {
+            setupTriangle(triangle, outerEdges);
+            continue;
+        }
+
+        // The part in front of the near plane is a triangle or a quad, the edge along the near plane is an outer one
+        std::array<glm::vec4, 4> polygon;
+        std::array<bool, 4> polygonOuterEdges;
+        uint32_t vertexCount = 0;
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            glm::vec4 const& a = triangle[j];
+            glm::vec4 const& b = triangle[(j + 1) % 3];
+            if (a.z >= 0.0f)
+            {
+                polygonOuterEdges[vertexCount] = outerEdges[j];
+                polygon[vertexCount++] = a;
+            }
+            if ((a.z >= 0.0f) != (b.z >= 0.0f))
+            {
+                polygonOuterEdges[vertexCount] = a.z >= 0.0f ? true : outerEdges[j];
+                polygon[vertexCount++] = a + (b - a) * (a.z / (a.z - b.z));
+            }
+        }
+        for (uint32_t j = 2; j < vertexCount; ++j)
+        {
+            setupTriangle({ polygon[0], polygon[j - 1], polygon[j] },
+                { j == 2 && polygonOuterEdges[0], polygonOuterEdges[j - 1], j + 1 == vertexCount && polygonOuterEdges[j] });
+        }
+    }
+}
+
+void OcclusionRasterizer::setupTriangle(std::array<glm::vec4, 3> const& clip, std::array<bool, 3> const& outerEdges)
+{
+    std::array<glm::vec3, 3> screen;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        if (clip[i].w <= 1e-5f)
+            return;
+        glm::vec3 ndc = glm::vec3(clip[i]) / clip[i].w;
+        screen[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT, ndc.z);
+    }
+
+    glm::vec3 const& s0 = screen[0];
+    glm::vec3 const& s1 = screen[1];
+    glm::vec3 const& s2 = screen[2];
+    float area = (s1.x - s0.x) * (s2.y - s0.y) - (s2.x - s0.x) * (s1.y - s0.y);
+    if (std::abs(area) < 1e-6f)
+        return;
+
+    glm::vec2 boundsMin = glm::max(glm::min(glm::vec2(s0), glm::min(glm::vec2(s1), glm::vec2(s2))), glm::vec2(0.0f));
+    glm::vec2 boundsMax = glm::min(glm::max(glm::vec2(s0), glm::max(glm::vec2(s1), glm::vec2(s2))), glm::vec2(WIDTH - 1, HEIGHT - 1));
+    Triangle triangle{};
+    triangle.minX = static_cast<int32_t>(std::floor(boundsMin.x));
+    triangle.minY = static_cast<int32_t>(std::floor(boundsMin.y));
+    triangle.maxX = static_cast<int32_t>(std::floor(boundsMax.x));
+    triangle.maxY = static_cast<int32_t>(std::floor(boundsMax.y));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    // Both windings are drawn, the edges point inwards either way. Moving the outer edges in by half a pixel drops the
+    // pixels that are only partly inside the occluder.
+    float orientation = area > 0.0f ? 1.0f : -1.0f;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        glm::vec3 const& a = screen[i];
+        glm::vec3 const& b = screen[(i + 1) % 3];
+        glm::vec3 edge = glm::vec3(a.y - b.y, b.x - a.x, a.x * b.y - a.y * b.x) * orientation;
+        if (outerEdges[i])
+        {
+            edge.z -= 0.5f * (std::abs(edge.x) + std::abs(edge.y));
+        }
+        triangle.edges[i] = edge;
+    }
+
+    // Depth is linear in screen space, taken at the far corner of every pixel
+    float depthX = ((s1.z - s0.z) * (s2.y - s0.y) - (s2.z - s0.z) * (s1.y - s0.y)) / area;
+    float depthY = ((s2.z - s0.z) * (s1.x - s0.x) - (s1.z - s0.z) * (s2.x - s0.x)) / area;
+    float depthC = s0.z - depthX * s0.x - depthY * s0.y + 0.5f * (std::abs(depthX) + std::abs(depthY));
+    triangle.depth = glm::vec3(depthX, depthY, depthC);
+
+    m_triangles.emplace_back(triangle);
+}
+
+void OcclusionRasterizer::rasterize(WorkerPool& workerPool)
+{
+    // Bands own their rows, so the workers never write the same pixels
+    workerPool.parallelFor(HEIGHT, BAND_HEIGHT, [this](uint32_t first, uint32_t last, uint32_t)
+    {
+        rasterizeRows(first, last);
+    });
+}
+
+void OcclusionRasterizer::rasterizeRows(uint32_t firstRow, uint32_t lastRow)
+{
+    FloatVec laneCenters = addVec(laneIndexVec(), splatVec(0.5f));
+    FloatVec zero = splatVec(0.0f);
+    for (auto const& triangle : m_triangles)
+    {
+        int32_t minY = std::max(triangle.minY, static_cast<int32_t>(firstRow));
+        int32_t maxY = std::min(triangle.maxY, static_cast<int32_t>(lastRow) - 1);
+        if (minY > maxY)
+            continue;
+
+        FloatVec edgeX0 = splatVec(triangle.edges[0].x);
+        FloatVec edgeX1 = splatVec(triangle.edges[1].x);
+        FloatVec edgeX2 = splatVec(triangle.edges[2].x);
+        FloatVec depthX = splatVec(triangle.depth.x);
+        int32_t firstX = triangle.minX - triangle.minX % static_cast<int32_t>(FLOAT_VEC_WIDTH);
+        for (int32_t y = minY; y <= maxY; ++y)
+        {
+            float centerY = static_cast<float>(y) + 0.5f;
+            FloatVec edgeRow0 = splatVec(triangle.edges[0].y * centerY + triangle.edges[0].z);
+            FloatVec edgeRow1 = splatVec(triangle.edges[1].y * centerY + triangle.edges[1].z);
+            FloatVec edgeRow2 = splatVec(triangle.edges[2].y * centerY + triangle.edges[2].z);
+            FloatVec depthRow = splatVec(triangle.depth.y * centerY + triangle.depth.z);
+            float* depthRowValues = &m_depth[y * WIDTH];
+            for (int32_t x = firstX; x <= triangle.maxX; x += FLOAT_VEC_WIDTH)
+            {
+                FloatVec centerX = addVec(splatVec(static_cast<float>(x)), laneCenters);
+                FloatVec inside = andVec(greaterEqualVec(mulAddVec(edgeX0, centerX, edgeRow0), zero),
+                    andVec(greaterEqualVec(mulAddVec(edgeX1, centerX, edgeRow1), zero), greaterEqualVec(mulAddVec(edgeX2, centerX, edgeRow2), zero)));
+                if (maskVec(inside) == 0)
+                    continue;
+
+                FloatVec depth = loadVec(depthRowValues + x);
+                FloatVec triangleDepth = mulAddVec(depthX, centerX, depthRow);
+                storeVec(depthRowValues + x, selectVec(inside, minVec(triangleDepth, depth), depth));
+            }
+        }
+    }
+}
+
+bool OcclusionRasterizer::isVisible(glm::mat4 const& model, glm::vec3 const& boundsMin, glm::vec3 const& boundsMax) const
+{
+    glm::mat4 modelViewProjection = m_viewProjection * model;
+    glm::vec2 screenMin(std::numeric_limits<float>::max());
+    glm::vec2 screenMax(-std::numeric_limits<float>::max());
+    float minDepth = 1.0f;
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+        glm::vec4 clip = modelViewProjection * glm::vec4(corner, 1.0f);
+        // Boxes reaching behind the near plane cover the camera, nothing is in front of them
+        if (clip.z < 0.0f || clip.w <= 1e-5f)
+            return true;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        glm::vec2 screen((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT);
+        screenMin = glm::min(screenMin, screen);
+        screenMax = glm::max(screenMax, screen);
+        minDepth = glm::min(minDepth, ndc.z);
+    }
+
+    // Every pixel the box touches, not only the ones whose center it covers
+    int32_t minX = static_cast<int32_t>(std::floor(glm::max(screenMin.x, 0.0f)));
+    int32_t minY = static_cast<int32_t>(std::floor(glm::max(screenMin.y, 0.0f)));
+    int32_t maxX = static_cast<int32_t>(std::floor(glm::min(screenMax.x, static_cast<float>(WIDTH - 1))));
+    int32_t maxY = static_cast<int32_t>(std::floor(glm::min(screenMax.y, static_cast<float>(HEIGHT - 1))));
+
+    FloatVec boxDepth = splatVec(minDepth);
+    FloatVec firstPixel = splatVec(static_cast<float>(minX) - 0.5f);
+    FloatVec lastPixel = splatVec(static_cast<float>(maxX) + 0.5f);
+    int32_t firstX = minX - minX % static_cast<int32_t>(FLOAT_VEC_WIDTH);
+    for (int32_t y = minY; y <= maxY; ++y)
+    {
+        float const* depthRowValues = &m_depth[y * WIDTH];
+        for (int32_t x = firstX; x <= maxX; x += FLOAT_VEC_WIDTH)
+        {
+            FloatVec pixel = addVec(splatVec(static_cast<float>(x)), laneIndexVec());
+            FloatVec inRange = andVec(greaterVec(pixel, firstPixel), greaterVec(lastPixel, pixel));
+            if (maskVec(andVec(inRange, greaterEqualVec(loadVec(depthRowValues + x), boxDepth))) != 0)
+                return true;
+        }
+    }
+    return false;
+}
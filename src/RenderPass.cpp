@@ -53,6 +53,16 @@ RenderPass::~RenderPass()
         vkDestroyDescriptorSetLayout(m_vkDevice, m_cameraSetLayout, nullptr);
         m_cameraSetLayout = VK_NULL_HANDLE;
     }
+    if (m_meshletSetLayout != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(m_vkDevice, m_meshletSetLayout, nullptr);
+        m_meshletSetLayout = VK_NULL_HANDLE;
+    }
+    if (m_bindlessSetLayout != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(m_vkDevice, m_bindlessSetLayout, nullptr);
+        m_bindlessSetLayout = VK_NULL_HANDLE;
+    }
     if (m_pipeline != VK_NULL_HANDLE)
     {
         vkDestroyPipeline(m_vkDevice, m_pipeline, nullptr);
@@ -95,11 +105,11 @@ VkShaderModule RenderPass::createVkShader(std::vector<char> const& code)
     return shader;
 }
 
-void RenderPass::begin(VkCommandBuffer commandBuffer, uint32_t frameBufferIdx)
+void RenderPass::begin(VkCommandBuffer commandBuffer, uint32_t frameBufferIdx, VkRenderPass renderPass)
 {
     VkRenderPassBeginInfo renderPassBeginInfo{};
     renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassBeginInfo.renderPass = m_vkRenderPass;
+    renderPassBeginInfo.renderPass = renderPass != VK_NULL_HANDLE ? renderPass : m_vkRenderPass;
     renderPassBeginInfo.framebuffer = m_framebuffers[frameBufferIdx];
     renderPassBeginInfo.renderArea.offset = { 0, 0 };
     renderPassBeginInfo.renderArea.extent = { m_targetWidth, m_targetHeight };
@@ -4,10 +4,13 @@
 #include "SkyPass.h"
 #include "GBufferPass.h"
 #include "ShadowPass.h"
+#include "DepthPyramid.h"
 #include "LightingPass.h"
 #include "ImguiPass.h"
 #include "RenderThreadPool.h"
 #include "InputHandler.h"
+#include "UniformArena.h"
+#include "DescriptorAllocator.h"
 
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
@@ -21,6 +24,9 @@
 
 #include <iostream>
 #include <array>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 
 Renderer::Renderer()
 {
@@ -28,16 +34,17 @@ Renderer::Renderer()
 
     m_inputHandler = std::make_unique<InputHandler>(m_window);
 
-    m_depthBuffer = std::make_unique<Texture>(m_vkPhysicalDevice, m_vkDevice, WINDOW_WIDTH, WINDOW_HEIGHT, 
+    m_depthBuffer = std::make_unique<Texture>(m_vkPhysicalDevice, m_vkDevice, m_memoryAllocator.get(), WINDOW_WIDTH, WINDOW_HEIGHT, 
         VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    m_depthPyramid = std::make_unique<DepthPyramid>(m_vkDevice, m_memoryAllocator.get(), m_depthBuffer.get());
 
-    m_gBufferAlbedo = std::make_unique<Texture>(m_vkPhysicalDevice, m_vkDevice, WINDOW_WIDTH, WINDOW_HEIGHT,
+    m_gBufferAlbedo = std::make_unique<Texture>(m_vkPhysicalDevice, m_vkDevice, m_memoryAllocator.get(), WINDOW_WIDTH, WINDOW_HEIGHT,
         VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
 
-    m_gBufferNormal = std::make_unique<Texture>(m_vkPhysicalDevice, m_vkDevice, WINDOW_WIDTH, WINDOW_HEIGHT,
+    m_gBufferNormal = std::make_unique<Texture>(m_vkPhysicalDevice, m_vkDevice, m_memoryAllocator.get(), WINDOW_WIDTH, WINDOW_HEIGHT,
         VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
 
-    m_shadowMap = std::make_unique<Texture>(m_vkPhysicalDevice, m_vkDevice, ShadowPass::MAP_WIDTH, ShadowPass::MAP_HEIGHT,
+    m_shadowMap = std::make_unique<Texture>(m_vkPhysicalDevice, m_vkDevice, m_memoryAllocator.get(), ShadowPass::MAP_WIDTH, ShadowPass::MAP_HEIGHT,
         VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
 
     uint32_t imageCount = 0;
@@ -52,16 +59,19 @@ Renderer::Renderer()
 
     m_renderThreadPool = std::make_unique<RenderThreadPool>(m_vkDevice, m_queueFamilyIdx, m_threadCount);
 
+    m_uniformArena = std::make_unique<UniformArena>(m_vkPhysicalDevice, m_vkDevice, m_memoryAllocator.get());
+    m_descriptorAllocator = std::make_unique<DescriptorAllocator>(m_vkDevice);
+
     m_renderPasses.resize(RenderPassId::COUNT);
 
     std::vector<Texture*> skyTargets{ m_gBufferAlbedo.get() };
-    m_renderPasses[RenderPassId::SKY] = std::make_unique<SkyPass>(m_vkPhysicalDevice, m_vkDevice, m_renderThreadPool.get(), skyTargets, m_presentQueue, m_queueFamilyIdx);
+    m_renderPasses[RenderPassId::SKY] = std::make_unique<SkyPass>(m_vkPhysicalDevice, m_vkDevice, m_memoryAllocator.get(), m_renderThreadPool.get(), m_descriptorAllocator.get(), skyTargets, m_presentQueue, m_queueFamilyIdx, m_deviceFeatures);
 
     std::vector<Texture*> gBufferColorTargets{m_gBufferAlbedo.get(), m_gBufferNormal.get()};
-    m_renderPasses[RenderPassId::GBUFFER] = std::make_unique<GBufferPass>(m_vkDevice, m_renderThreadPool.get(), gBufferColorTargets, m_depthBuffer.get());
+    m_renderPasses[RenderPassId::GBUFFER] = std::make_unique<GBufferPass>(m_vkDevice, m_renderThreadPool.get(), gBufferColorTargets, m_depthBuffer.get(), m_depthPyramid.get(), m_deviceFeatures);
 
     std::vector<Texture*> shadowPassDepthTargets{ m_shadowMap.get() };
-    m_renderPasses[RenderPassId::SHADOW] = std::make_unique<ShadowPass>(m_vkPhysicalDevice, m_vkDevice, m_renderThreadPool.get(), shadowPassDepthTargets);
+    m_renderPasses[RenderPassId::SHADOW] = std::make_unique<ShadowPass>(m_vkPhysicalDevice, m_vkDevice, m_renderThreadPool.get(), shadowPassDepthTargets, m_deviceFeatures);
 
     std::vector<Texture*> onScreenColorTargets;
     for (auto& framebuffer : m_frameBuffers)
@@ -69,7 +79,7 @@ Renderer::Renderer()
         onScreenColorTargets.emplace_back(framebuffer.get());
     }
     std::vector<Texture*> lightingSrcTextures{ m_gBufferAlbedo.get(), m_gBufferNormal.get(), m_depthBuffer.get(), m_shadowMap.get() };
-    m_renderPasses[RenderPassId::LIGHTING] = std::make_unique<LightingPass>(m_vkPhysicalDevice, m_vkDevice, m_renderThreadPool.get(), onScreenColorTargets, lightingSrcTextures);
+    m_renderPasses[RenderPassId::LIGHTING] = std::make_unique<LightingPass>(m_vkDevice, m_renderThreadPool.get(), m_uniformArena.get(), m_descriptorAllocator.get(), onScreenColorTargets, lightingSrcTextures);
 
     ImguiPass::InitInfo imguiInitInfo{};
     imguiInitInfo.instance = m_vkInstance;
@@ -80,7 +90,7 @@ Renderer::Renderer()
     imguiInitInfo.queue = m_presentQueue;
     m_renderPasses[RenderPassId::IMGUI] = std::make_unique<ImguiPass>(imguiInitInfo, m_vkDevice, m_renderThreadPool.get(), onScreenColorTargets);
 
-    m_scene = std::make_unique<Scene>(m_renderPasses[RenderPassId::GBUFFER].get(), m_vkPhysicalDevice, m_vkDevice, m_presentQueue, m_queueFamilyIdx);
+    m_scene = std::make_unique<Scene>(m_renderPasses[RenderPassId::GBUFFER].get(), m_depthPyramid.get(), m_uniformArena.get(), m_descriptorAllocator.get(), m_vkPhysicalDevice, m_vkDevice, m_memoryAllocator.get(), m_presentQueue, m_queueFamilyIdx, m_deviceFeatures);
 
     // Set the render job dependencies
 
@@ -178,14 +188,127 @@ void Renderer::initVulkan()
     queueCreateInfo.queueCount = m_threadCount + 1;
     std::vector<float> queuePriorities(m_threadCount + 1, 1.0f);
     queueCreateInfo.pQueuePriorities = queuePriorities.data();
-    VkPhysicalDeviceFeatures deviceFeatures{};
-    deviceFeatures.samplerAnisotropy = VK_TRUE;
+
+    uint32_t deviceExtensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(m_vkPhysicalDevice, nullptr, &deviceExtensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(deviceExtensionCount);
+    vkEnumerateDeviceExtensionProperties(m_vkPhysicalDevice, nullptr, &deviceExtensionCount, availableExtensions.data());
+    auto isExtensionAvailable = [&availableExtensions](const char* name)
+    {
+        return std::any_of(availableExtensions.begin(), availableExtensions.end(), [name](VkExtensionProperties const& extension)
+            {
+                return strcmp(extension.extensionName, name) == 0;
+            });
+    };
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures{};
+    hostImageCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 supportedFeatures{};
+    supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures.pNext = &vulkan12Features;
+    bool meshShaderExtension = isExtensionAvailable(VK_EXT_MESH_SHADER_EXTENSION_NAME) && isExtensionAvailable(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
+    if (meshShaderExtension)
+    {
+        vulkan12Features.pNext = &meshShaderFeatures;
+    }
+    // The device is created at 1.2, where the extensions host image copy depends on are not core yet
+    bool hostImageCopyExtension = isExtensionAvailable(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME) && isExtensionAvailable(VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME) &&
+        isExtensionAvailable(VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME);
+    if (hostImageCopyExtension)
+    {
+        hostImageCopyFeatures.pNext = supportedFeatures.pNext;
+        supportedFeatures.pNext = &hostImageCopyFeatures;
+    }
+    vkGetPhysicalDeviceFeatures2(m_vkPhysicalDevice, &supportedFeatures);
+
+    // The scene is drawn with indirect draws whose first instance selects the object data, and the fragment shader
+    // picks the albedo map of the draw from an array of textures
+    if (!supportedFeatures.features.drawIndirectFirstInstance || !supportedFeatures.features.shaderSampledImageArrayDynamicIndexing)
+    {
+        std::cout << "Physical device does not support indirect first instance or dynamic texture array indexing" << std::endl;
+        std::terminate();
+    }
+    // The bindless table is a partially bound, update-after-bind set indexed with non-uniform indices
+    if (!vulkan12Features.shaderSampledImageArrayNonUniformIndexing || !vulkan12Features.descriptorBindingPartiallyBound ||
+        !vulkan12Features.descriptorBindingSampledImageUpdateAfterBind || !vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind)
+    {
+        std::cout << "Physical device does not support descriptor indexing" << std::endl;
+        std::terminate();
+    }
+
+    std::vector<const char*> deviceExtensions{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    VkPhysicalDeviceFeatures2 deviceFeatures{};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.features.samplerAnisotropy = VK_TRUE;
+    deviceFeatures.features.drawIndirectFirstInstance = VK_TRUE;
+    deviceFeatures.features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    deviceFeatures.features.multiDrawIndirect = supportedFeatures.features.multiDrawIndirect;
+    m_deviceFeatures.multiDrawIndirect = supportedFeatures.features.multiDrawIndirect;
+    deviceFeatures.features.textureCompressionBC = supportedFeatures.features.textureCompressionBC;
+    m_deviceFeatures.textureCompressionBC = supportedFeatures.features.textureCompressionBC;
+
+    VkPhysicalDeviceVulkan12Features enabledVulkan12Features{};
+    enabledVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    enabledVulkan12Features.drawIndirectCount = vulkan12Features.drawIndirectCount;
+    enabledVulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    enabledVulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+    enabledVulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    enabledVulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    m_deviceFeatures.drawIndirectCount = vulkan12Features.drawIndirectCount;
+    deviceFeatures.pNext = &enabledVulkan12Features;
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT enabledMeshShaderFeatures{};
+    enabledMeshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    m_deviceFeatures.meshShader = meshShaderExtension && meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+    if (m_deviceFeatures.meshShader)
+    {
+        enabledMeshShaderFeatures.taskShader = VK_TRUE;
+        enabledMeshShaderFeatures.meshShader = VK_TRUE;
+        enabledMeshShaderFeatures.pNext = deviceFeatures.pNext;
+        deviceFeatures.pNext = &enabledMeshShaderFeatures;
+        deviceExtensions.emplace_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+        deviceExtensions.emplace_back(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
+    }
+    // Textures are copied straight into the layout they are sampled in
+    VkPhysicalDeviceHostImageCopyFeaturesEXT enabledHostImageCopyFeatures{};
+    enabledHostImageCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+    if (hostImageCopyExtension && hostImageCopyFeatures.hostImageCopy)
+    {
+        VkPhysicalDeviceHostImageCopyPropertiesEXT hostImageCopyProperties{};
+        hostImageCopyProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &hostImageCopyProperties;
+        vkGetPhysicalDeviceProperties2(m_vkPhysicalDevice, &properties);
+        std::vector<VkImageLayout> copyDstLayouts(hostImageCopyProperties.copyDstLayoutCount);
+        hostImageCopyProperties.pCopyDstLayouts = copyDstLayouts.data();
+        vkGetPhysicalDeviceProperties2(m_vkPhysicalDevice, &properties);
+        m_deviceFeatures.hostImageCopy = std::find(copyDstLayouts.begin(), copyDstLayouts.end(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) != copyDstLayouts.end();
+    }
+    if (m_deviceFeatures.hostImageCopy)
+    {
+        enabledHostImageCopyFeatures.hostImageCopy = VK_TRUE;
+        enabledHostImageCopyFeatures.pNext = deviceFeatures.pNext;
+        deviceFeatures.pNext = &enabledHostImageCopyFeatures;
+        deviceExtensions.emplace_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME);
+        deviceExtensions.emplace_back(VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME);
+        deviceExtensions.emplace_back(VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME);
+    }
+    m_deviceFeatures.memoryBudget = isExtensionAvailable(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_deviceFeatures.memoryBudget)
+    {
+        deviceExtensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
     VkDeviceCreateInfo deviceCreateInfo{};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceCreateInfo.pNext = &deviceFeatures;
     deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
     deviceCreateInfo.queueCreateInfoCount = 1;
-    deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
-    const std::vector<const char*> deviceExtensions{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
     deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
     deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
 #if _DEBUG
@@ -202,6 +325,22 @@ void Renderer::initVulkan()
     }
     vkGetDeviceQueue(m_vkDevice, m_queueFamilyIdx, 0, &m_presentQueue);
 
+    if (m_deviceFeatures.meshShader)
+    {
+        m_deviceFeatures.vkCmdDrawMeshTasksIndirectEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksIndirectEXT>(vkGetDeviceProcAddr(m_vkDevice, "vkCmdDrawMeshTasksIndirectEXT"));
+        m_deviceFeatures.vkCmdDrawMeshTasksIndirectCountEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksIndirectCountEXT>(vkGetDeviceProcAddr(m_vkDevice, "vkCmdDrawMeshTasksIndirectCountEXT"));
+    }
+    if (m_deviceFeatures.hostImageCopy)
+    {
+        m_deviceFeatures.vkTransitionImageLayoutEXT = reinterpret_cast<PFN_vkTransitionImageLayoutEXT>(vkGetDeviceProcAddr(m_vkDevice, "vkTransitionImageLayoutEXT"));
+        m_deviceFeatures.vkCopyMemoryToImageEXT = reinterpret_cast<PFN_vkCopyMemoryToImageEXT>(vkGetDeviceProcAddr(m_vkDevice, "vkCopyMemoryToImageEXT"));
+    }
+    m_memoryAllocator = std::make_unique<MemoryAllocator>(m_vkPhysicalDevice, m_vkDevice);
+    if (m_deviceFeatures.memoryBudget)
+    {
+        m_memoryAllocator->useMemoryBudget();
+    }
+
     VkSurfaceCapabilitiesKHR surfaceCapabilities;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_vkPhysicalDevice, m_vkSurface, &surfaceCapabilities);
     m_minImageCount = surfaceCapabilities.minImageCount;
@@ -285,14 +424,18 @@ Renderer::~Renderer()
     m_gBufferAlbedo.reset();
     m_gBufferNormal.reset();
     m_depthBuffer.reset();
+    m_depthPyramid.reset();
     m_shadowMap.reset();
     m_frameBuffers.clear();
     m_scene->clean();
+    m_uniformArena.reset();
+    m_descriptorAllocator.reset();
 
     ImGui_ImplVulkan_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
+    m_memoryAllocator.reset();
     vkDestroySwapchainKHR(m_vkDevice, m_vkSwapChain, nullptr);
     vkDestroyDevice(m_vkDevice, nullptr);
     vkDestroySurfaceKHR(m_vkInstance, m_vkSurface, nullptr);
@@ -301,16 +444,73 @@ Renderer::~Renderer()
     glfwTerminate();
 }
 
+void Renderer::showMemoryReport()
+{
+    static constexpr float MEGABYTE = 1024.0f * 1024.0f;
+    static constexpr char const* REPORT_FILENAME = "memory_report.json";
+
+    MemoryAllocator const& allocator = *m_memoryAllocator;
+    MemoryAllocator::Report report = allocator.getReport();
+
+    ImGui::Begin("Memory");
+    ImGui::Text("%s", m_deviceFeatures.memoryBudget ? "Budgets from VK_EXT_memory_budget" : "No VK_EXT_memory_budget, budgets are the heap sizes");
+    for (size_t heapIdx = 0; heapIdx < report.heaps.size(); ++heapIdx)
+    {
+        MemoryAllocator::HeapReport const& heap = report.heaps[heapIdx];
+        ImGui::Text("Heap %zu%s: %.1f / %.1f MB, %.1f MB allocated here", heapIdx, (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "",
+            heap.usage / MEGABYTE, heap.budget / MEGABYTE, heap.allocatedBytes / MEGABYTE);
+        ImGui::ProgressBar(heap.budget > 0 ? static_cast<float>(heap.usage) / heap.budget : 0.0f);
+    }
+    ImGui::Separator();
+    ImGui::Text("%u device allocations, %u blocks, %.1f MB allocated, %.1f MB used", report.stats.deviceAllocationCount, report.stats.blockCount,
+        report.stats.allocatedBytes / MEGABYTE, report.stats.usedBytes / MEGABYTE);
+    for (uint32_t category = 0; category < MemoryAllocator::Category::CATEGORY_COUNT; ++category)
+    {
+        ImGui::Text("%-14s %5u allocations %9.2f MB", MemoryAllocator::getCategoryName(static_cast<MemoryAllocator::Category>(category)),
+            report.categories[category].allocationCount, report.categories[category].usedBytes / MEGABYTE);
+    }
+    if (ImGui::Button("Write memory_report.json"))
+    {
+        std::ofstream reportFile(REPORT_FILENAME);
+        allocator.writeReport(reportFile);
+    }
+    ImGui::End();
+}
+
+void Renderer::showUpdateStats()
+{
+    Scene::UpdateStats const& stats = m_scene->getUpdateStats();
+
+    ImGui::Begin("Scene update");
+    bool softwareOcclusionCulling = m_scene->isSoftwareOcclusionCulling();
+    if (ImGui::Checkbox("Occlusion culling on the CPU", &softwareOcclusionCulling))
+    {
+        m_scene->setSoftwareOcclusionCulling(softwareOcclusionCulling);
+    }
+    ImGui::Text("Animate    %6.3f ms", stats.animateTime);
+    ImGui::Text("Transforms %6.3f ms", stats.transformTime);
+    ImGui::Text("Upload     %6.3f ms, %u entities written", stats.uploadTime, stats.uploadedCount);
+    ImGui::Text("Culling    %6.3f ms", stats.cullTime);
+    ImGui::Separator();
+    ImGui::Text("%u ranges on %u workers, %.3f ms mean, %.3f ms slowest", stats.rangeCount, stats.workerCount,
+        stats.meanRangeTime, stats.maxRangeTime);
+    ImGui::End();
+}
+
 void Renderer::beginFrame()
 {
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
     ImGui::ShowDemoWindow(nullptr);
+    showMemoryReport();
+    showUpdateStats();
     ImGui::Render();
 
     vkWaitForFences(m_vkDevice, 1, &m_vkFences[m_bufferIdx], VK_TRUE, UINT64_MAX);
     vkResetFences(m_vkDevice, 1, &m_vkFences[m_bufferIdx]);
+    // The GPU is done with the uniforms of the frame that last used this buffer index
+    m_uniformArena->reset(m_bufferIdx);
 
     vkAcquireNextImageKHR(m_vkDevice, m_vkSwapChain, UINT64_MAX, m_frameBufferAvailable[m_bufferIdx], VK_NULL_HANDLE, &m_frameBufferIdx);
 
@@ -353,7 +553,7 @@ void Renderer::update()
 {
     m_inputHandler->update();
 
-    m_scene->update(m_inputHandler.get(), m_bufferIdx);
+    m_scene->update(m_inputHandler.get(), m_bufferIdx, m_dt);
 }
 
 void Renderer::render()
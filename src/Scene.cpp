@@ -4,61 +4,52 @@
 #include "InputHandler.h"
 #include "Mickey.h"
 #include "Floor.h"
+#include "DepthPyramid.h"
 
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_vulkan.h"
 
+#include <glm/gtc/matrix_transform.hpp>
+
 #include <iostream>
 #include <array>
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <chrono>
 
-Scene::Scene(RenderPass* renderPass, VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, uint32_t queueFamilyIdx) :
+static DescriptorAllocator::Binding storageBuffer(VkDescriptorBufferInfo const& bufferInfo)
+{
+    return DescriptorAllocator::Binding::buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferInfo);
+}
+
+static float getMilliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+Scene::Scene(RenderPass* renderPass, DepthPyramid* depthPyramid, UniformArena* uniformArena, DescriptorAllocator* descriptorAllocator, VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, VkQueue queue,
+    uint32_t queueFamilyIdx,
+    DeviceFeatures const& deviceFeatures) :
     m_vkDevice(device)
+    , m_deviceFeatures(deviceFeatures)
 {
     static constexpr uint32_t MICKEY_COUNT = 4;
     static constexpr uint32_t OBJECT_COUNT = MICKEY_COUNT + 1;
+    static_assert(OBJECT_COUNT <= BindlessTable::MAX_MATERIAL_COUNT, "Every object needs a slot in the bindless table");
 
-    VkDescriptorPoolSize uniformBufferPoolSize{};
-    uniformBufferPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uniformBufferPoolSize.descriptorCount = OBJECT_COUNT * 2 * static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-    VkDescriptorPoolSize texturePoolSize{};
-    texturePoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    texturePoolSize.descriptorCount = OBJECT_COUNT * static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-
-    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
-    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    std::array<VkDescriptorPoolSize, 2> poolSizes{ uniformBufferPoolSize, texturePoolSize };
-    descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-    descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
-    descriptorPoolCreateInfo.maxSets = OBJECT_COUNT * 2 * static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-
-    VkResult result = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool);
-    if (result != VK_SUCCESS)
-    {
-        std::cout << "Failed to create descriptor pool" << std::endl;
-        std::terminate();
-    }
-
-    std::vector<VkDescriptorSetLayout> modelLayouts(Renderer::BUFFER_COUNT, renderPass->m_modelSetLayout);
-    VkDescriptorSetAllocateInfo modelDescSetAllocInfo{};
-    modelDescSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    modelDescSetAllocInfo.descriptorPool = m_descriptorPool;
-    modelDescSetAllocInfo.descriptorSetCount = static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-    modelDescSetAllocInfo.pSetLayouts = modelLayouts.data();
-
-    std::vector<VkDescriptorSetLayout> cameraLayouts(Renderer::BUFFER_COUNT, renderPass->m_cameraSetLayout);
-    VkDescriptorSetAllocateInfo cameraDescSetAllocInfo{};
-    cameraDescSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    cameraDescSetAllocInfo.descriptorPool = m_descriptorPool;
-    cameraDescSetAllocInfo.descriptorSetCount = static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-    cameraDescSetAllocInfo.pSetLayouts = cameraLayouts.data();
+    // Shared by all static meshes of the scene
+    static constexpr uint32_t VERTEX_CAPACITY = 1 << 17;
+    static constexpr uint32_t INDEX_CAPACITY = 1 << 20;
+    static constexpr uint32_t MESHLET_CAPACITY = 1 << 13;
 
     VkCommandPoolCreateInfo commanPoolCreateInfo{};
     commanPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     commanPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     commanPoolCreateInfo.queueFamilyIndex = queueFamilyIdx;
     VkCommandPool copyCommandPool{ VK_NULL_HANDLE };
-    result = vkCreateCommandPool(device, &commanPoolCreateInfo, nullptr, &copyCommandPool);
+    VkResult result = vkCreateCommandPool(device, &commanPoolCreateInfo, nullptr, &copyCommandPool);
     if (result != VK_SUCCESS)
     {
         std::cout << "Failed to create copy command pool" << std::endl;
@@ -80,14 +71,123 @@ Scene::Scene(RenderPass* renderPass, VkPhysicalDevice physicalDevice, VkDevice d
     vkBeginCommandBuffer(copyCommandBuffer, &beginInfo);
 
     m_cameras.resize(Camera::Type::COUNT);
-    m_cameras[Camera::Type::NORMAL] = std::make_unique<Camera>(Camera::Type::NORMAL, physicalDevice, device, cameraDescSetAllocInfo);
-    m_cameras[Camera::Type::LIGHT] = std::make_unique<Camera>(Camera::Type::LIGHT, physicalDevice, device, cameraDescSetAllocInfo);
-    
+    m_cameras[Camera::Type::NORMAL] = std::make_unique<Camera>(Camera::Type::NORMAL, uniformArena, descriptorAllocator, renderPass->m_cameraSetLayout);
+    m_cameras[Camera::Type::LIGHT] = std::make_unique<Camera>(Camera::Type::LIGHT, uniformArena, descriptorAllocator, renderPass->m_cameraSetLayout);
+
+    // The main thread is a worker too
+    m_workerPool = std::make_unique<WorkerPool>(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+    m_geometryArena = std::make_unique<GeometryArena>(device, allocator, VERTEX_CAPACITY, INDEX_CAPACITY, MESHLET_CAPACITY);
     for (int i = 0; i < MICKEY_COUNT; ++i)
     {
-        m_objects.emplace_back(std::make_unique<Mickey>(i, physicalDevice, device, copyCommandBuffer, modelDescSetAllocInfo));
+        m_objects.emplace_back(std::make_unique<Mickey>(i, physicalDevice, device, allocator, copyCommandBuffer, *m_geometryArena, m_deviceFeatures));
+    }
+    m_objects.emplace_back(std::make_unique<Floor>(OBJECT_COUNT, physicalDevice, device, allocator, copyCommandBuffer, *m_geometryArena, m_deviceFeatures));
+
+    // Every mesh has its own material, at the index of the mesh
+    m_bindlessTable = std::make_unique<BindlessTable>(device, allocator, renderPass->m_bindlessSetLayout);
+    for (auto const& object : m_objects)
+    {
+        m_bindlessTable->addMaterial({ m_bindlessTable->addTexture(*object->m_albedoMap) });
+    }
+    auto addEntity = [this](uint32_t mesh, uint32_t parent, glm::vec3 const& position, glm::mat4 const& localTransform, float spinSpeed)
+    {
+        SceneObject const& object = *m_objects[mesh];
+        return m_entities.add({ mesh, mesh, object.m_baseVertex, parent, position, localTransform * object.m_dequantizeTransform, spinSpeed,
+            object.m_boundingSphere, object.m_boundsMin, object.m_boundsMax });
+    };
+    // The Mickeys stand in a row on their side and spin in place on the floor
+    glm::mat4 onSide = glm::rotate(glm::mat4(1.0f), static_cast<float>(-M_PI) * 0.5f, glm::vec3(0.0f, 0.0f, 1.0f));
+    std::vector<uint32_t> mickeyEntities;
+    for (uint32_t i = 0; i < MICKEY_COUNT; ++i)
+    {
+        mickeyEntities.emplace_back(addEntity(i, EntityStore::INVALID_IDX, glm::vec3(0.5f, 0.0f, -1.0f + i * 1.0f), glm::scale(onSide, glm::vec3(0.1f)), 1.0f));
+    }
+    addEntity(MICKEY_COUNT, EntityStore::INVALID_IDX, glm::vec3(0.0f, -0.45f, 0.0f), glm::scale(glm::mat4(1.0f), glm::vec3(10.0f)), 0.0f);
+    // A small Mickey is attached to the first one and circles it as it spins
+    addEntity(0, mickeyEntities[0], glm::vec3(0.3f, 0.2f, 0.0f), glm::scale(onSide, glm::vec3(0.03f)), 3.0f);
+    uint32_t entityCount = m_entities.getCount();
+
+    m_frustumCuller.resize(entityCount);
+    m_bvh.resize(entityCount);
+    m_boundsVersions.resize(entityCount, 0);
+    for (auto& uploadedVersions : m_uploadedVersions)
+    {
+        uploadedVersions.resize(entityCount, 0);
+    }
+    m_occlusionRasterizer = std::make_unique<OcclusionRasterizer>();
+
+    m_drawCuller = std::make_unique<DrawCuller>(device, renderPass->m_cameraSetLayout);
+    m_clusterCuller = std::make_unique<ClusterCuller>(device, renderPass->m_cameraSetLayout);
+
+    // Every level of detail of an entity fits in the culled index range of the most detailed one of its mesh
+    uint32_t culledIndexCount = 0;
+    for (uint32_t mesh : m_entities.m_meshes)
+    {
+        SceneObject const& obj = *m_objects[mesh];
+        m_culledFirstIndices.emplace_back(culledIndexCount);
+        culledIndexCount += obj.m_lods[0].indexCount;
+        m_maxMeshletCount = std::max(m_maxMeshletCount, obj.m_lods[0].meshletCount);
+    }
+
+
+    VkDeviceSize candidateBufferSize = CANDIDATE_OFFSET + sizeof(GBufferPass::DrawCommand) * entityCount;
+    VkDeviceSize drawBufferSize = DRAW_COMMAND_OFFSET + sizeof(GBufferPass::DrawCommand) * entityCount * CullPhase::COUNT;
+    for (uint32_t i = 0; i < Renderer::BUFFER_COUNT; ++i)
+    {
+        m_objectBuffers[i] = std::make_unique<Buffer>(device, allocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(GBufferPass::ObjectData) * entityCount,
+            MemoryAllocator::Category::UNIFORM);
+
+        VkDescriptorBufferInfo objectBufferInfo{ m_objectBuffers[i]->m_vkBuffer, 0, VK_WHOLE_SIZE };
+        // Only the camera with a depth pyramid samples it, the pyramid is bound for the others too to keep the sets complete
+        VkDescriptorImageInfo depthPyramidInfo{};
+        depthPyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        depthPyramidInfo.imageView = depthPyramid->m_frames[i].imageView;
+        depthPyramidInfo.sampler = depthPyramid->m_sampler;
+        m_objectDescriptorSets[i] = descriptorAllocator->getSet(renderPass->m_modelSetLayout, { storageBuffer(objectBufferInfo) });
+
+        for (uint32_t cameraType = 0; cameraType < Camera::Type::COUNT; ++cameraType)
+        {
+            // The CPU writes the candidates, the draw culling appends the visible ones to the draw commands and the cluster
+            // culling atomically adds to their index counts
+            m_candidateBuffers[i][cameraType] = std::make_unique<Buffer>(device, allocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, candidateBufferSize,
+                MemoryAllocator::Category::DRAW);
+            m_drawBuffers[i][cameraType] = std::make_unique<Buffer>(device, allocator,
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, drawBufferSize,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryAllocator::Category::DRAW);
+            m_drawnEarlyBuffers[i][cameraType] = std::make_unique<Buffer>(device, allocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                sizeof(uint32_t) * entityCount, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryAllocator::Category::DRAW);
+            m_culledIndexBuffers[i][cameraType] = std::make_unique<Buffer>(device, allocator, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                sizeof(uint32_t) * culledIndexCount, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryAllocator::Category::DRAW);
+            VkDescriptorBufferInfo drawBufferInfo{ m_drawBuffers[i][cameraType]->m_vkBuffer, 0, VK_WHOLE_SIZE };
+
+            m_drawCullDescriptorSets[i][cameraType] = descriptorAllocator->getSet(m_drawCuller->m_setLayout, {
+                storageBuffer(objectBufferInfo),
+                storageBuffer({ m_candidateBuffers[i][cameraType]->m_vkBuffer, 0, VK_WHOLE_SIZE }),
+                storageBuffer(drawBufferInfo),
+                storageBuffer({ m_drawnEarlyBuffers[i][cameraType]->m_vkBuffer, 0, VK_WHOLE_SIZE }),
+                DescriptorAllocator::Binding::image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depthPyramidInfo) });
+
+            m_cullDescriptorSets[i][cameraType] = descriptorAllocator->getSet(m_clusterCuller->m_setLayout, {
+                storageBuffer(objectBufferInfo),
+                storageBuffer(m_geometryArena->getDescriptorInfo(GeometryArena::Stream::MESHLETS)),
+                storageBuffer(m_geometryArena->getDescriptorInfo(GeometryArena::Stream::MESHLET_VERTICES)),
+                storageBuffer(m_geometryArena->getDescriptorInfo(GeometryArena::Stream::MESHLET_TRIANGLES)),
+                storageBuffer({ m_culledIndexBuffers[i][cameraType]->m_vkBuffer, 0, VK_WHOLE_SIZE }),
+                storageBuffer(drawBufferInfo) });
+
+            if (!renderPass->m_meshShading)
+                continue;
+
+            m_meshletDescriptorSets[i][cameraType] = descriptorAllocator->getSet(renderPass->m_meshletSetLayout, {
+                storageBuffer(m_geometryArena->getDescriptorInfo(GeometryArena::Stream::MESHLETS)),
+                storageBuffer(m_geometryArena->getDescriptorInfo(GeometryArena::Stream::MESHLET_VERTICES)),
+                storageBuffer(m_geometryArena->getDescriptorInfo(GeometryArena::Stream::MESHLET_TRIANGLES)),
+                storageBuffer(m_geometryArena->getDescriptorInfo(GeometryArena::Stream::POSITIONS)),
+                storageBuffer(m_geometryArena->getDescriptorInfo(GeometryArena::Stream::ATTRIBUTES)),
+                storageBuffer(drawBufferInfo) });
+        }
     }
-    m_objects.emplace_back(std::make_unique<Floor>(OBJECT_COUNT, physicalDevice, device, copyCommandBuffer, modelDescSetAllocInfo));
 
     ImGui_ImplVulkan_CreateFontsTexture(copyCommandBuffer);
 
@@ -98,10 +198,21 @@ Scene::Scene(RenderPass* renderPass, VkPhysicalDevice physicalDevice, VkDevice d
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &copyCommandBuffer;
 
-    vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(queue);
+    // Staging memory is given back as soon as the uploads are done
+    VkFenceCreateInfo fenceCreateInfo{};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence uploadFence{ VK_NULL_HANDLE };
+    vkCreateFence(device, &fenceCreateInfo, nullptr, &uploadFence);
+    vkQueueSubmit(queue, 1, &submitInfo, uploadFence);
+    vkWaitForFences(device, 1, &uploadFence, VK_TRUE, UINT64_MAX);
+    vkDestroyFence(device, uploadFence, nullptr);
 
     ImGui_ImplVulkan_DestroyFontUploadObjects();
+    m_geometryArena->releaseStagingBuffers();
+    for (auto& object : m_objects)
+    {
+        object->releaseStagingBuffers();
+    }
 
     vkFreeCommandBuffers(device, copyCommandPool, 1, &copyCommandBuffer);
     vkDestroyCommandPool(device, copyCommandPool, nullptr);
@@ -111,10 +222,25 @@ void Scene::clean()
 {
     m_cameras.clear();
 	m_objects.clear();
-    vkDestroyDescriptorPool(m_vkDevice, m_descriptorPool, nullptr);
+    for (uint32_t i = 0; i < Renderer::BUFFER_COUNT; ++i)
+    {
+        m_objectBuffers[i].reset();
+        for (uint32_t cameraType = 0; cameraType < Camera::Type::COUNT; ++cameraType)
+        {
+            m_candidateBuffers[i][cameraType].reset();
+            m_drawBuffers[i][cameraType].reset();
+            m_drawnEarlyBuffers[i][cameraType].reset();
+            m_culledIndexBuffers[i][cameraType].reset();
+        }
+    }
+    m_drawCuller.reset();
+    m_clusterCuller.reset();
+    m_workerPool.reset();
+    m_geometryArena.reset();
+    m_bindlessTable.reset();
 }
 
-void Scene::update(InputHandler* inputHandler, uint32_t bufferIdx)
+void Scene::update(InputHandler* inputHandler, uint32_t bufferIdx, float dt)
 {
     glm::vec3 camMoveDir{ 0 };
     InputHandler::KeyState keyState = inputHandler->getKeyState();
@@ -143,21 +269,331 @@ void Scene::update(InputHandler* inputHandler, uint32_t bufferIdx)
     m_cameras[Camera::Type::NORMAL]->turn(inputHandler->getDragVelocity(), bufferIdx);
 
     m_cameras[Camera::Type::NORMAL]->update(bufferIdx);
+
+    // Entities are updated before any pass records, so the G-buffer and shadow passes see the same transforms. Every range
+    // writes the entities that this frame's object buffer does not have yet straight into it.
+    uint32_t entityCount = m_entities.getCount();
+    uint32_t updateRangeCount = (entityCount + UPDATE_GRAIN_SIZE - 1) / UPDATE_GRAIN_SIZE;
+    m_rangeOutputs.resize(std::max<size_t>(m_rangeOutputs.size(), updateRangeCount));
+    auto stepStart = std::chrono::high_resolution_clock::now();
+    m_workerPool->parallelFor(entityCount, UPDATE_GRAIN_SIZE, [&](uint32_t first, uint32_t last, uint32_t)
+    {
+        auto rangeStart = std::chrono::high_resolution_clock::now();
+        m_entities.animate(dt, first, last);
+        m_rangeOutputs[first / UPDATE_GRAIN_SIZE].updateTime = getMilliseconds(rangeStart);
+    });
+    m_updateStats.animateTime = getMilliseconds(stepStart);
+
+    // The world transforms of a level need the ones of the level above it
+    stepStart = std::chrono::high_resolution_clock::now();
+    for (uint32_t level = 0; level < m_entities.getLevelCount(); ++level)
+    {
+        uint32_t levelFirst, levelLast;
+        m_entities.getLevel(level, levelFirst, levelLast);
+        m_workerPool->parallelFor(levelLast - levelFirst, UPDATE_GRAIN_SIZE, [&](uint32_t first, uint32_t last, uint32_t)
+        {
+            m_entities.updateTransforms(levelFirst + first, levelFirst + last);
+        });
+    }
+    m_updateStats.transformTime = getMilliseconds(stepStart);
+
+    auto objectData = static_cast<GBufferPass::ObjectData*>(m_objectBuffers[bufferIdx]->m_hostData);
+    Camera& light = *m_cameras[Camera::Type::LIGHT];
+    stepStart = std::chrono::high_resolution_clock::now();
+    m_workerPool->parallelFor(entityCount, UPDATE_GRAIN_SIZE, [&](uint32_t first, uint32_t last, uint32_t)
+    {
+        auto rangeStart = std::chrono::high_resolution_clock::now();
+        RangeOutput& rangeOutput = m_rangeOutputs[first / UPDATE_GRAIN_SIZE];
+        rangeOutput.movedObjects.clear();
+        rangeOutput.uploadedCount = 0;
+        std::vector<uint32_t>& uploadedVersions = m_uploadedVersions[bufferIdx];
+        for (uint32_t i = first; i < last; ++i)
+        {
+            uint32_t version = m_entities.m_versions[i];
+            glm::mat4 const& model = m_entities.m_modelMatrices[i];
+            if (uploadedVersions[i] != version)
+            {
+                // Filled locally and copied whole, the mapped memory is written once and never read
+                GBufferPass::ObjectData data{};
+                data.model = model;
+                data.normalMatrix = m_entities.m_normalMatrices[i];
+                data.boundingSphere = m_entities.m_boundingSpheres[i];
+                data.materialIdx = m_entities.m_materials[i];
+                data.baseVertex = m_entities.m_baseVertices[i];
+                objectData[i] = data;
+                uploadedVersions[i] = version;
+                ++rangeOutput.uploadedCount;
+            }
+            if (m_boundsVersions[i] != version)
+            {
+                m_frustumCuller.setBounds(i, model, m_entities.m_boundingSpheres[i], m_entities.m_boundsMin[i], m_entities.m_boundsMax[i]);
+                m_boundsVersions[i] = version;
+                rangeOutput.movedObjects.emplace_back(i);
+            }
+        }
+        rangeOutput.minLightDistance = m_frustumCuller.getMinDistance(light.m_position, light.m_direction, first, last);
+        rangeOutput.updateTime += getMilliseconds(rangeStart);
+    });
+    m_updateStats.uploadTime = getMilliseconds(stepStart);
+
+    m_updateStats.rangeCount = updateRangeCount;
+    m_updateStats.workerCount = m_workerPool->getWorkerCount();
+    m_updateStats.meanRangeTime = 0.0f;
+    m_updateStats.maxRangeTime = 0.0f;
+    m_updateStats.uploadedCount = 0;
+    for (uint32_t rangeIdx = 0; rangeIdx < updateRangeCount; ++rangeIdx)
+    {
+        m_updateStats.meanRangeTime += m_rangeOutputs[rangeIdx].updateTime;
+        m_updateStats.maxRangeTime = std::max(m_updateStats.maxRangeTime, m_rangeOutputs[rangeIdx].updateTime);
+        m_updateStats.uploadedCount += m_rangeOutputs[rangeIdx].uploadedCount;
+    }
+    m_updateStats.meanRangeTime /= std::max(updateRangeCount, 1u);
+
+    stepStart = std::chrono::high_resolution_clock::now();
+
+    for (uint32_t rangeIdx = 0; rangeIdx < updateRangeCount; ++rangeIdx)
+    {
+        for (uint32_t i : m_rangeOutputs[rangeIdx].movedObjects)
+        {
+            glm::vec3 boxMin, boxMax;
+            m_frustumCuller.getBox(i, boxMin, boxMax);
+            m_bvh.setBounds(i, boxMin, boxMax);
+        }
+    }
+    m_bvh.update();
+
+    // The light volume reaches back to the first caster, so nothing between it and the light is clipped
+    float minLightDistance = std::numeric_limits<float>::max();
+    for (uint32_t rangeIdx = 0; rangeIdx < updateRangeCount; ++rangeIdx)
+    {
+        minLightDistance = std::min(minLightDistance, m_rangeOutputs[rangeIdx].minLightDistance);
+    }
+    light.extendTowardLight(minLightDistance);
+    light.update(bufferIdx);
+    glm::mat4 receiverViewProjection = m_cameras[Camera::Type::NORMAL]->m_projection * m_cameras[Camera::Type::NORMAL]->m_view;
+
+    // The tree takes the objects inside of the planes of a camera as they are, the cameras are queried side by side
+    std::array<std::vector<glm::vec4>, Camera::Type::COUNT> planes;
+    for (uint32_t cameraType = 0; cameraType < Camera::Type::COUNT; ++cameraType)
+    {
+        Camera const& camera = *m_cameras[cameraType];
+        glm::mat4 viewProjection = camera.m_projection * camera.m_view;
+        // Casters whose shadow cannot reach the main camera are not drawn either
+        planes[cameraType] = cameraType == Camera::Type::LIGHT ?
+            FrustumCuller::getShadowCasterPlanes(viewProjection, receiverViewProjection, camera.m_direction, light.getLightDepthRange()) :
+            FrustumCuller::getFrustumPlanes(viewProjection);
+    }
+    m_workerPool->parallelFor(Camera::Type::COUNT, 1, [&](uint32_t first, uint32_t last, uint32_t workerIdx)
+    {
+        for (uint32_t cameraType = first; cameraType < last; ++cameraType)
+        {
+            m_visibleObjects[bufferIdx][cameraType].clear();
+            m_intersectingObjects[cameraType].clear();
+            m_bvh.query(planes[cameraType], m_visibleObjects[bufferIdx][cameraType], m_intersectingObjects[cameraType]);
+        }
+    });
+
+    // Only the objects on a plane are tested one by one, in ranges of every camera at once
+    std::array<uint32_t, Camera::Type::COUNT + 1> firstCullRanges{};
+    for (uint32_t cameraType = 0; cameraType < Camera::Type::COUNT; ++cameraType)
+    {
+        uint32_t intersectingCount = static_cast<uint32_t>(m_intersectingObjects[cameraType].size());
+        firstCullRanges[cameraType + 1] = firstCullRanges[cameraType] + (intersectingCount + CULL_GRAIN_SIZE - 1) / CULL_GRAIN_SIZE;
+    }
+    uint32_t cullRangeCount = firstCullRanges[Camera::Type::COUNT];
+    m_rangeOutputs.resize(std::max<size_t>(m_rangeOutputs.size(), cullRangeCount));
+    m_workerPool->parallelFor(cullRangeCount, 1, [&](uint32_t first, uint32_t last, uint32_t workerIdx)
+    {
+        for (uint32_t rangeIdx = first; rangeIdx < last; ++rangeIdx)
+        {
+            uint32_t cameraType = static_cast<uint32_t>(std::upper_bound(firstCullRanges.begin(), firstCullRanges.end(), rangeIdx) - firstCullRanges.begin()) - 1;
+            std::vector<uint32_t> const& intersectingObjects = m_intersectingObjects[cameraType];
+            uint32_t firstObject = (rangeIdx - firstCullRanges[cameraType]) * CULL_GRAIN_SIZE;
+            uint32_t objectCount = std::min(CULL_GRAIN_SIZE, static_cast<uint32_t>(intersectingObjects.size()) - firstObject);
+            std::vector<uint32_t>& rangeVisibleObjects = m_rangeOutputs[rangeIdx].visibleObjects;
+            rangeVisibleObjects.clear();
+            m_frustumCuller.cull(planes[cameraType], &intersectingObjects[firstObject], objectCount, rangeVisibleObjects);
+        }
+    });
+    for (uint32_t cameraType = 0; cameraType < Camera::Type::COUNT; ++cameraType)
+    {
+        std::vector<uint32_t>& visibleObjects = m_visibleObjects[bufferIdx][cameraType];
+        for (uint32_t rangeIdx = firstCullRanges[cameraType]; rangeIdx < firstCullRanges[cameraType + 1]; ++rangeIdx)
+        {
+            visibleObjects.insert(visibleObjects.end(), m_rangeOutputs[rangeIdx].visibleObjects.begin(), m_rangeOutputs[rangeIdx].visibleObjects.end());
+        }
+    }
+
+    if (m_softwareOcclusionCulling)
+    {
+        // Only occluders in the frustum can hide anything in it
+        Camera const& camera = *m_cameras[Camera::Type::NORMAL];
+        std::vector<uint32_t>& visibleObjects = m_visibleObjects[bufferIdx][Camera::Type::NORMAL];
+        m_occlusionRasterizer->begin(camera.m_projection * camera.m_view);
+        for (uint32_t entityIdx : visibleObjects)
+        {
+            SceneObject const& object = *m_objects[m_entities.m_meshes[entityIdx]];
+            if (object.m_occluder)
+            {
+                m_occlusionRasterizer->addOccluder(m_entities.m_modelMatrices[entityIdx], object.m_occluderPositions, object.m_occluderIndices);
+            }
+        }
+        m_occlusionRasterizer->rasterize(*m_workerPool);
+
+        uint32_t visibleCount = static_cast<uint32_t>(visibleObjects.size());
+        m_rangeOutputs.resize(std::max<size_t>(m_rangeOutputs.size(), (visibleCount + OCCLUSION_GRAIN_SIZE - 1) / OCCLUSION_GRAIN_SIZE));
+        m_workerPool->parallelFor(visibleCount, OCCLUSION_GRAIN_SIZE, [&](uint32_t first, uint32_t last, uint32_t workerIdx)
+        {
+            std::vector<uint32_t>& rangeVisibleObjects = m_rangeOutputs[first / OCCLUSION_GRAIN_SIZE].visibleObjects;
+            rangeVisibleObjects.clear();
+            for (uint32_t i = first; i < last; ++i)
+            {
+                uint32_t entityIdx = visibleObjects[i];
+                if (m_occlusionRasterizer->isVisible(m_entities.m_modelMatrices[entityIdx], m_entities.m_boundsMin[entityIdx], m_entities.m_boundsMax[entityIdx]))
+                {
+                    rangeVisibleObjects.emplace_back(visibleObjects[i]);
+                }
+            }
+        });
+
+        std::vector<uint32_t> unoccludedObjects;
+        for (uint32_t rangeIdx = 0; rangeIdx * OCCLUSION_GRAIN_SIZE < visibleCount; ++rangeIdx)
+        {
+            unoccludedObjects.insert(unoccludedObjects.end(), m_rangeOutputs[rangeIdx].visibleObjects.begin(), m_rangeOutputs[rangeIdx].visibleObjects.end());
+        }
+        visibleObjects = std::move(unoccludedObjects);
+    }
+    m_updateStats.cullTime = getMilliseconds(stepStart);
+}
+
+void Scene::setSoftwareOcclusionCulling(bool enabled)
+{
+    m_softwareOcclusionCulling = enabled;
 }
 
-void Scene::render(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, Camera::Type cameraType, uint32_t bufferIdx, float dt)
+bool Scene::isSoftwareOcclusionCulling() const
 {
-    m_cameras[cameraType]->bind(commandBuffer, pipelineLayout, bufferIdx);
+    return m_softwareOcclusionCulling;
+}
+
+Scene::UpdateStats const& Scene::getUpdateStats() const
+{
+    return m_updateStats;
+}
 
-    if (cameraType == Camera::Type::NORMAL)
+void Scene::cull(VkCommandBuffer commandBuffer, DrawInfo const& drawInfo, CullPhase phase, uint32_t bufferIdx)
+{
+    Camera& camera = *m_cameras[drawInfo.cameraType];
+    Buffer& drawBuffer = *m_drawBuffers[bufferIdx][drawInfo.cameraType];
+    uint32_t maxDrawCount = m_entities.getCount();
+
+    if (phase == CullPhase::EARLY)
+    {
+        // Objects outside of the frustum were dropped in update(), the rest is left to the GPU. The levels of detail
+        // depend on the camera.
+        std::vector<uint32_t> const& visibleObjects = m_visibleObjects[bufferIdx][drawInfo.cameraType];
+        std::vector<GBufferPass::DrawCommand> candidates(visibleObjects.size());
+        for (uint32_t candidateIdx = 0; candidateIdx < candidates.size(); ++candidateIdx)
+        {
+            uint32_t i = visibleObjects[candidateIdx];
+            SceneObject const& obj = *m_objects[m_entities.m_meshes[i]];
+            SceneObject::Lod const& lod = obj.m_lods[obj.selectLod(camera, m_entities.m_modelMatrices[i], drawInfo.lodBias)];
+            candidates[candidateIdx].indexed = { 0, 1, m_culledFirstIndices[i], static_cast<int32_t>(m_entities.m_baseVertices[i]), i };
+            candidates[candidateIdx].meshletOffset = lod.meshletOffset;
+            candidates[candidateIdx].meshletCount = lod.meshletCount;
+            candidates[candidateIdx].meshTasks = { (lod.meshletCount + GBufferPass::TASK_WORKGROUP_SIZE - 1) / GBufferPass::TASK_WORKGROUP_SIZE, 1, 1 };
+        }
+        uint32_t candidateCount = static_cast<uint32_t>(candidates.size());
+        Buffer& candidateBuffer = *m_candidateBuffers[bufferIdx][drawInfo.cameraType];
+        candidateBuffer.update(&candidateCount, sizeof(candidateCount));
+        candidateBuffer.update(candidates.data(), sizeof(GBufferPass::DrawCommand) * candidates.size(), CANDIDATE_OFFSET);
+
+        // Zeroed draw commands draw nothing, so the draws past the counts can be issued without the count variants
+        std::array<uint32_t, DRAW_COMMAND_OFFSET / sizeof(uint32_t)> drawHeader{ 0, 0, m_maxMeshletCount, 0, 1, m_maxMeshletCount, 0, 1 };
+        vkCmdFillBuffer(commandBuffer, drawBuffer.m_vkBuffer, DRAW_COMMAND_OFFSET, VK_WHOLE_SIZE, 0);
+        vkCmdUpdateBuffer(commandBuffer, drawBuffer.m_vkBuffer, 0, sizeof(drawHeader), drawHeader.data());
+
+        VkMemoryBarrier resetBarrier{};
+        resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &resetBarrier, 0, nullptr, 0, nullptr);
+    }
+    else
+    {
+        // The late phase tests against the depth the early phase just drew
+        drawInfo.depthPyramid->build(commandBuffer, camera.m_projection * camera.m_view, bufferIdx);
+    }
+
+    uint32_t candidateCount = static_cast<uint32_t>(m_visibleObjects[bufferIdx][drawInfo.cameraType].size());
+    m_drawCuller->cull(commandBuffer, camera, m_drawCullDescriptorSets[bufferIdx][drawInfo.cameraType], bufferIdx, drawInfo.depthPyramid,
+        phase, candidateCount, maxDrawCount, drawInfo.meshShading);
+
+    // Task shaders cull the meshlets themselves
+    if (drawInfo.meshShading)
+        return;
+
+    m_clusterCuller->cull(commandBuffer, camera, m_cullDescriptorSets[bufferIdx][drawInfo.cameraType], bufferIdx, drawBuffer.m_vkBuffer,
+        DISPATCH_OFFSET + sizeof(VkDispatchIndirectCommand) * phase, phase * maxDrawCount);
+}
+
+void Scene::render(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, DrawInfo const& drawInfo, CullPhase phase, uint32_t bufferIdx, float dt)
+{
+    Camera& camera = *m_cameras[drawInfo.cameraType];
+    camera.bind(commandBuffer, pipelineLayout, bufferIdx);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &m_objectDescriptorSets[bufferIdx], 0, nullptr);
+    m_bindlessTable->bind(commandBuffer, pipelineLayout, 2);
+
+    VkBuffer drawBuffer = m_drawBuffers[bufferIdx][drawInfo.cameraType]->m_vkBuffer;
+    if (drawInfo.meshShading)
     {
-        for (auto const& obj : m_objects)
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 3, 1, &m_meshletDescriptorSets[bufferIdx][drawInfo.cameraType], 0, nullptr);
+        drawIndirect(commandBuffer, pipelineLayout, drawBuffer, phase, offsetof(GBufferPass::DrawCommand, meshTasks), true);
+    }
+    else
+    {
+        m_geometryArena->bindVertexBuffers(commandBuffer, drawInfo.positionsOnly);
+        vkCmdBindIndexBuffer(commandBuffer, m_culledIndexBuffers[bufferIdx][drawInfo.cameraType]->m_vkBuffer, 0, VK_INDEX_TYPE_UINT32);
+        drawIndirect(commandBuffer, pipelineLayout, drawBuffer, phase, offsetof(GBufferPass::DrawCommand, indexed), false);
+    }
+}
+
+void Scene::drawIndirect(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkBuffer drawBuffer, CullPhase phase, VkDeviceSize commandOffset, bool meshTasks) const
+{
+    uint32_t maxDrawCount = m_entities.getCount();
+    uint32_t stride = sizeof(GBufferPass::DrawCommand);
+    uint32_t phaseFirstDraw = maxDrawCount * phase;
+    commandOffset += DRAW_COMMAND_OFFSET + static_cast<VkDeviceSize>(stride) * phaseFirstDraw;
+    if (m_deviceFeatures.drawIndirectCount)
+    {
+        VkDeviceSize countOffset = DRAW_COUNT_OFFSET + sizeof(uint32_t) * phase;
+        if (meshTasks)
+        {
+            // Task shaders read their draw command at the draw index from the first draw on
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_TASK_BIT_EXT, 0, sizeof(phaseFirstDraw), &phaseFirstDraw);
+            m_deviceFeatures.vkCmdDrawMeshTasksIndirectCountEXT(commandBuffer, drawBuffer, commandOffset, drawBuffer, countOffset, maxDrawCount, stride);
+        }
+        else
+        {
+            vkCmdDrawIndexedIndirectCount(commandBuffer, drawBuffer, commandOffset, drawBuffer, countOffset, maxDrawCount, stride);
+        }
+        return;
+    }
+
+    // Without multi-draw-indirect every draw command needs its own call
+    uint32_t drawsPerCall = m_deviceFeatures.multiDrawIndirect ? maxDrawCount : 1;
+    for (uint32_t firstDraw = 0; firstDraw < maxDrawCount; firstDraw += drawsPerCall)
+    {
+        VkDeviceSize offset = commandOffset + static_cast<VkDeviceSize>(stride) * firstDraw;
+        if (meshTasks)
+        {
+            uint32_t callFirstDraw = phaseFirstDraw + firstDraw;
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_TASK_BIT_EXT, 0, sizeof(callFirstDraw), &callFirstDraw);
+            m_deviceFeatures.vkCmdDrawMeshTasksIndirectEXT(commandBuffer, drawBuffer, offset, drawsPerCall, stride);
+        }
+        else
         {
-            obj->update(bufferIdx, dt);
+            vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, offset, drawsPerCall, stride);
         }
     }
-	for (auto const& obj : m_objects)
-	{
-		obj->render(commandBuffer, pipelineLayout, bufferIdx, dt);
-	}
 }
\ No newline at end of file
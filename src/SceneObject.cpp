@@ -2,70 +2,173 @@
 
 #include "Renderer.h"
 #include "Camera.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
 
 #include <chrono>
 #include <iostream>
 #include <array>
 #include <fstream>
+#include <limits>
+
+#include <glm/gtc/matrix_transform.hpp>
 
 SceneObject::SceneObject(uint32_t id, VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuffer copyCommandBuffer,
-     VkDescriptorSetAllocateInfo descSetAllocInfo) :
+     GeometryArena& geometryArena, DescriptorAllocator* descriptorAllocator, VkDescriptorSetLayout setLayout) :
     m_physicalDevice(physicalDevice)
     , m_device(device)
     , m_copyCommandBuffer(copyCommandBuffer)
-    , m_descSetAllocInfo(descSetAllocInfo)
+    , m_geometryArena(&geometryArena)
+    , m_descriptorAllocator(descriptorAllocator)
+    , m_setLayout(setLayout)
     , m_id(id)
 {
 }
 
 void SceneObject::init()
 {
-    m_vertexBuffer = std::make_unique<Buffer>(m_physicalDevice, m_device, m_copyCommandBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-        sizeof(GBufferPass::Vertex) * m_vertices.size(), m_vertices.data());
-
-    m_indexBuffer = std::make_unique<Buffer>(m_physicalDevice, m_device, m_copyCommandBuffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-        sizeof(uint16_t) * m_indices.size(), m_indices.data());
-
-    m_descriptorSets.resize(Renderer::BUFFER_COUNT);
-    VkResult result = vkAllocateDescriptorSets(m_device, &m_descSetAllocInfo, m_descriptorSets.data());
-    if (result != VK_SUCCESS) {
-        std::cout << "Failed to allocate descriptor sets" << std::endl;
-        std::terminate();
-    }
-    for (uint32_t i = 0; i < Renderer::BUFFER_COUNT; ++i)
-    {
-        m_uniformBuffers.emplace_back(std::make_unique<Buffer>(m_physicalDevice, m_device, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(GBufferPass::ModelTransforms)));
-        VkDescriptorBufferInfo uniformBufferInfo{};
-        uniformBufferInfo.buffer = m_uniformBuffers[i]->m_vkBuffer;
-        uniformBufferInfo.offset = 0;
-        uniformBufferInfo.range = sizeof(GBufferPass::ModelTransforms);
-
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = m_albedoMap->m_imageView;
-        imageInfo.sampler = m_albedoMap->m_sampler;
-
-        VkWriteDescriptorSet uniformBufferDescriptorWrite{};
-        uniformBufferDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        uniformBufferDescriptorWrite.dstSet = m_descriptorSets[i];
-        uniformBufferDescriptorWrite.dstBinding = 0;
-        uniformBufferDescriptorWrite.dstArrayElement = 0;
-        uniformBufferDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        uniformBufferDescriptorWrite.descriptorCount = 1;
-        uniformBufferDescriptorWrite.pBufferInfo = &uniformBufferInfo;
-
-        VkWriteDescriptorSet textureDescriptorWrite{};
-        textureDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        textureDescriptorWrite.dstSet = m_descriptorSets[i];
-        textureDescriptorWrite.dstBinding = 1;
-        textureDescriptorWrite.dstArrayElement = 0;
-        textureDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        textureDescriptorWrite.descriptorCount = 1;
-        textureDescriptorWrite.pImageInfo = &imageInfo;
-
-        std::array<VkWriteDescriptorSet, 2> descriptorWrites{ uniformBufferDescriptorWrite, textureDescriptorWrite };
-        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    glm::vec3 center(0.0f);
+    float extent = 1.0f;
+    if constexpr (GBufferPass::QUANTIZED_POSITIONS)
+    {
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+        for (auto const& vertex : m_vertices)
+        {
+            boundsMin = glm::min(boundsMin, vertex.position);
+            boundsMax = glm::max(boundsMax, vertex.position);
+        }
+        // Uniform scale keeps directions intact for the sky cube, which samples with its vertex positions
+        center = (boundsMin + boundsMax) * 0.5f;
+        glm::vec3 halfSize = boundsMax - center;
+        extent = glm::max(glm::max(halfSize.x, halfSize.y), glm::max(halfSize.z, 1e-6f));
+        m_dequantizeTransform = glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(extent));
+    }
+
+    std::vector<glm::vec3> positions(m_vertices.size());
+    std::vector<GBufferPass::PackedPosition> packedPositions(m_vertices.size());
+    std::vector<GBufferPass::PackedAttributes> packedAttributes(m_vertices.size());
+    for (size_t i = 0; i < m_vertices.size(); ++i)
+    {
+        positions[i] = (m_vertices[i].position - center) / extent;
+        packPosition(packedPositions[i].position, positions[i]);
+        packedAttributes[i].normal = packOctNormal(m_vertices[i].normal);
+        packedAttributes[i].uvCoord = packHalf2(m_vertices[i].uvCoord);
+    }
+
+    m_baseVertex = m_geometryArena->addVertices(m_copyCommandBuffer, packedPositions, packedAttributes);
+
+    glm::vec3 sphereCenter(0.0f);
+    for (auto const& position : positions)
+    {
+        sphereCenter += position / static_cast<float>(positions.size());
+    }
+    float sphereRadius = 0.0f;
+    for (auto const& position : positions)
+    {
+        sphereRadius = glm::max(sphereRadius, glm::length(position - sphereCenter));
+    }
+    m_boundingSphere = glm::vec4(sphereCenter, sphereRadius);
+    m_boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    m_boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (auto const& position : positions)
+    {
+        m_boundsMin = glm::min(m_boundsMin, position);
+        m_boundsMax = glm::max(m_boundsMax, position);
     }
+
+    generateLods(positions);
+    generateMeshlets(positions);
+
+    if (m_occluder)
+    {
+        Lod const& coarsestLod = m_lods.back();
+        std::vector<uint16_t> remap(positions.size(), std::numeric_limits<uint16_t>::max());
+        for (uint32_t i = 0; i < coarsestLod.indexCount; ++i)
+        {
+            uint16_t index = m_indices[coarsestLod.firstIndex + i];
+            if (remap[index] == std::numeric_limits<uint16_t>::max())
+            {
+                remap[index] = static_cast<uint16_t>(m_occluderPositions.size());
+                m_occluderPositions.emplace_back(positions[index]);
+            }
+            m_occluderIndices.emplace_back(remap[index]);
+        }
+    }
+
+    uint32_t firstIndex = m_geometryArena->addIndices(m_copyCommandBuffer, m_indices);
+    for (auto& lod : m_lods)
+    {
+        lod.firstIndex += firstIndex;
+    }
+
+    if (m_setLayout == VK_NULL_HANDLE)
+        return;
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = m_albedoMap->m_imageView;
+    imageInfo.sampler = m_albedoMap->m_sampler;
+    m_descriptorSet = m_descriptorAllocator->getSet(m_setLayout, { DescriptorAllocator::Binding::image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageInfo) });
+}
+
+void SceneObject::generateLods(std::vector<glm::vec3> const& positions)
+{
+    Lod baseLod{};
+    baseLod.indexCount = static_cast<uint32_t>(m_indices.size());
+    m_lods = { baseLod };
+
+    // Every level halves the triangle count of the previous one and is appended to the same index buffer
+    MeshSimplifier simplifier(positions, m_indices);
+    while (m_lods.size() < MAX_LOD_COUNT)
+    {
+        Lod const& previous = m_lods.back();
+        Lod lod{};
+        std::vector<uint16_t> indices = simplifier.simplify(previous.indexCount / 6 * 3, lod.error);
+        if (indices.size() > previous.indexCount * 4 / 5)
+            break;
+        lod.firstIndex = static_cast<uint32_t>(m_indices.size());
+        lod.indexCount = static_cast<uint32_t>(indices.size());
+        m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+        m_lods.emplace_back(lod);
+    }
+}
+
+void SceneObject::generateMeshlets(std::vector<glm::vec3> const& positions)
+{
+    MeshletBuilder builder(positions);
+    for (auto& lod : m_lods)
+    {
+        lod.meshletOffset = builder.build(&m_indices[lod.firstIndex], lod.indexCount);
+        lod.meshletCount = static_cast<uint32_t>(builder.getMeshlets().size()) - lod.meshletOffset;
+    }
+
+    uint32_t firstMeshlet = m_geometryArena->addMeshlets(m_copyCommandBuffer, builder.getMeshlets(), builder.getVertices(), builder.getTriangles());
+    for (auto& lod : m_lods)
+    {
+        lod.meshletOffset += firstMeshlet;
+    }
+}
+
+uint32_t SceneObject::selectLod(Camera const& camera, glm::mat4 const& model, uint32_t lodBias) const
+{
+    glm::vec3 center = model * glm::vec4(glm::vec3(m_boundingSphere), 1.0f);
+    float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+    // Size of one world unit as a fraction of the viewport height. Perspective projections scale it by the distance
+    float projectedUnit = glm::abs(camera.m_projection[1][1]) * 0.5f;
+    if (camera.m_projection[2][3] != 0.0f)
+    {
+        float distance = glm::length(center - camera.m_position) - m_boundingSphere.w * scale;
+        projectedUnit /= glm::max(distance, 0.01f);
+    }
+
+    uint32_t lod = 0;
+    while (lod + 1 < m_lods.size() && m_lods[lod + 1].error * scale * projectedUnit <= LOD_SCREEN_ERROR)
+    {
+        ++lod;
+    }
+    return glm::min(lod + lodBias, static_cast<uint32_t>(m_lods.size()) - 1);
 }
 
 SceneObject::~SceneObject()
@@ -76,6 +179,14 @@ SceneObject::~SceneObject()
     }
 }
 
+void SceneObject::releaseStagingBuffers()
+{
+    if (m_albedoMap)
+    {
+        m_albedoMap->releaseStagingBuffer();
+    }
+}
+
 uint16_t SceneObject::addVertex(uint32_t hash, GBufferPass::Vertex* pVertex)
 {
     bool bFoundInList = false;
@@ -236,14 +347,12 @@ void SceneObject::loadIndexedMesh(std::string const& filename)
 	fin.close();
 }
 
-void SceneObject::render(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bufferIdx, float dt)
+void SceneObject::render(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bufferIdx, float dt, bool positionsOnly, uint32_t lod)
 {
+    m_geometryArena->bindVertexBuffers(commandBuffer, positionsOnly);
+    m_geometryArena->bindIndexBuffer(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GBufferPass::ModelTransforms), &m_modelTransforms);
 
-    VkBuffer vertexBuffers[] = { m_vertexBuffer->m_vkBuffer };
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->m_vkBuffer, 0, VK_INDEX_TYPE_UINT16);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &m_descriptorSets[bufferIdx], 0, nullptr);
-
-    vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_indices.size()), 1, 0, 0, 0);
+    vkCmdDrawIndexed(commandBuffer, m_lods[lod].indexCount, 1, m_lods[lod].firstIndex, static_cast<int32_t>(m_baseVertex), 0);
 }
\ No newline at end of file
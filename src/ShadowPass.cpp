@@ -1,16 +1,18 @@
 #include "ShadowPass.h"
 
 #include "Texture.h"
+#include "BindlessTable.h"
 #include "GBufferPass.h"
 #include "Scene.h"
 
 #include <iostream>
 #include <array>
 
-ShadowPass::ShadowPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadPool* threadPool, std::vector<Texture*>& depthTargets) :
+ShadowPass::ShadowPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadPool* threadPool, std::vector<Texture*>& depthTargets, DeviceFeatures const& deviceFeatures) :
     RenderPass::RenderPass(device, threadPool, 0)
 {
     m_hasDepthAttachment = true;
+    m_meshShading = deviceFeatures.meshShader && GBufferPass::QUANTIZED_POSITIONS;
 
     std::array<VkAttachmentDescription, 1> attachmentDescriptions;
 
@@ -77,43 +79,30 @@ ShadowPass::ShadowPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderT
     m_targetWidth = depthTargets[0]->m_width;
     m_targetHeight = depthTargets[0]->m_height;
 
-    auto vertexShaderSrc = readFile("shaders/shadow_vert.spv");
-
-    VkShaderModule vertexShader = createVkShader(vertexShaderSrc);
-
-    VkPipelineShaderStageCreateInfo vertexShaderStageInfo{};
-    vertexShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertexShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertexShaderStageInfo.module = vertexShader;
-    vertexShaderStageInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderStageInfo };
-
-    VkVertexInputBindingDescription bindingDescription{};
-    bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(GBufferPass::Vertex);
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-    attributeDescriptions[0].binding = 0;
-    attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[0].offset = offsetof(GBufferPass::Vertex, position);
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset = offsetof(GBufferPass::Vertex, normal);
-    attributeDescriptions[2].binding = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset = offsetof(GBufferPass::Vertex, uvCoord);
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    auto geometryShaderSrc = readFile(m_meshShading ? "shaders/shadow_mesh.spv" : "shaders/shadow_vert.spv");
+
+    VkShaderModule geometryShader = createVkShader(geometryShaderSrc);
+    VkShaderModule taskShader = m_meshShading ? createVkShader(readFile("shaders/meshlet_task.spv")) : VK_NULL_HANDLE;
+
+    VkPipelineShaderStageCreateInfo taskShaderStageInfo{};
+    taskShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    taskShaderStageInfo.stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+    taskShaderStageInfo.module = taskShader;
+    taskShaderStageInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo geometryShaderStageInfo{};
+    geometryShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    geometryShaderStageInfo.stage = m_meshShading ? VK_SHADER_STAGE_MESH_BIT_EXT : VK_SHADER_STAGE_VERTEX_BIT;
+    geometryShaderStageInfo.module = geometryShader;
+    geometryShaderStageInfo.pName = "main";
+
+    std::vector<VkPipelineShaderStageCreateInfo> shaderStages{ geometryShaderStageInfo };
+    if (m_meshShading)
+    {
+        shaderStages.insert(shaderStages.begin(), taskShaderStageInfo);
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = GBufferPass::PositionVertexInput::createInfo();
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -158,22 +147,17 @@ ShadowPass::ShadowPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderT
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
+    VkShaderStageFlags meshStages = m_meshShading ? VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT : 0;
+
     VkDescriptorSetLayoutBinding modelTransformLayoutBinding{};
     modelTransformLayoutBinding.binding = 0;
-    modelTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    modelTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     modelTransformLayoutBinding.descriptorCount = 1;
-    modelTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-    VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-    samplerLayoutBinding.binding = 1;
-    samplerLayoutBinding.descriptorCount = 1;
-    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerLayoutBinding.pImmutableSamplers = nullptr;
-    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    modelTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | meshStages;
 
     VkDescriptorSetLayoutCreateInfo modelDescSetLayoutInfo{};
     modelDescSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    std::array<VkDescriptorSetLayoutBinding, 2> modelBindings = { modelTransformLayoutBinding, samplerLayoutBinding };
+    std::array<VkDescriptorSetLayoutBinding, 1> modelBindings = { modelTransformLayoutBinding };
     modelDescSetLayoutInfo.bindingCount = static_cast<uint32_t>(modelBindings.size());
     modelDescSetLayoutInfo.pBindings = modelBindings.data();
 
@@ -186,9 +170,10 @@ ShadowPass::ShadowPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderT
 
     VkDescriptorSetLayoutBinding cameraTransformLayoutBinding{};
     cameraTransformLayoutBinding.binding = 0;
-    cameraTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    cameraTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     cameraTransformLayoutBinding.descriptorCount = 1;
-    cameraTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    // The camera sets are bound with the layouts of every pass and the cluster culling, so they must all match
+    cameraTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_ALL;
 
     VkDescriptorSetLayoutCreateInfo cameraDescSetLayoutInfo{};
     cameraDescSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -203,11 +188,47 @@ ShadowPass::ShadowPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderT
         std::terminate();
     }
 
+    // Textures and materials of the whole scene
+    m_bindlessSetLayout = BindlessTable::createSetLayout(device);
+
+    // Meshlets, meshlet vertices, meshlet triangles, positions, attributes and draw commands of the mesh shader path
+    std::array<VkDescriptorSetLayoutBinding, 6> meshletBindings{};
+    for (uint32_t i = 0; i < meshletBindings.size(); ++i)
+    {
+        meshletBindings[i].binding = i;
+        meshletBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        meshletBindings[i].descriptorCount = 1;
+        meshletBindings[i].stageFlags = meshStages;
+    }
+
+    if (m_meshShading)
+    {
+        VkDescriptorSetLayoutCreateInfo meshletDescSetLayoutInfo{};
+        meshletDescSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        meshletDescSetLayoutInfo.bindingCount = static_cast<uint32_t>(meshletBindings.size());
+        meshletDescSetLayoutInfo.pBindings = meshletBindings.data();
+
+        result = vkCreateDescriptorSetLayout(device, &meshletDescSetLayoutInfo, nullptr, &m_meshletSetLayout);
+        if (result != VK_SUCCESS)
+        {
+            std::cout << "Failed to create meshlet descriptor set layout!" << std::endl;
+            std::terminate();
+        }
+    }
+
+    // First draw of the culling phase for the task shader
+    VkPushConstantRange taskPushConstantRange{};
+    taskPushConstantRange.stageFlags = VK_SHADER_STAGE_TASK_BIT_EXT;
+    taskPushConstantRange.offset = 0;
+    taskPushConstantRange.size = sizeof(uint32_t);
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    std::array<VkDescriptorSetLayout, 2> descSetLayouts{ m_modelSetLayout, m_cameraSetLayout };
-    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descSetLayouts.size());
+    std::array<VkDescriptorSetLayout, 4> descSetLayouts{ m_modelSetLayout, m_cameraSetLayout, m_bindlessSetLayout, m_meshletSetLayout };
+    pipelineLayoutInfo.setLayoutCount = m_meshShading ? 4 : 3;
     pipelineLayoutInfo.pSetLayouts = descSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = m_meshShading ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = &taskPushConstantRange;
 
     result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
     if (result != VK_SUCCESS)
@@ -226,10 +247,10 @@ ShadowPass::ShadowPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderT
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 1;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = m_meshShading ? nullptr : &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = m_meshShading ? nullptr : &inputAssembly;
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
@@ -249,12 +270,20 @@ ShadowPass::ShadowPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderT
         std::terminate();
     }
 
-    vkDestroyShaderModule(device, vertexShader, nullptr);
+    vkDestroyShaderModule(device, geometryShader, nullptr);
+    if (taskShader != VK_NULL_HANDLE)
+    {
+        vkDestroyShaderModule(device, taskShader, nullptr);
+    }
 }
 
 void ShadowPass::renderImpl(Scene* scene, VkCommandBuffer commandBuffer, uint32_t bufferIdx, float dt)
 {
+    // Casters were culled against the light and the receivers in Scene::update(), the GPU frustum culls them in a single phase
+    Scene::DrawInfo drawInfo{ Camera::Type::LIGHT, true, LOD_BIAS, m_meshShading, nullptr };
+    scene->cull(commandBuffer, drawInfo, Scene::CullPhase::EARLY, bufferIdx);
+
     begin(commandBuffer);
-    scene->render(commandBuffer, m_pipelineLayout, Camera::Type::LIGHT, bufferIdx, dt);
+    scene->render(commandBuffer, m_pipelineLayout, drawInfo, Scene::CullPhase::EARLY, bufferIdx, dt);
     end(commandBuffer);
 }
\ No newline at end of file
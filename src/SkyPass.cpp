@@ -4,7 +4,8 @@
 #include "Camera.h"
 #include "Scene.h"
 
-SkyPass::SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadPool* threadPool, std::vector<Texture*>& colorTargets, VkQueue queue, uint32_t queueFamilyIdx) :
+SkyPass::SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, RenderThreadPool* threadPool, DescriptorAllocator* descriptorAllocator, std::vector<Texture*>& colorTargets,
+    VkQueue queue, uint32_t queueFamilyIdx, DeviceFeatures const& deviceFeatures) :
 	RenderPass::RenderPass(device, threadPool, 1)
 {
     m_hasDepthAttachment = true;
@@ -94,31 +95,7 @@ SkyPass::SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadP
 
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderStageInfo, fragmentShaderStageInfo };
 
-    VkVertexInputBindingDescription bindingDescription{};
-    bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(GBufferPass::Vertex);
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-    attributeDescriptions[0].binding = 0;
-    attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[0].offset = offsetof(GBufferPass::Vertex, position);
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset = offsetof(GBufferPass::Vertex, normal);
-    attributeDescriptions[2].binding = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset = offsetof(GBufferPass::Vertex, uvCoord);
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = GBufferPass::PositionVertexInput::createInfo();
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -171,14 +148,8 @@ SkyPass::SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadP
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
-    VkDescriptorSetLayoutBinding modelTransformLayoutBinding{};
-    modelTransformLayoutBinding.binding = 0;
-    modelTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    modelTransformLayoutBinding.descriptorCount = 1;
-    modelTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
     VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-    samplerLayoutBinding.binding = 1;
+    samplerLayoutBinding.binding = 0;
     samplerLayoutBinding.descriptorCount = 1;
     samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     samplerLayoutBinding.pImmutableSamplers = nullptr;
@@ -186,7 +157,7 @@ SkyPass::SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadP
 
     VkDescriptorSetLayoutCreateInfo modelDescSetLayoutInfo{};
     modelDescSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    std::array<VkDescriptorSetLayoutBinding, 2> modelBindings = { modelTransformLayoutBinding, samplerLayoutBinding };
+    std::array<VkDescriptorSetLayoutBinding, 1> modelBindings = { samplerLayoutBinding };
     modelDescSetLayoutInfo.bindingCount = static_cast<uint32_t>(modelBindings.size());
     modelDescSetLayoutInfo.pBindings = modelBindings.data();
 
@@ -199,9 +170,9 @@ SkyPass::SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadP
 
     VkDescriptorSetLayoutBinding cameraTransformLayoutBinding{};
     cameraTransformLayoutBinding.binding = 0;
-    cameraTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    cameraTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     cameraTransformLayoutBinding.descriptorCount = 1;
-    cameraTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    cameraTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_ALL;
 
     VkDescriptorSetLayoutCreateInfo cameraDescSetLayoutInfo{};
     cameraDescSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -221,6 +192,13 @@ SkyPass::SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadP
     std::array<VkDescriptorSetLayout, 2> descSetLayouts{ m_modelSetLayout, m_cameraSetLayout };
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = descSetLayouts.data();
+    // The model transform of the cube is pushed with its draw
+    VkPushConstantRange modelPushConstantRange{};
+    modelPushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    modelPushConstantRange.offset = 0;
+    modelPushConstantRange.size = sizeof(GBufferPass::ModelTransforms);
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &modelPushConstantRange;
 
     result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
     if (result != VK_SUCCESS)
@@ -265,41 +243,6 @@ SkyPass::SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadP
     vkDestroyShaderModule(device, fragmentShader, nullptr);
     vkDestroyShaderModule(device, vertexShader, nullptr);
 
-    VkDescriptorPoolSize uniformBufferPoolSize{};
-    uniformBufferPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uniformBufferPoolSize.descriptorCount = 2 * static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-    VkDescriptorPoolSize texturePoolSize{};
-    texturePoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    texturePoolSize.descriptorCount = static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-
-    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
-    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    std::array<VkDescriptorPoolSize, 2> poolSizes{ uniformBufferPoolSize, texturePoolSize };
-    descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-    descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
-    descriptorPoolCreateInfo.maxSets = 2 * static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-
-    result = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool);
-    if (result != VK_SUCCESS)
-    {
-        std::cout << "Failed to create descriptor pool" << std::endl;
-        std::terminate();
-    }
-
-    std::vector<VkDescriptorSetLayout> modelLayouts(Renderer::BUFFER_COUNT, m_modelSetLayout);
-    VkDescriptorSetAllocateInfo descSetAllocInfo{};
-    descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descSetAllocInfo.descriptorPool = m_descriptorPool;
-    descSetAllocInfo.descriptorSetCount = static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-    descSetAllocInfo.pSetLayouts = modelLayouts.data();
-
-    std::vector<VkDescriptorSetLayout> cameraLayouts(Renderer::BUFFER_COUNT, m_cameraSetLayout);
-    VkDescriptorSetAllocateInfo cameraDescSetAllocInfo{};
-    cameraDescSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    cameraDescSetAllocInfo.descriptorPool = m_descriptorPool;
-    cameraDescSetAllocInfo.descriptorSetCount = static_cast<uint32_t>(Renderer::BUFFER_COUNT);
-    cameraDescSetAllocInfo.pSetLayouts = cameraLayouts.data();
-
     VkCommandPoolCreateInfo commanPoolCreateInfo{};
     commanPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     commanPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
@@ -326,7 +269,9 @@ SkyPass::SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadP
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     vkBeginCommandBuffer(copyCommandBuffer, &beginInfo);
 
-    m_environmentCube = std::make_unique<EnvironmentCube>(-1, physicalDevice, device, copyCommandBuffer, descSetAllocInfo);
+    // Just big enough for the cube and its levels of detail
+    m_geometryArena = std::make_unique<GeometryArena>(device, allocator, 64, 256, 8);
+    m_environmentCube = std::make_unique<EnvironmentCube>(-1, physicalDevice, device, allocator, copyCommandBuffer, *m_geometryArena, descriptorAllocator, m_modelSetLayout, deviceFeatures);
 
     vkEndCommandBuffer(copyCommandBuffer);
 
@@ -335,8 +280,16 @@ SkyPass::SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadP
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &copyCommandBuffer;
 
-    vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(queue);
+    VkFenceCreateInfo fenceCreateInfo{};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence uploadFence{ VK_NULL_HANDLE };
+    vkCreateFence(device, &fenceCreateInfo, nullptr, &uploadFence);
+    vkQueueSubmit(queue, 1, &submitInfo, uploadFence);
+    vkWaitForFences(device, 1, &uploadFence, VK_TRUE, UINT64_MAX);
+    vkDestroyFence(device, uploadFence, nullptr);
+
+    m_geometryArena->releaseStagingBuffers();
+    m_environmentCube->releaseStagingBuffers();
 
     vkFreeCommandBuffers(device, copyCommandPool, 1, &copyCommandBuffer);
     vkDestroyCommandPool(device, copyCommandPool, nullptr);
@@ -345,14 +298,13 @@ SkyPass::SkyPass(VkPhysicalDevice physicalDevice, VkDevice device, RenderThreadP
 SkyPass::~SkyPass()
 {
     m_environmentCube.reset();
-    vkDestroyDescriptorPool(m_vkDevice, m_descriptorPool, nullptr);
+    m_geometryArena.reset();
 }
 
 void SkyPass::renderImpl(Scene* scene, VkCommandBuffer commandBuffer, uint32_t bufferIdx, float dt)
 {
     begin(commandBuffer);
     scene->m_cameras[Camera::Type::NORMAL]->bind(commandBuffer, m_pipelineLayout, bufferIdx);
-    m_environmentCube->update(bufferIdx, dt);
-	m_environmentCube->render(commandBuffer, m_pipelineLayout, bufferIdx, dt);
+	m_environmentCube->render(commandBuffer, m_pipelineLayout, bufferIdx, dt, true);
     end(commandBuffer);
 }
\ No newline at end of file
@@ -1,104 +1,121 @@
 #include "Texture.h"
 
 #include "RenderPass.h"
+#include "MipChain.h"
+#include "Ktx2File.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #include <iostream>
+#include <algorithm>
+#include <iterator>
 
-Texture::Texture(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuffer copyCommandBuffer, std::vector<std::string> const& filenames) :
-	m_vkDevice(device)
+// The texture cooker writes the compressed file of a source image next to it
+static std::string getCookedFilename(std::string const& filename)
 {
-	int width{ 0 };
-	int height{ 0 }; 
-	int texChannels{ 0 };
-	VkDeviceSize size{ 0 };
+	return filename.substr(0, filename.find_last_of('.')) + ".ktx2";
+}
 
-	struct ImageData
-	{
-		stbi_uc* data;
-		size_t size;
-	};
-	std::vector<ImageData> imageDatas;
-	imageDatas.reserve(filenames.size());
-	for (auto& filename : filenames)
+Texture::Texture(VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, VkCommandBuffer copyCommandBuffer, std::vector<std::string> const& filenames,
+	DeviceFeatures const& deviceFeatures) :
+	m_vkDevice(device)
+	, m_allocator(allocator)
+{
+	// Pixels of every level of every layer. Cooked files have all of their levels, decoded images only the first one
+	// until the rest are blitted or generated.
+	std::vector<std::vector<std::vector<uint8_t>>> layerLevels;
+	layerLevels.reserve(filenames.size());
+	if (deviceFeatures.textureCompressionBC)
 	{
-		stbi_uc* data = stbi_load(filename.c_str(), &width, &height, &texChannels, STBI_rgb_alpha);
-		if (!data)
+		for (auto& filename : filenames)
 		{
-			std::cout << "Failed to load image " << filename << std::endl;
-			std::terminate();
+			Ktx2File file;
+			if (!Ktx2File::load(getCookedFilename(filename), file))
+				break;
+			if (!layerLevels.empty() && (file.format != m_format || file.width != m_width || file.height != m_height || file.levels.size() != m_mipLevelCount))
+			{
+				std::cout << "Failed to load texture " << filename << ", its cooked layers differ" << std::endl;
+				std::terminate();
+			}
+			m_format = file.format;
+			m_width = file.width;
+			m_height = file.height;
+			m_mipLevelCount = static_cast<uint32_t>(file.levels.size());
+			layerLevels.emplace_back(std::move(file.levels));
 		}
-		ImageData imageData{ data, static_cast<size_t>(width) * height * 4 };
-		imageDatas.emplace_back(imageData);
-		size += static_cast<VkDeviceSize>(imageData.size);
-	}
-	m_layerCount = static_cast<uint32_t>(imageDatas.size());
-
-	// The staging buffer
-	VkBufferCreateInfo stagingBufferInfo{};
-	stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	stagingBufferInfo.size = size;
-	stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	stagingBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	VkResult result = vkCreateBuffer(m_vkDevice, &stagingBufferInfo, nullptr, &m_stagingBuffer);
-	if (result != VK_SUCCESS)
-	{
-		std::cout << "Failed to create staging buffer" << std::endl;
-		std::terminate();
-	}
-	VkMemoryRequirements stagingMemRequirements;
-	vkGetBufferMemoryRequirements(m_vkDevice, m_stagingBuffer, &stagingMemRequirements);
-	VkPhysicalDeviceMemoryProperties stagingMemProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &stagingMemProperties);
-	VkMemoryPropertyFlags stagingProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-	uint32_t stagingMemTypeIdx = 0;
-	for (; stagingMemTypeIdx < stagingMemProperties.memoryTypeCount; stagingMemTypeIdx++)
-	{
-		if ((stagingMemRequirements.memoryTypeBits & (1 << stagingMemTypeIdx)) && (stagingMemProperties.memoryTypes[stagingMemTypeIdx].propertyFlags & stagingProperties) == stagingProperties) {
-			break;
+		// The source images are decoded unless every layer has been cooked
+		if (layerLevels.size() != filenames.size())
+		{
+			layerLevels.clear();
 		}
 	}
-	VkMemoryAllocateInfo stagingMemAllocInfo{};
-	stagingMemAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	stagingMemAllocInfo.allocationSize = stagingMemRequirements.size;
-	stagingMemAllocInfo.memoryTypeIndex = stagingMemTypeIdx;
-	result = vkAllocateMemory(m_vkDevice, &stagingMemAllocInfo, nullptr, &m_stagingMemory);
-	if (result != VK_SUCCESS)
+	if (layerLevels.empty())
 	{
-		std::cout << "Failed to allocate staging buffer memory" << std::endl;
-		std::terminate();
+		m_format = VK_FORMAT_R8G8B8A8_SRGB;
+		for (auto& filename : filenames)
+		{
+			int width{ 0 };
+			int height{ 0 };
+			int texChannels{ 0 };
+			stbi_uc* data = stbi_load(filename.c_str(), &width, &height, &texChannels, STBI_rgb_alpha);
+			if (!data)
+			{
+				std::cout << "Failed to load image " << filename << std::endl;
+				std::terminate();
+			}
+			m_width = static_cast<uint32_t>(width);
+			m_height = static_cast<uint32_t>(height);
+			layerLevels.emplace_back();
+			layerLevels.back().emplace_back(data, data + static_cast<size_t>(width) * height * 4);
+			stbi_image_free(data);
+		}
+		m_mipLevelCount = MipChain::getLevelCount(m_width, m_height);
 	}
-	vkBindBufferMemory(m_vkDevice, m_stagingBuffer, m_stagingMemory, 0);
-	void* mappedData{ nullptr };
-	vkMapMemory(m_vkDevice, m_stagingMemory, 0, stagingBufferInfo.size, 0, &mappedData);
-	size_t offset{ 0 };
-	for (auto& imageData : imageDatas)
+	m_layerCount = static_cast<uint32_t>(layerLevels.size());
+	auto getMipExtent = [this](uint32_t level)
 	{
-		memcpy(static_cast<uint8_t*>(mappedData) + offset, imageData.data, imageData.size);
-		offset += imageData.size;
-		stbi_image_free(imageData.data);
-	}
-	vkUnmapMemory(m_vkDevice, m_stagingMemory);
+		return VkExtent3D{ std::max(m_width >> level, 1u), std::max(m_height >> level, 1u), 1 };
+	};
 
 	// The image
 	VkImageCreateInfo imageCreateInfo{};
 	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageCreateInfo.extent.width = width;
-	imageCreateInfo.extent.height = height;
+	imageCreateInfo.extent.width = m_width;
+	imageCreateInfo.extent.height = m_height;
 	imageCreateInfo.extent.depth = 1;
-	imageCreateInfo.mipLevels = 1;
+	imageCreateInfo.mipLevels = m_mipLevelCount;
 	imageCreateInfo.arrayLayers = m_layerCount;
-	imageCreateInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+	imageCreateInfo.format = m_format;
 	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	imageCreateInfo.flags = m_layerCount == CUBE_LAYER_COUNT ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
-	result = vkCreateImage(m_vkDevice, &imageCreateInfo, nullptr, &m_image);
+	bool hostImageCopy = deviceFeatures.hostImageCopy && isHostImageCopyOptimal(physicalDevice, imageCreateInfo);
+	if (hostImageCopy)
+	{
+		imageCreateInfo.usage = VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	}
+	// Blits between sRGB images filter in linear space. Host copies have no command buffer to blit with.
+	uint32_t loadedLevelCount = static_cast<uint32_t>(layerLevels[0].size());
+	bool blitMips = loadedLevelCount < m_mipLevelCount && !hostImageCopy && isLinearBlitSupported(physicalDevice, m_format);
+	VkDeviceSize size{ 0 };
+	for (auto& levels : layerLevels)
+	{
+		if (loadedLevelCount < m_mipLevelCount && !blitMips)
+		{
+			std::vector<std::vector<uint8_t>> mips = MipChain::generate(levels[0].data(), m_width, m_height, m_mipLevelCount, MipChain::Content::COLOR);
+			std::move(mips.begin(), mips.end(), std::back_inserter(levels));
+		}
+		for (auto& level : levels)
+		{
+			size += static_cast<VkDeviceSize>(level.size());
+		}
+	}
+	VkResult result = vkCreateImage(m_vkDevice, &imageCreateInfo, nullptr, &m_image);
 	if (result != VK_SUCCESS)
 	{
 		std::cout << "Failed to create image" << std::endl;
@@ -106,50 +123,137 @@ Texture::Texture(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuff
 	}
 	VkMemoryRequirements imageMemRequirements;
 	vkGetImageMemoryRequirements(m_vkDevice, m_image, &imageMemRequirements);
-	VkPhysicalDeviceMemoryProperties imageMemProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &imageMemProperties);
-	VkMemoryPropertyFlags imageProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	uint32_t imageMemTypeIdx = 0;
-	for (; imageMemTypeIdx < imageMemProperties.memoryTypeCount; imageMemTypeIdx++)
+	m_allocation = m_allocator->allocate(imageMemRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryAllocator::Pool::OPTIMAL, MemoryAllocator::Category::TEXTURE);
+	vkBindImageMemory(m_vkDevice, m_image, m_allocation.memory, m_allocation.offset);
+
+	if (hostImageCopy)
 	{
-		if ((imageMemRequirements.memoryTypeBits & (1 << imageMemTypeIdx)) && (imageMemProperties.memoryTypes[imageMemTypeIdx].propertyFlags & imageProperties) == imageProperties) {
-			break;
+		// The CPU lays the decoded pixels out in the image on this thread, the image is ready to sample when the copy returns
+		VkHostImageLayoutTransitionInfoEXT transition{};
+		transition.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT;
+		transition.image = m_image;
+		transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		transition.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_mipLevelCount, 0, m_layerCount };
+		result = deviceFeatures.vkTransitionImageLayoutEXT(m_vkDevice, 1, &transition);
+		if (result != VK_SUCCESS)
+		{
+			std::cout << "Failed to transition image layout on the host" << std::endl;
+			std::terminate();
+		}
+
+		std::vector<VkMemoryToImageCopyEXT> regions;
+		regions.reserve(m_layerCount * m_mipLevelCount);
+		for (uint32_t layer = 0; layer < m_layerCount; ++layer)
+		{
+			for (uint32_t level = 0; level < m_mipLevelCount; ++level)
+			{
+				VkMemoryToImageCopyEXT region{};
+				region.sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+				region.pHostPointer = layerLevels[layer][level].data();
+				region.memoryRowLength = 0;
+				region.memoryImageHeight = 0;
+				region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, layer, 1 };
+				region.imageOffset = { 0, 0, 0 };
+				region.imageExtent = getMipExtent(level);
+				regions.emplace_back(region);
+			}
+		}
+		VkCopyMemoryToImageInfoEXT copyInfo{};
+		copyInfo.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+		copyInfo.dstImage = m_image;
+		copyInfo.dstImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		copyInfo.regionCount = static_cast<uint32_t>(regions.size());
+		copyInfo.pRegions = regions.data();
+		result = deviceFeatures.vkCopyMemoryToImageEXT(m_vkDevice, &copyInfo);
+		if (result != VK_SUCCESS)
+		{
+			std::cout << "Failed to copy image from host memory" << std::endl;
+			std::terminate();
 		}
 	}
-	VkMemoryAllocateInfo imageAllocInfo{};
-	imageAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	imageAllocInfo.allocationSize = imageMemRequirements.size;
-	imageAllocInfo.memoryTypeIndex = imageProperties;
-	result = vkAllocateMemory(m_vkDevice, &imageAllocInfo, nullptr, &m_deviceMemory);
-	if (result != VK_SUCCESS)
+	else
 	{
-		std::cout << "Failed to allocate texture memory" << std::endl;
-		std::terminate();
-	}
-	vkBindImageMemory(m_vkDevice, m_image, m_deviceMemory, 0);
+		// The staging buffer
+		VkBufferCreateInfo stagingBufferInfo{};
+		stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		stagingBufferInfo.size = size;
+		stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		stagingBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		result = vkCreateBuffer(m_vkDevice, &stagingBufferInfo, nullptr, &m_stagingBuffer);
+		if (result != VK_SUCCESS)
+		{
+			std::cout << "Failed to create staging buffer" << std::endl;
+			std::terminate();
+		}
+		VkMemoryRequirements stagingMemRequirements;
+		vkGetBufferMemoryRequirements(m_vkDevice, m_stagingBuffer, &stagingMemRequirements);
+		m_stagingAllocation = m_allocator->allocate(stagingMemRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryAllocator::Pool::LINEAR,
+			MemoryAllocator::Category::STAGING);
+		vkBindBufferMemory(m_vkDevice, m_stagingBuffer, m_stagingAllocation.memory, m_stagingAllocation.offset);
+		void* mappedData = m_stagingAllocation.mappedData;
+		size_t offset{ 0 };
+		std::vector<VkBufferImageCopy> regions;
+		auto addRegion = [&](uint8_t const* data, size_t dataSize, uint32_t layer, uint32_t level)
+		{
+			memcpy(static_cast<uint8_t*>(mappedData) + offset, data, dataSize);
+			VkBufferImageCopy region{};
+			region.bufferOffset = offset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = level;
+			region.imageSubresource.baseArrayLayer = layer;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = getMipExtent(level);
+			regions.emplace_back(region);
+			offset += dataSize;
+		};
+		for (uint32_t layer = 0; layer < m_layerCount; ++layer)
+		{
+			for (uint32_t level = 0; level < layerLevels[layer].size(); ++level)
+			{
+				addRegion(layerLevels[layer][level].data(), layerLevels[layer][level].size(), layer, level);
+			}
+		}
 
-	addBarrier(copyCommandBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = m_layerCount;
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
-	vkCmdCopyBufferToImage(copyCommandBuffer, m_stagingBuffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-	addBarrier(copyCommandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		addBarrier(copyCommandBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, m_mipLevelCount);
+		vkCmdCopyBufferToImage(copyCommandBuffer, m_stagingBuffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()),
+			regions.data());
+		if (blitMips)
+		{
+			// Every level is filtered down from the one above it, which is done with once it is blitted
+			for (uint32_t level = 1; level < m_mipLevelCount; ++level)
+			{
+				addBarrier(copyCommandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, level - 1);
+				VkExtent3D srcExtent = getMipExtent(level - 1);
+				VkExtent3D dstExtent = getMipExtent(level);
+				VkImageBlit blit{};
+				blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, m_layerCount };
+				blit.srcOffsets[1] = { static_cast<int32_t>(srcExtent.width), static_cast<int32_t>(srcExtent.height), 1 };
+				blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, m_layerCount };
+				blit.dstOffsets[1] = { static_cast<int32_t>(dstExtent.width), static_cast<int32_t>(dstExtent.height), 1 };
+				vkCmdBlitImage(copyCommandBuffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+					VK_FILTER_LINEAR);
+				addBarrier(copyCommandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, level - 1);
+			}
+			addBarrier(copyCommandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_mipLevelCount - 1);
+		}
+		else
+		{
+			addBarrier(copyCommandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, m_mipLevelCount);
+		}
+	}
 
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.image = m_image;
 	viewInfo.viewType = m_layerCount == CUBE_LAYER_COUNT ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D;
-	viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+	viewInfo.format = m_format;
 	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.levelCount = m_mipLevelCount;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
 	viewInfo.subresourceRange.layerCount = m_layerCount;
 	result = vkCreateImageView(m_vkDevice, &viewInfo, nullptr, &m_imageView);
@@ -175,6 +279,8 @@ Texture::Texture(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuff
 	samplerCreateInfo.compareEnable = VK_FALSE;
 	samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
 	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerCreateInfo.minLod = 0.0f;
+	samplerCreateInfo.maxLod = static_cast<float>(m_mipLevelCount);
 	result = vkCreateSampler(m_vkDevice, &samplerCreateInfo, nullptr, &m_sampler);
 	if (result != VK_SUCCESS)
 	{
@@ -183,10 +289,11 @@ Texture::Texture(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandBuff
 	}
 }
 
-Texture::Texture(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage) :
+Texture::Texture(VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage) :
 	m_width(width)
 	, m_height(height)
 	, m_vkDevice(device)
+	, m_allocator(allocator)
 	, m_format(format)
 {
 	VkImageCreateInfo imageCreateInfo{};
@@ -211,27 +318,9 @@ Texture::Texture(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t widt
 	}
 	VkMemoryRequirements imageMemRequirements;
 	vkGetImageMemoryRequirements(m_vkDevice, m_image, &imageMemRequirements);
-	VkPhysicalDeviceMemoryProperties imageMemProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &imageMemProperties);
-	VkMemoryPropertyFlags imageProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	uint32_t imageMemTypeIdx = 0;
-	for (; imageMemTypeIdx < imageMemProperties.memoryTypeCount; imageMemTypeIdx++)
-	{
-		if ((imageMemRequirements.memoryTypeBits & (1 << imageMemTypeIdx)) && (imageMemProperties.memoryTypes[imageMemTypeIdx].propertyFlags & imageProperties) == imageProperties) {
-			break;
-		}
-	}
-	VkMemoryAllocateInfo imageAllocInfo{};
-	imageAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	imageAllocInfo.allocationSize = imageMemRequirements.size;
-	imageAllocInfo.memoryTypeIndex = imageProperties;
-	result = vkAllocateMemory(m_vkDevice, &imageAllocInfo, nullptr, &m_deviceMemory);
-	if (result != VK_SUCCESS)
-	{
-		std::cout << "Failed to allocate texture memory" << std::endl;
-		std::terminate();
-	}
-	vkBindImageMemory(m_vkDevice, m_image, m_deviceMemory, 0);
+	m_allocation = m_allocator->allocate(imageMemRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryAllocator::Pool::OPTIMAL,
+		MemoryAllocator::Category::RENDER_TARGET);
+	vkBindImageMemory(m_vkDevice, m_image, m_allocation.memory, m_allocation.offset);
 
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -312,15 +401,11 @@ Texture::~Texture()
 	{
 		vkDestroySampler(m_vkDevice, m_sampler, nullptr);
 	}
-	if (m_stagingBuffer != VK_NULL_HANDLE)
-	{
-		vkDestroyBuffer(m_vkDevice, m_stagingBuffer, nullptr);
-		vkFreeMemory(m_vkDevice, m_stagingMemory, nullptr);
-	}
-	if (m_deviceMemory != VK_NULL_HANDLE)
+	releaseStagingBuffer();
+	if (m_allocation.memory != VK_NULL_HANDLE)
 	{
 		vkDestroyImage(m_vkDevice, m_image, nullptr);
-		vkFreeMemory(m_vkDevice, m_deviceMemory, nullptr);
+		m_allocator->free(m_allocation);
 	}
 	if (m_imageView != VK_NULL_HANDLE)
 	{
@@ -329,7 +414,45 @@ Texture::~Texture()
 	}
 }
 
-void Texture::addBarrier(VkCommandBuffer commandBuffer, VkImageLayout prevLayout, VkImageLayout nextLayout)
+void Texture::releaseStagingBuffer()
+{
+	if (m_stagingBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(m_vkDevice, m_stagingBuffer, nullptr);
+		m_allocator->free(m_stagingAllocation);
+		m_stagingBuffer = VK_NULL_HANDLE;
+	}
+}
+
+bool Texture::isHostImageCopyOptimal(VkPhysicalDevice physicalDevice, VkImageCreateInfo const& imageCreateInfo)
+{
+	// Host copies can make the layout of the image slower for the GPU to sample, the staging copy is kept for those
+	VkHostImageCopyDevicePerformanceQueryEXT performanceQuery{};
+	performanceQuery.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_COPY_DEVICE_PERFORMANCE_QUERY_EXT;
+	VkImageFormatProperties2 formatProperties{};
+	formatProperties.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2;
+	formatProperties.pNext = &performanceQuery;
+
+	VkPhysicalDeviceImageFormatInfo2 formatInfo{};
+	formatInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2;
+	formatInfo.format = imageCreateInfo.format;
+	formatInfo.type = imageCreateInfo.imageType;
+	formatInfo.tiling = imageCreateInfo.tiling;
+	formatInfo.usage = VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	formatInfo.flags = imageCreateInfo.flags;
+	VkResult result = vkGetPhysicalDeviceImageFormatProperties2(physicalDevice, &formatInfo, &formatProperties);
+	return result == VK_SUCCESS && performanceQuery.optimalDeviceAccess;
+}
+
+bool Texture::isLinearBlitSupported(VkPhysicalDevice physicalDevice, VkFormat format)
+{
+	VkFormatFeatureFlags const requiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+}
+
+void Texture::addBarrier(VkCommandBuffer commandBuffer, VkImageLayout prevLayout, VkImageLayout nextLayout, uint32_t baseMipLevel, uint32_t levelCount)
 {
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -339,8 +462,8 @@ void Texture::addBarrier(VkCommandBuffer commandBuffer, VkImageLayout prevLayout
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.image = m_image;
 	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseMipLevel = baseMipLevel;
+	barrier.subresourceRange.levelCount = levelCount;
 	barrier.subresourceRange.baseArrayLayer = 0;
 	barrier.subresourceRange.layerCount = m_layerCount;
 	VkPipelineStageFlags srcStageMask;
@@ -359,6 +482,20 @@ void Texture::addBarrier(VkCommandBuffer commandBuffer, VkImageLayout prevLayout
 		srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	}
+	else if (prevLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && nextLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
+	else if (prevLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && nextLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
 	else if (prevLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL && nextLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) {
 		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
 
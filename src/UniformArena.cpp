@@ -0,0 +1,45 @@
+#include "UniformArena.h"
+
+#include <iostream>
+#include <cstring>
+
+UniformArena::UniformArena(VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator* allocator)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_alignment = properties.limits.minUniformBufferOffsetAlignment;
+
+    // Host visible, so it takes the device local heap when the CPU can write it in place and the GPU reads the
+    // uniforms without going over the bus
+    m_buffer = std::make_unique<Buffer>(device, allocator, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, FRAME_CAPACITY * Renderer::BUFFER_COUNT,
+        MemoryAllocator::Category::UNIFORM);
+}
+
+void UniformArena::reset(uint32_t bufferIdx)
+{
+    m_sizes[bufferIdx] = 0;
+}
+
+uint32_t UniformArena::push(uint32_t bufferIdx, void const* data, VkDeviceSize size)
+{
+    // The alignment is a power of two
+    VkDeviceSize alignedSize = (size + m_alignment - 1) & ~(m_alignment - 1);
+    VkDeviceSize offset = m_sizes[bufferIdx].fetch_add(alignedSize);
+    if (offset + alignedSize > FRAME_CAPACITY)
+    {
+        std::cout << "Uniform arena is out of space" << std::endl;
+        std::terminate();
+    }
+    offset += FRAME_CAPACITY * bufferIdx;
+    memcpy(static_cast<char*>(m_buffer->m_hostData) + offset, data, static_cast<size_t>(size));
+    return static_cast<uint32_t>(offset);
+}
+
+VkDescriptorBufferInfo UniformArena::getDescriptorInfo(VkDeviceSize range) const
+{
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = m_buffer->m_vkBuffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = range;
+    return bufferInfo;
+}
@@ -0,0 +1,99 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(uint32_t threadCount)
+{
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        m_threads.emplace_back([this, i]()
+        {
+            uint32_t generation = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock lock(m_mutex);
+                    m_jobAvailable.wait(lock, [this, generation]()
+                    {
+                        return m_generation != generation || !m_isRunning;
+                    });
+                    if (!m_isRunning)
+                    {
+                        break;
+                    }
+                    generation = m_generation;
+                }
+
+                // The calling thread is worker 0
+                runRanges(i + 1);
+
+                {
+                    std::unique_lock lock(m_mutex);
+                    --m_busyThreads;
+                }
+                m_jobDone.notify_one();
+            }
+        });
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::unique_lock lock(m_mutex);
+        m_isRunning = false;
+    }
+    m_jobAvailable.notify_all();
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+uint32_t WorkerPool::getWorkerCount() const
+{
+    return static_cast<uint32_t>(m_threads.size()) + 1;
+}
+
+void WorkerPool::parallelFor(uint32_t count, uint32_t grainSize, RangeJob const& job)
+{
+    // Not worth waking the threads for a single range
+    if (count <= grainSize || m_threads.empty())
+    {
+        for (uint32_t first = 0; first < count; first += grainSize)
+        {
+            job(first, std::min(first + grainSize, count), 0);
+        }
+        return;
+    }
+
+    {
+        std::unique_lock lock(m_mutex);
+        m_job = &job;
+        m_count = count;
+        m_grainSize = grainSize;
+        m_nextRange = 0;
+        m_busyThreads = static_cast<uint32_t>(m_threads.size());
+        ++m_generation;
+    }
+    m_jobAvailable.notify_all();
+
+    runRanges(0);
+
+    std::unique_lock lock(m_mutex);
+    m_jobDone.wait(lock, [this]()
+    {
+        return m_busyThreads == 0;
+    });
+    m_job = nullptr;
+}
+
+void WorkerPool::runRanges(uint32_t workerIdx)
+{
+    uint32_t rangeCount = (m_count + m_grainSize - 1) / m_grainSize;
+    for (uint32_t range = m_nextRange++; range < rangeCount; range = m_nextRange++)
+    {
+        uint32_t first = range * m_grainSize;
+        (*m_job)(first, std::min(first + m_grainSize, m_count), workerIdx);
+    }
+}
@@ -0,0 +1,200 @@
+#include "BlockDecoder.h"
+
+#include "Ktx2File.h"
+
+#include <iostream>
+#include <algorithm>
+#include <array>
+
+static constexpr uint32_t BLOCK_TEXEL_COUNT = 16;
+
+static std::array<uint32_t, 3> fromRgb565(uint32_t color)
+{
+    uint32_t r = (color >> 11) & 31;
+    uint32_t g = (color >> 5) & 63;
+    uint32_t b = color & 31;
+    return { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2) };
+}
+
+std::vector<uint8_t> BlockDecoder::decode(VkFormat format, uint8_t const* blocks, uint32_t width, uint32_t height)
+{
+    uint32_t blockSize = Ktx2File::getBlockSize(format);
+    uint32_t blockCountX = (width + 3) / 4;
+    uint32_t blockCountY = (height + 3) / 4;
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+    std::array<uint8_t, BLOCK_TEXEL_COUNT * 4> texels;
+    for (uint32_t blockY = 0; blockY < blockCountY; ++blockY)
+    {
+        for (uint32_t blockX = 0; blockX < blockCountX; ++blockX)
+        {
+            uint8_t const* block = &blocks[(static_cast<size_t>(blockY) * blockCountX + blockX) * blockSize];
+            for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+            {
+                texels[i * 4 + 0] = 0;
+                texels[i * 4 + 1] = 0;
+                texels[i * 4 + 2] = 0;
+                texels[i * 4 + 3] = 255;
+            }
+            switch (format)
+            {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                decodeBC1(block, texels.data());
+                break;
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+                decodeBC4(block, 3, texels.data());
+                decodeBC1(block + 8, texels.data());
+                break;
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+                decodeBC4(block, 0, texels.data());
+                decodeBC4(block + 8, 1, texels.data());
+                break;
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                decodeBC7(block, texels.data());
+                break;
+            default:
+                std::cout << "Failed to decode image, format " << format << " is not block compressed" << std::endl;
+                std::terminate();
+            }
+
+            // Edge blocks of images not a multiple of 4 hold texels past the edges
+            for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+            {
+                uint32_t x = blockX * 4 + i % 4;
+                uint32_t y = blockY * 4 + i / 4;
+                if (x < width && y < height)
+                {
+                    std::copy_n(&texels[i * 4], 4, &pixels[(static_cast<size_t>(y) * width + x) * 4]);
+                }
+            }
+        }
+    }
+    return pixels;
+}
+
+uint32_t BlockDecoder::getChannelCount(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        return 3;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+void BlockDecoder::decodeBC1(uint8_t const* block, uint8_t* texels)
+{
+    uint32_t color0 = block[0] | (block[1] << 8);
+    uint32_t color1 = block[2] | (block[3] << 8);
+    std::array<std::array<uint32_t, 3>, 4> palette{ fromRgb565(color0), fromRgb565(color1) };
+    for (uint32_t channel = 0; channel < 3; ++channel)
+    {
+        // Four colors when the first endpoint is the larger one, otherwise three and black
+        if (color0 > color1)
+        {
+            palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+            palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+        }
+        else
+        {
+            palette[2][channel] = (palette[0][channel] + palette[1][channel]) / 2;
+            palette[3][channel] = 0;
+        }
+    }
+
+    uint32_t indexBits = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+    for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        uint32_t index = (indexBits >> (i * 2)) & 3;
+        for (uint32_t channel = 0; channel < 3; ++channel)
+        {
+            texels[i * 4 + channel] = static_cast<uint8_t>(palette[index][channel]);
+        }
+    }
+}
+
+void BlockDecoder::decodeBC4(uint8_t const* block, uint32_t channel, uint8_t* texels)
+{
+    uint32_t value0 = block[0];
+    uint32_t value1 = block[1];
+    // Six values between the endpoints when the first is the larger one, otherwise four and the extremes
+    std::array<uint32_t, 8> palette{ value0, value1 };
+    if (value0 > value1)
+    {
+        for (uint32_t entry = 2; entry < 8; ++entry)
+        {
+            palette[entry] = ((8 - entry) * value0 + (entry - 1) * value1) / 7;
+        }
+    }
+    else
+    {
+        for (uint32_t entry = 2; entry < 6; ++entry)
+        {
+            palette[entry] = ((6 - entry) * value0 + (entry - 1) * value1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t indexBits{ 0 };
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+        indexBits |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+    }
+    for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        texels[i * 4 + channel] = static_cast<uint8_t>(palette[(indexBits >> (i * 3)) & 7]);
+    }
+}
+
+void BlockDecoder::decodeBC7(uint8_t const* block, uint8_t* texels)
+{
+    // Interpolation weights of the 4-bit indices, in 64ths
+    static constexpr std::array<uint32_t, 16> weights{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    uint32_t bitOffset{ 0 };
+    auto readBits = [block, &bitOffset](uint32_t bitCount)
+    {
+        uint32_t value{ 0 };
+        for (uint32_t bit = 0; bit < bitCount; ++bit, ++bitOffset)
+        {
+            value |= ((block[bitOffset / 8] >> (bitOffset % 8)) & 1u) << bit;
+        }
+        return value;
+    };
+    // Mode 6 is six zero bits and a one
+    if (readBits(7) != 1 << 6)
+    {
+        std::cout << "Failed to decode BC7 block, only mode 6 is supported" << std::endl;
+        std::terminate();
+    }
+    std::array<std::array<uint32_t, 4>, 2> endpoints;
+    for (uint32_t channel = 0; channel < 4; ++channel)
+    {
+        endpoints[0][channel] = readBits(7) << 1;
+        endpoints[1][channel] = readBits(7) << 1;
+    }
+    uint32_t pBit0 = readBits(1);
+    uint32_t pBit1 = readBits(1);
+    for (uint32_t channel = 0; channel < 4; ++channel)
+    {
+        endpoints[0][channel] |= pBit0;
+        endpoints[1][channel] |= pBit1;
+    }
+
+    // The top bit of the first index is implied zero
+    for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        uint32_t weight = weights[readBits(i == 0 ? 3 : 4)];
+        for (uint32_t channel = 0; channel < 4; ++channel)
+        {
+            texels[i * 4 + channel] = static_cast<uint8_t>(((64 - weight) * endpoints[0][channel] + weight * endpoints[1][channel] + 32) >> 6);
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <cstdint>
+
+// Decodes the blocks written by BlockEncoder back into RGBA8 images, to measure what the compression lost. Written from
+// the format specifications rather than from the encoder, so that the two do not share their mistakes. BC7 decodes
+// mode 6 only, the one the encoder writes.
+class BlockDecoder
+{
+public:
+	// Channels the format does not store are left at 0, and alpha at 255
+	static std::vector<uint8_t> decode(VkFormat format, uint8_t const* blocks, uint32_t width, uint32_t height);
+	// Channels of the decoded images that hold what the format stores, alpha is left out of BC1 and blue of BC5
+	static uint32_t getChannelCount(VkFormat format);
+private:
+	// Into 16 RGBA8 texels in rows
+	static void decodeBC1(uint8_t const* block, uint8_t* texels);
+	static void decodeBC4(uint8_t const* block, uint32_t channel, uint8_t* texels);
+	static void decodeBC7(uint8_t const* block, uint8_t* texels);
+};
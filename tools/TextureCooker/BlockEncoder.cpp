@@ -0,0 +1,366 @@
+#include "BlockEncoder.h"
+
+#include "Ktx2File.h"
+
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <cmath>
+
+static constexpr uint32_t BLOCK_TEXEL_COUNT = 16;
+
+// Endpoints of the line fitted to the texels, at the extreme projections of the texels on it
+static void getLineEndpoints(uint8_t const* texels, uint32_t channelCount, float const* mean, float const* axis, float* start, float* end)
+{
+    float minT = std::numeric_limits<float>::max();
+    float maxT = -std::numeric_limits<float>::max();
+    for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        float t = 0.0f;
+        for (uint32_t channel = 0; channel < channelCount; ++channel)
+        {
+            t += (texels[i * 4 + channel] - mean[channel]) * axis[channel];
+        }
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    for (uint32_t channel = 0; channel < channelCount; ++channel)
+    {
+        start[channel] = std::clamp(mean[channel] + axis[channel] * minT, 0.0f, 255.0f);
+        end[channel] = std::clamp(mean[channel] + axis[channel] * maxT, 0.0f, 255.0f);
+    }
+}
+
+// Index of the palette entry nearest to every texel, and the summed squared error
+template<size_t PaletteSize>
+static uint32_t findIndices(uint8_t const* texels, uint32_t channelCount, std::array<std::array<int32_t, 4>, PaletteSize> const& palette, uint8_t* indices)
+{
+    uint32_t error{ 0 };
+    for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        uint32_t bestError = std::numeric_limits<uint32_t>::max();
+        for (uint32_t entry = 0; entry < PaletteSize; ++entry)
+        {
+            uint32_t entryError{ 0 };
+            for (uint32_t channel = 0; channel < channelCount; ++channel)
+            {
+                int32_t difference = texels[i * 4 + channel] - palette[entry][channel];
+                entryError += static_cast<uint32_t>(difference * difference);
+            }
+            if (entryError < bestError)
+            {
+                bestError = entryError;
+                indices[i] = static_cast<uint8_t>(entry);
+            }
+        }
+        error += bestError;
+    }
+    return error;
+}
+
+static uint16_t toRgb565(float const* color)
+{
+    uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+    uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+    uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static std::array<int32_t, 4> fromRgb565(uint16_t color)
+{
+    int32_t r = (color >> 11) & 31;
+    int32_t g = (color >> 5) & 63;
+    int32_t b = color & 31;
+    return { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255 };
+}
+
+std::vector<uint8_t> BlockEncoder::encode(VkFormat format, uint8_t const* pixels, uint32_t width, uint32_t height)
+{
+    void (*encodeBlock)(uint8_t const*, uint8_t*) = nullptr;
+    switch (format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        encodeBlock = encodeBC1;
+        break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        encodeBlock = encodeBC3;
+        break;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        encodeBlock = encodeBC5;
+        break;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        encodeBlock = encodeBC7;
+        break;
+    default:
+        std::cout << "Failed to encode image, format " << format << " is not block compressed" << std::endl;
+        std::terminate();
+    }
+
+    uint32_t blockSize = Ktx2File::getBlockSize(format);
+    uint32_t blockCountX = (width + 3) / 4;
+    uint32_t blockCountY = (height + 3) / 4;
+    std::vector<uint8_t> blocks(static_cast<size_t>(blockCountX) * blockCountY * blockSize);
+    std::array<uint8_t, BLOCK_TEXEL_COUNT * 4> texels;
+    for (uint32_t blockY = 0; blockY < blockCountY; ++blockY)
+    {
+        for (uint32_t blockX = 0; blockX < blockCountX; ++blockX)
+        {
+            for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+            {
+                uint32_t x = std::min(blockX * 4 + i % 4, width - 1);
+                uint32_t y = std::min(blockY * 4 + i / 4, height - 1);
+                std::copy_n(&pixels[(static_cast<size_t>(y) * width + x) * 4], 4, &texels[i * 4]);
+            }
+            encodeBlock(texels.data(), &blocks[(static_cast<size_t>(blockY) * blockCountX + blockX) * blockSize]);
+        }
+    }
+    return blocks;
+}
+
+void BlockEncoder::encodeBC1(uint8_t const* texels, uint8_t* block)
+{
+    float mean[4];
+    float axis[4];
+    float start[4];
+    float end[4];
+    fitLine(texels, 3, mean, axis);
+    getLineEndpoints(texels, 3, mean, axis, start, end);
+
+    // The first endpoint is the larger one in four color mode
+    uint16_t color0 = toRgb565(end);
+    uint16_t color1 = toRgb565(start);
+    if (color0 < color1)
+    {
+        std::swap(color0, color1);
+    }
+    std::array<uint8_t, BLOCK_TEXEL_COUNT> indices{};
+    if (color0 != color1)
+    {
+        std::array<std::array<int32_t, 4>, 4> palette{ fromRgb565(color0), fromRgb565(color1) };
+        for (uint32_t channel = 0; channel < 3; ++channel)
+        {
+            palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+            palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+        }
+        findIndices(texels, 3, palette, indices.data());
+    }
+
+    uint32_t indexBits{ 0 };
+    for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        indexBits |= static_cast<uint32_t>(indices[i]) << (i * 2);
+    }
+    block[0] = static_cast<uint8_t>(color0);
+    block[1] = static_cast<uint8_t>(color0 >> 8);
+    block[2] = static_cast<uint8_t>(color1);
+    block[3] = static_cast<uint8_t>(color1 >> 8);
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        block[4 + i] = static_cast<uint8_t>(indexBits >> (i * 8));
+    }
+}
+
+void BlockEncoder::encodeBC3(uint8_t const* texels, uint8_t* block)
+{
+    encodeBC4(texels, 3, block);
+    encodeBC1(texels, block + 8);
+}
+
+void BlockEncoder::encodeBC5(uint8_t const* texels, uint8_t* block)
+{
+    encodeBC4(texels, 0, block);
+    encodeBC4(texels, 1, block + 8);
+}
+
+void BlockEncoder::encodeBC7(uint8_t const* texels, uint8_t* block)
+{
+    // Interpolation weights of the 4-bit indices, in 64ths
+    static constexpr std::array<int32_t, 16> weights{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    float mean[4];
+    float axis[4];
+    float start[4];
+    float end[4];
+    fitLine(texels, 4, mean, axis);
+    getLineEndpoints(texels, 4, mean, axis, start, end);
+
+    // Endpoints are 7 bits per channel plus a low bit shared by the channels of each, every combination of the shared
+    // bits is tried
+    std::array<std::array<uint32_t, 4>, 2> endpoints{};
+    std::array<uint32_t, 2> pBits{};
+    std::array<uint8_t, BLOCK_TEXEL_COUNT> indices{};
+    uint32_t bestError = std::numeric_limits<uint32_t>::max();
+    for (uint32_t pBitCombination = 0; pBitCombination < 4; ++pBitCombination)
+    {
+        std::array<uint32_t, 2> tryPBits{ pBitCombination & 1, pBitCombination >> 1 };
+        std::array<std::array<uint32_t, 4>, 2> tryEndpoints;
+        std::array<std::array<int32_t, 4>, 2> values;
+        for (uint32_t channel = 0; channel < 4; ++channel)
+        {
+            tryEndpoints[0][channel] = static_cast<uint32_t>(std::clamp((start[channel] - tryPBits[0]) * 0.5f + 0.5f, 0.0f, 127.0f));
+            tryEndpoints[1][channel] = static_cast<uint32_t>(std::clamp((end[channel] - tryPBits[1]) * 0.5f + 0.5f, 0.0f, 127.0f));
+            values[0][channel] = static_cast<int32_t>((tryEndpoints[0][channel] << 1) | tryPBits[0]);
+            values[1][channel] = static_cast<int32_t>((tryEndpoints[1][channel] << 1) | tryPBits[1]);
+        }
+        std::array<std::array<int32_t, 4>, 16> palette;
+        for (uint32_t entry = 0; entry < 16; ++entry)
+        {
+            for (uint32_t channel = 0; channel < 4; ++channel)
+            {
+                palette[entry][channel] = ((64 - weights[entry]) * values[0][channel] + weights[entry] * values[1][channel] + 32) >> 6;
+            }
+        }
+        std::array<uint8_t, BLOCK_TEXEL_COUNT> tryIndices;
+        uint32_t error = findIndices(texels, 4, palette, tryIndices.data());
+        if (error < bestError)
+        {
+            bestError = error;
+            endpoints = tryEndpoints;
+            pBits = tryPBits;
+            indices = tryIndices;
+        }
+    }
+    // The top bit of the first index is implied zero, the endpoints are swapped when it would be set
+    if (indices[0] >= 8)
+    {
+        std::swap(endpoints[0], endpoints[1]);
+        std::swap(pBits[0], pBits[1]);
+        for (auto& index : indices)
+        {
+            index = static_cast<uint8_t>(15 - index);
+        }
+    }
+
+    std::fill_n(block, 16, 0);
+    uint32_t bitOffset{ 0 };
+    auto writeBits = [block, &bitOffset](uint32_t value, uint32_t bitCount)
+    {
+        for (uint32_t bit = 0; bit < bitCount; ++bit, ++bitOffset)
+        {
+            block[bitOffset / 8] |= static_cast<uint8_t>(((value >> bit) & 1) << (bitOffset % 8));
+        }
+    };
+    // Mode 6 is six zero bits and a one
+    writeBits(1 << 6, 7);
+    for (uint32_t channel = 0; channel < 4; ++channel)
+    {
+        writeBits(endpoints[0][channel], 7);
+        writeBits(endpoints[1][channel], 7);
+    }
+    writeBits(pBits[0], 1);
+    writeBits(pBits[1], 1);
+    writeBits(indices[0], 3);
+    for (uint32_t i = 1; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        writeBits(indices[i], 4);
+    }
+}
+
+void BlockEncoder::encodeBC4(uint8_t const* texels, uint32_t channel, uint8_t* block)
+{
+    int32_t minValue{ 255 };
+    int32_t maxValue{ 0 };
+    for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        minValue = std::min<int32_t>(minValue, texels[i * 4 + channel]);
+        maxValue = std::max<int32_t>(maxValue, texels[i * 4 + channel]);
+    }
+
+    // The first endpoint is the larger one in eight value mode, with six values interpolated between them
+    std::array<uint8_t, BLOCK_TEXEL_COUNT> indices{};
+    if (minValue != maxValue)
+    {
+        std::array<std::array<int32_t, 4>, 8> palette{};
+        palette[0][0] = maxValue;
+        palette[1][0] = minValue;
+        for (int32_t entry = 2; entry < 8; ++entry)
+        {
+            palette[entry][0] = ((8 - entry) * maxValue + (entry - 1) * minValue) / 7;
+        }
+        // The palette is matched against the first channel of the texels, starting from the requested one
+        findIndices(texels + channel, 1, palette, indices.data());
+    }
+
+    uint64_t indexBits{ 0 };
+    for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        indexBits |= static_cast<uint64_t>(indices[i]) << (i * 3);
+    }
+    block[0] = static_cast<uint8_t>(maxValue);
+    block[1] = static_cast<uint8_t>(minValue);
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+        block[2 + i] = static_cast<uint8_t>(indexBits >> (i * 8));
+    }
+}
+
+void BlockEncoder::fitLine(uint8_t const* texels, uint32_t channelCount, float* mean, float* axis)
+{
+    std::array<float, 4> minValue{ 255.0f, 255.0f, 255.0f, 255.0f };
+    std::array<float, 4> maxValue{};
+    for (uint32_t channel = 0; channel < channelCount; ++channel)
+    {
+        mean[channel] = 0.0f;
+        for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+        {
+            float value = texels[i * 4 + channel];
+            mean[channel] += value;
+            minValue[channel] = std::min(minValue[channel], value);
+            maxValue[channel] = std::max(maxValue[channel], value);
+        }
+        mean[channel] /= BLOCK_TEXEL_COUNT;
+    }
+
+    std::array<std::array<float, 4>, 4> covariance{};
+    for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        for (uint32_t row = 0; row < channelCount; ++row)
+        {
+            for (uint32_t column = 0; column < channelCount; ++column)
+            {
+                covariance[row][column] += (texels[i * 4 + row] - mean[row]) * (texels[i * 4 + column] - mean[column]);
+            }
+        }
+    }
+
+    // Power iteration from the diagonal of the bounding box converges on the largest eigenvector in a few steps
+    for (uint32_t channel = 0; channel < channelCount; ++channel)
+    {
+        axis[channel] = maxValue[channel] - minValue[channel];
+    }
+    for (uint32_t iteration = 0; iteration < 8; ++iteration)
+    {
+        std::array<float, 4> next{};
+        float length{ 0.0f };
+        for (uint32_t row = 0; row < channelCount; ++row)
+        {
+            for (uint32_t column = 0; column < channelCount; ++column)
+            {
+                next[row] += covariance[row][column] * axis[column];
+            }
+            length += next[row] * next[row];
+        }
+        // Flat blocks have no direction, their texels all project to the mean
+        if (length == 0.0f)
+            break;
+
+        length = std::sqrt(length);
+        for (uint32_t channel = 0; channel < channelCount; ++channel)
+        {
+            axis[channel] = next[channel] / length;
+        }
+    }
+    float length{ 0.0f };
+    for (uint32_t channel = 0; channel < channelCount; ++channel)
+    {
+        length += axis[channel] * axis[channel];
+    }
+    for (uint32_t channel = 0; channel < channelCount; ++channel)
+    {
+        axis[channel] = length > 0.0f ? axis[channel] / std::sqrt(length) : 0.0f;
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <cstdint>
+
+// Encodes RGBA8 images into the BCn block compressed formats, 4x4 texels per block. The endpoints of a block are the
+// extremes of its texels along their principal axis, which is quick and close to what slower searches reach on
+// photographic textures. BC7 uses mode 6 only, a single RGBA line with 16 indices.
+class BlockEncoder
+{
+public:
+	// One of the BC1 RGB, BC3, BC5 or BC7 formats. Edge blocks of images not a multiple of 4 repeat the edge texels.
+	static std::vector<uint8_t> encode(VkFormat format, uint8_t const* pixels, uint32_t width, uint32_t height);
+
+	// Of 16 RGBA8 texels in rows
+	static void encodeBC1(uint8_t const* texels, uint8_t* block);
+	static void encodeBC3(uint8_t const* texels, uint8_t* block);
+	// Red and green only
+	static void encodeBC5(uint8_t const* texels, uint8_t* block);
+	static void encodeBC7(uint8_t const* texels, uint8_t* block);
+private:
+	// A single channel of the texels, the alpha of BC3 and the channels of BC5
+	static void encodeBC4(uint8_t const* texels, uint32_t channel, uint8_t* block);
+	// Mean of the first channelCount channels of the texels, and the direction they vary the most in
+	static void fitLine(uint8_t const* texels, uint32_t channelCount, float* mean, float* axis);
+};
@@ -0,0 +1,169 @@
+#include "BlockEncoder.h"
+#include "BlockDecoder.h"
+#include "Ktx2File.h"
+#include "MipChain.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Compresses a source image into a KTX2 file with a full mip chain, which Texture loads in place of the source
+// image when the device samples BCn formats. The format follows what the texture is used for.
+enum Role
+{
+    // sRGB color, BC7 by default
+    ALBEDO = 0,
+    // Tangent space normals, BC5 by default as their third component is rebuilt in the shader
+    NORMAL
+};
+
+static void printUsage()
+{
+    std::cout << "Usage: TextureCooker [--role albedo|normal] [--format bc1|bc3|bc5|bc7] [--verify] <input image> <output.ktx2>" << std::endl;
+}
+
+// Peak signal to noise ratio in dB of the channels the format stores, infinite when nothing was lost
+static float getPsnr(uint8_t const* expected, uint8_t const* actual, uint32_t width, uint32_t height, uint32_t channelCount)
+{
+    double squaredError{ 0.0 };
+    for (size_t texel = 0; texel < static_cast<size_t>(width) * height; ++texel)
+    {
+        for (uint32_t channel = 0; channel < channelCount; ++channel)
+        {
+            double difference = static_cast<double>(expected[texel * 4 + channel]) - actual[texel * 4 + channel];
+            squaredError += difference * difference;
+        }
+    }
+    if (squaredError == 0.0)
+        return std::numeric_limits<float>::infinity();
+    double meanSquaredError = squaredError / (static_cast<double>(width) * height * channelCount);
+    return static_cast<float>(10.0 * std::log10(255.0 * 255.0 / meanSquaredError));
+}
+
+static VkFormat getFormat(std::string const& name, Role role)
+{
+    bool isSrgb = role == Role::ALBEDO;
+    if (name == "bc1")
+        return isSrgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    if (name == "bc3")
+        return isSrgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    if (name == "bc5")
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    if (name == "bc7")
+        return isSrgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    return VK_FORMAT_UNDEFINED;
+}
+
+int main(int argc, char** argv)
+{
+    Role role{ Role::ALBEDO };
+    bool verify{ false };
+    std::string formatName;
+    std::string inputFilename;
+    std::string outputFilename;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--role" && i + 1 < argc)
+        {
+            std::string roleName = argv[++i];
+            if (roleName != "albedo" && roleName != "normal")
+            {
+                printUsage();
+                return 1;
+            }
+            role = roleName == "albedo" ? Role::ALBEDO : Role::NORMAL;
+        }
+        else if (argument == "--format" && i + 1 < argc)
+        {
+            formatName = argv[++i];
+        }
+        else if (argument == "--verify")
+        {
+            verify = true;
+        }
+        else if (inputFilename.empty())
+        {
+            inputFilename = argument;
+        }
+        else if (outputFilename.empty())
+        {
+            outputFilename = argument;
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+    if (formatName.empty())
+    {
+        formatName = role == Role::ALBEDO ? "bc7" : "bc5";
+    }
+    VkFormat format = getFormat(formatName, role);
+    if (inputFilename.empty() || outputFilename.empty() || format == VK_FORMAT_UNDEFINED)
+    {
+        printUsage();
+        return 1;
+    }
+
+    int width{ 0 };
+    int height{ 0 };
+    int channelCount{ 0 };
+    stbi_uc* pixels = stbi_load(inputFilename.c_str(), &width, &height, &channelCount, STBI_rgb_alpha);
+    if (!pixels)
+    {
+        std::cout << "Failed to load image " << inputFilename << std::endl;
+        return 1;
+    }
+
+    Ktx2File file;
+    file.format = format;
+    file.width = static_cast<uint32_t>(width);
+    file.height = static_cast<uint32_t>(height);
+    uint32_t levelCount = MipChain::getLevelCount(file.width, file.height);
+    std::vector<std::vector<uint8_t>> mips = MipChain::generate(pixels, file.width, file.height, levelCount,
+        role == Role::ALBEDO ? MipChain::Content::COLOR : MipChain::Content::NORMAL);
+    size_t uncompressedSize{ 0 };
+    size_t compressedSize{ 0 };
+    for (uint32_t level = 0; level < levelCount; ++level)
+    {
+        uint8_t const* levelPixels = level == 0 ? pixels : mips[level - 1].data();
+        file.levels.emplace_back(BlockEncoder::encode(format, levelPixels, std::max(file.width >> level, 1u), std::max(file.height >> level, 1u)));
+        uncompressedSize += Ktx2File::getLevelSize(VK_FORMAT_R8G8B8A8_UNORM, file.width, file.height, level);
+        compressedSize += file.levels.back().size();
+    }
+    Ktx2File::save(outputFilename, file);
+
+    std::cout << "Cooked " << inputFilename << " into " << outputFilename << ": " << width << "x" << height << ", " << levelCount << " levels of " <<
+        formatName << ", " << compressedSize << " bytes, " << static_cast<float>(uncompressedSize) / compressedSize << "x smaller than RGBA8" << std::endl;
+
+    // The written file is read back the way Texture reads it, and every level is compared with the level it was encoded from
+    if (verify)
+    {
+        Ktx2File cooked;
+        if (!Ktx2File::load(outputFilename, cooked) || cooked.levels.size() != levelCount)
+        {
+            std::cout << "Failed to read back " << outputFilename << std::endl;
+            stbi_image_free(pixels);
+            return 1;
+        }
+        uint32_t channelCount = BlockDecoder::getChannelCount(format);
+        for (uint32_t level = 0; level < levelCount; ++level)
+        {
+            uint32_t levelWidth = std::max(file.width >> level, 1u);
+            uint32_t levelHeight = std::max(file.height >> level, 1u);
+            uint8_t const* levelPixels = level == 0 ? pixels : mips[level - 1].data();
+            std::vector<uint8_t> decoded = BlockDecoder::decode(format, cooked.levels[level].data(), levelWidth, levelHeight);
+            std::cout << "Level " << level << " " << levelWidth << "x" << levelHeight << ": PSNR " <<
+                getPsnr(levelPixels, decoded.data(), levelWidth, levelHeight, channelCount) << " dB" << std::endl;
+        }
+    }
+    stbi_image_free(pixels);
+    return 0;
+}